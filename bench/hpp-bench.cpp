@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Compile check and microbenchmark for the C++ wrapper. The handler
+ * paths are timed against the plain C API doing the same thing, the
+ * numbers are expected to be the same within noise.
+ */
+
+#include "gofonoext.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+const int BENCH_DEFAULT_ITERATIONS = 1000000;
+
+static_assert(sizeof(gofonoext::ModemManager) ==
+    sizeof(OfonoExtModemManager*), "ModemManager is not just a pointer");
+static_assert(sizeof(gofonoext::Subscription) ==
+    sizeof(OfonoExtModemManager*) + sizeof(gulong),
+    "Subscription is not just a pointer and an id");
+static_assert(!std::is_copy_constructible_v<gofonoext::ModemManager> &&
+    std::is_nothrow_move_constructible_v<gofonoext::ModemManager>,
+    "ModemManager must be move-only");
+static_assert(!std::is_copy_constructible_v<gofonoext::Subscription> &&
+    std::is_nothrow_move_constructible_v<gofonoext::Subscription>,
+    "Subscription must be move-only");
+
+struct Counter {
+    guint count = 0;
+    void onChanged() { count++; }
+    void onChangedMm(OfonoExtModemManager*) { count++; }
+};
+
+/* Plain functions, connected by pointer */
+void
+bench_function()
+{
+}
+
+void
+bench_function_mm(
+    OfonoExtModemManager*)
+{
+}
+
+void
+bench_c_handler(
+    OfonoExtModemManager*,
+    void* data)
+{
+    static_cast<Counter*>(data)->count++;
+}
+
+template <typename Fn>
+void
+bench_time(
+    const char* name,
+    int n,
+    Fn&& fn)
+{
+    const gint64 start = g_get_monotonic_time();
+
+    for (int i = 0; i < n; i++) {
+        fn();
+    }
+    const gint64 t = g_get_monotonic_time() - start;
+    std::printf("%-24s %8.2f ns/op\n", name, t * 1000.0 / n);
+}
+
+/* Calls through a volatile pointer, the way GLib invokes the handler */
+void
+bench_invoke(
+    const char* name,
+    int n,
+    OfonoExtModemManagerHandler fn,
+    Counter* counter)
+{
+    OfonoExtModemManagerHandler volatile handler = fn;
+
+    bench_time(name, n, [&] { handler(nullptr, counter); });
+}
+
+} /* anonymous namespace */
+
+int
+main(
+    int argc,
+    char* argv[])
+{
+    const int n = (argc > 1) ? std::atoi(argv[1]) : BENCH_DEFAULT_ITERATIONS;
+    gofonoext::ModemManager mm;
+    Counter counter;
+    auto lambda = [&counter] { counter.count++; };
+    const auto const_lambda = [](OfonoExtModemManager*) {};
+
+    if (n <= 0) {
+        std::fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+        return 1;
+    }
+
+    /* Exercise the accessors, they must work before the state is known */
+    std::size_t len = mm.dataImsi().size() + mm.voiceImsi().size() +
+        mm.mmsImsi().size();
+    for (std::string_view path : mm.available()) len += path.size();
+    for (std::string_view path : mm.enabled()) len += path.size();
+    for (gboolean present : mm.presentSims()) len += present;
+    std::printf("%s, %u modem(s), %zu\n", mm.valid() ? "valid" :
+        "not valid", mm.modemCount(), len);
+
+    bench_invoke("call (C)", n, bench_c_handler, &counter);
+    bench_invoke("call (method)", n, gofonoext::detail::MethodHandler<
+        &Counter::onChanged, Counter>::call, &counter);
+    bench_invoke("call (method, mm)", n, gofonoext::detail::MethodHandler<
+        &Counter::onChangedMm, Counter>::call, &counter);
+
+    bench_time("connect (C)", n, [&] {
+        ofonoext_mm_remove_handler(mm.get(),
+            ofonoext_mm_add_data_imsi_changed_handler(mm.get(),
+                bench_c_handler, &counter));
+    });
+    bench_time("connect (method)", n, [&] {
+        gofonoext::Subscription s = mm.connect<gofonoext::Event::DataImsi,
+            &Counter::onChanged>(&counter);
+    });
+    bench_time("connect (lambda)", n, [&] {
+        gofonoext::Subscription s =
+            mm.connect<gofonoext::Event::DataImsi>(lambda);
+    });
+    bench_time("connect (const lambda)", n, [&] {
+        gofonoext::Subscription s =
+            mm.connect<gofonoext::Event::DataImsi>(const_lambda);
+    });
+    bench_time("connect (function)", n, [&] {
+        gofonoext::Subscription s =
+            mm.connect<gofonoext::Event::Valid>(bench_function);
+    });
+    bench_time("connect (function, mm)", n, [&] {
+        gofonoext::Subscription s =
+            mm.connect<gofonoext::Event::Valid>(&bench_function_mm);
+    });
+    return (counter.count == 3u * n) ? 0 : 1;
+}
+
+/*
+ * Local Variables:
+ * mode: C++
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,1625 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gofonoext_exporter.h"
+#include "gofonoext_mm.h"
+#include "gofonoext_sim_settings.h"
+#include "gofonoext_version.h"
+
+#include <gofono_names.h>
+
+#include <gutil_log.h>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RET_OK          (0)
+#define RET_ERR         (2)
+#define RET_TIMEOUT     (3)
+
+#define BENCH_MOCK_NAME "mm-mock"
+#define BENCH_CONTROL_PATH "/mock"
+#define BENCH_CONTROL_INTERFACE "org.nemomobile.ofono.ModemManagerMock"
+
+/* Busy consumer emulation, e.g. a UI thread rendering at 60 fps */
+#define BENCH_FRAME_MS (16)
+
+/* How long to wait for the mock to show up on the bus */
+#define BENCH_WARMUP_TIMEOUT_SEC (10)
+
+/* Journal size used by --check, the workload overflows it */
+#define BENCH_CHECK_JOURNAL_SIZE (8)
+#define BENCH_CHECK_SIM_SETTINGS_SEC (10)
+
+/* Stress threads drop all their references together this often */
+#define BENCH_THREAD_DROP_EVERY (64)
+
+/* --check fails the current check (and the run) on the first mismatch */
+#define BENCH_CHECK(expr) do { if (!(expr)) { \
+    GERR("%s:%d: check failed: %s", __FILE__, __LINE__, #expr); \
+    return FALSE; } } while (0)
+
+enum bench_event_id {
+    BENCH_EVENT_VALID,
+    BENCH_EVENT_ENABLED_MODEMS,
+    BENCH_EVENT_PRESENT_SIMS,
+    BENCH_EVENT_VOICE_IMSI,
+    BENCH_EVENT_VOICE_MODEM,
+    BENCH_EVENT_DATA_IMSI,
+    BENCH_EVENT_DATA_MODEM,
+    BENCH_EVENT_MMS_IMSI,
+    BENCH_EVENT_MMS_MODEM,
+    BENCH_EVENT_SIM_COUNT,
+    BENCH_EVENT_ACTIVE_SIM_COUNT,
+    BENCH_EVENT_READY,
+    BENCH_EVENT_COUNT
+};
+
+static const char* bench_event_names[] = {
+    "valid",
+    "enabled-modems",
+    "present-sims",
+    "voice-imsi",
+    "voice-modem",
+    "data-imsi",
+    "data-modem",
+    "mms-imsi",
+    "mms-modem",
+    "sim-count",
+    "active-sim-count",
+    "ready"
+};
+
+G_STATIC_ASSERT(G_N_ELEMENTS(bench_event_names) == BENCH_EVENT_COUNT);
+
+typedef struct bench {
+    GMainLoop* loop;
+    GTestDBus* dbus;
+    GDBusConnection* bus;
+    OfonoExtModemManager* mm;
+    gulong event_id[BENCH_EVENT_COUNT];
+    guint events[BENCH_EVENT_COUNT];
+    char* mock;
+    char* replay;
+    char* record;
+    char* metrics;
+    GPid mock_pid;
+    gint slots;
+    gint version;
+    gint latency;
+    gint rate;
+    gint signals;
+    gint runs;
+    gint threads;
+    gint iterations;
+    gint churn;
+    gint probe;
+    gint probe_interval;
+    gint busy;
+    gboolean worker;
+    gboolean private_bus;
+    gint noise;
+    gint noise_size;
+    guint noise_received;
+    char* scenario;
+    gint instances;
+    gint duration;
+    guint valid_count;
+    gint handler_budget;
+    gint batch;
+    guint batch_calls;
+    gint journal;
+    gboolean check;
+    gint64* probe_usec;
+    guint probe_received;
+    gboolean probe_wait;
+    gint timeout;
+    gboolean realtime;
+    guint timeout_id;
+    gboolean timed_out;
+    GVariant* reply;
+    GError* error;
+} Bench;
+
+typedef struct bench_sample {
+    gint64 time;
+    gint64 cpu;
+    gint64 allocs;
+} BenchSample;
+
+/*==========================================================================*
+ * Allocation counter
+ *
+ * GLib allocates memory with malloc(), so interposing the malloc family
+ * in the executable counts allocations made by the library as well.
+ *==========================================================================*/
+
+static gint64 bench_allocs = 0;
+
+#ifdef __GLIBC__
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+void*
+malloc(
+    size_t size)
+{
+    __atomic_add_fetch(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void*
+calloc(
+    size_t n,
+    size_t size)
+{
+    __atomic_add_fetch(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(n, size);
+}
+
+void*
+realloc(
+    void* ptr,
+    size_t size)
+{
+    if (!ptr) {
+        __atomic_add_fetch(&bench_allocs, 1, __ATOMIC_RELAXED);
+    }
+    return __libc_realloc(ptr, size);
+}
+
+#  define BENCH_HAVE_ALLOCS 1
+#else
+#  define BENCH_HAVE_ALLOCS 0
+#endif /* __GLIBC__ */
+
+/*==========================================================================*
+ * Implementation
+ *==========================================================================*/
+
+static
+gint64
+bench_cpu_usec(
+    void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+        G_GINT64_CONSTANT(1000000) +
+        usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static
+void
+bench_sample(
+    BenchSample* sample)
+{
+    sample->time = g_get_monotonic_time();
+    sample->cpu = bench_cpu_usec();
+    sample->allocs = __atomic_load_n(&bench_allocs, __ATOMIC_RELAXED);
+}
+
+static
+void
+bench_sample_diff(
+    BenchSample* sample)
+{
+    BenchSample now;
+    bench_sample(&now);
+    sample->time = now.time - sample->time;
+    sample->cpu = now.cpu - sample->cpu;
+    sample->allocs = now.allocs - sample->allocs;
+}
+
+static
+long
+bench_status_kb(
+    const char* key)
+{
+    long kb = -1;
+    char* buf = NULL;
+    if (g_file_get_contents("/proc/self/status", &buf, NULL, NULL)) {
+        const char* ptr = strstr(buf, key);
+        if (ptr) {
+            kb = strtol(ptr + strlen(key), NULL, 10);
+        }
+        g_free(buf);
+    }
+    return kb;
+}
+
+static
+gboolean
+bench_timeout(
+    gpointer data)
+{
+    Bench* bench = data;
+    bench->timeout_id = 0;
+    bench->timed_out = TRUE;
+    g_main_loop_quit(bench->loop);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+bench_run_loop(
+    Bench* bench,
+    gint timeout_sec)
+{
+    bench->timed_out = FALSE;
+    bench->timeout_id = g_timeout_add_seconds(timeout_sec, bench_timeout,
+        bench);
+    g_main_loop_run(bench->loop);
+    if (bench->timeout_id) {
+        g_source_remove(bench->timeout_id);
+        bench->timeout_id = 0;
+    }
+}
+
+static
+void
+bench_valid_changed(
+    OfonoExtModemManager* mm,
+    void* data)
+{
+    Bench* bench = data;
+    if (mm->valid) {
+        g_main_loop_quit(bench->loop);
+    }
+}
+
+static
+gboolean
+bench_wait_valid(
+    Bench* bench,
+    gint timeout_sec)
+{
+    if (!bench->mm->valid) {
+        gulong id = ofonoext_mm_add_valid_changed_handler(bench->mm,
+            bench_valid_changed, bench);
+        bench_run_loop(bench, timeout_sec);
+        ofonoext_mm_remove_handler(bench->mm, id);
+    }
+    return bench->mm->valid;
+}
+
+static
+void
+bench_control_done(
+    GObject* bus,
+    GAsyncResult* result,
+    gpointer data)
+{
+    Bench* bench = data;
+    bench->reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(bus),
+        result, &bench->error);
+    g_main_loop_quit(bench->loop);
+}
+
+/*
+ * The mock completes the control call after sending the last signal
+ * of the workload, so the reply arrives after all the signals.
+ */
+static
+GVariant*
+bench_control(
+    Bench* bench,
+    const char* method,
+    GVariant* args)
+{
+    GVariant* reply;
+    GCancellable* cancel = g_cancellable_new();
+    g_dbus_connection_call(bench->bus, OFONO_SERVICE, BENCH_CONTROL_PATH,
+        BENCH_CONTROL_INTERFACE, method, args, NULL, G_DBUS_CALL_FLAGS_NONE,
+        G_MAXINT, cancel, bench_control_done, bench);
+    bench_run_loop(bench, bench->timeout);
+    if (bench->timed_out) {
+        GERR("%s timed out", method);
+        /* Wait for bench_control_done to complete the call */
+        g_cancellable_cancel(cancel);
+        g_main_loop_run(bench->loop);
+    }
+    reply = bench->reply;
+    bench->reply = NULL;
+    if (bench->error) {
+        if (!bench->timed_out) {
+            GERR("%s", GERRMSG(bench->error));
+        }
+        g_clear_error(&bench->error);
+    }
+    g_object_unref(cancel);
+    return reply;
+}
+
+static
+void
+bench_event(
+    OfonoExtModemManager* mm,
+    void* data)
+{
+    (*(guint*)data)++;
+}
+
+static
+void
+bench_connect(
+    OfonoExtModemManager* mm,
+    guint* count,
+    gulong* id)
+{
+    id[BENCH_EVENT_VALID] =
+        ofonoext_mm_add_valid_changed_handler(mm, bench_event,
+            count + BENCH_EVENT_VALID);
+    id[BENCH_EVENT_ENABLED_MODEMS] =
+        ofonoext_mm_add_enabled_modems_changed_handler(mm, bench_event,
+            count + BENCH_EVENT_ENABLED_MODEMS);
+    id[BENCH_EVENT_PRESENT_SIMS] =
+        ofonoext_mm_add_present_sims_changed_handler(mm, bench_event,
+            count + BENCH_EVENT_PRESENT_SIMS);
+    id[BENCH_EVENT_VOICE_IMSI] =
+        ofonoext_mm_add_voice_imsi_changed_handler(mm, bench_event,
+            count + BENCH_EVENT_VOICE_IMSI);
+    id[BENCH_EVENT_VOICE_MODEM] =
+        ofonoext_mm_add_voice_modem_changed_handler(mm, bench_event,
+            count + BENCH_EVENT_VOICE_MODEM);
+    id[BENCH_EVENT_DATA_IMSI] =
+        ofonoext_mm_add_data_imsi_changed_handler(mm, bench_event,
+            count + BENCH_EVENT_DATA_IMSI);
+    id[BENCH_EVENT_DATA_MODEM] =
+        ofonoext_mm_add_data_modem_changed_handler(mm, bench_event,
+            count + BENCH_EVENT_DATA_MODEM);
+    id[BENCH_EVENT_MMS_IMSI] =
+        ofonoext_mm_add_mms_imsi_changed_handler(mm, bench_event,
+            count + BENCH_EVENT_MMS_IMSI);
+    id[BENCH_EVENT_MMS_MODEM] =
+        ofonoext_mm_add_mms_modem_changed_handler(mm, bench_event,
+            count + BENCH_EVENT_MMS_MODEM);
+    id[BENCH_EVENT_SIM_COUNT] =
+        ofonoext_mm_add_sim_count_changed_handler(mm, bench_event,
+            count + BENCH_EVENT_SIM_COUNT);
+    id[BENCH_EVENT_ACTIVE_SIM_COUNT] =
+        ofonoext_mm_add_active_sim_count_changed_handler(mm, bench_event,
+            count + BENCH_EVENT_ACTIVE_SIM_COUNT);
+    id[BENCH_EVENT_READY] =
+        ofonoext_mm_add_ready_changed_handler(mm, bench_event,
+            count + BENCH_EVENT_READY);
+}
+
+static
+void
+bench_add_handlers(
+    Bench* bench)
+{
+    memset(bench->events, 0, sizeof(bench->events));
+    bench_connect(bench->mm, bench->events, bench->event_id);
+}
+
+static
+guint
+bench_total_events(
+    Bench* bench)
+{
+    guint i, total = 0;
+    for (i = 0; i < BENCH_EVENT_COUNT; i++) {
+        total += bench->events[i];
+    }
+    return total;
+}
+
+static
+gboolean
+bench_start_mock(
+    Bench* bench)
+{
+    gboolean ok;
+    GError* error = NULL;
+    char* slots = g_strdup_printf("%d", bench->slots);
+    char* version = g_strdup_printf("%d", bench->version);
+    char* latency = g_strdup_printf("%d", bench->latency);
+    char* rate = g_strdup_printf("%d", bench->rate);
+    char* argv[10];
+    int i = 0;
+
+    argv[i++] = bench->mock;
+    argv[i++] = "--slots";
+    argv[i++] = slots;
+    argv[i++] = "--version";
+    argv[i++] = version;
+    argv[i++] = "--latency";
+    argv[i++] = latency;
+    argv[i++] = "--rate";
+    argv[i++] = rate;
+    argv[i++] = NULL;
+    ok = g_spawn_async(NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL,
+        NULL, &bench->mock_pid, &error);
+    if (!ok) {
+        GERR("%s: %s", bench->mock, GERRMSG(error));
+        g_error_free(error);
+    }
+    g_free(slots);
+    g_free(version);
+    g_free(latency);
+    g_free(rate);
+    return ok;
+}
+
+static
+void
+bench_stop_mock(
+    Bench* bench)
+{
+    if (bench->mock_pid) {
+        kill(bench->mock_pid, SIGTERM);
+        waitpid(bench->mock_pid, NULL, 0);
+        g_spawn_close_pid(bench->mock_pid);
+        bench->mock_pid = 0;
+    }
+}
+
+static
+int
+bench_startup(
+    Bench* bench)
+{
+    gint i;
+    gint64 total = 0, min = 0, max = 0;
+
+    /* The first run waits for the mock to register */
+    bench->mm = ofonoext_mm_new();
+    if (!bench_wait_valid(bench, BENCH_WARMUP_TIMEOUT_SEC)) {
+        GERR("Mock service didn't show up");
+        ofonoext_mm_unref(bench->mm);
+        bench->mm = NULL;
+        return RET_TIMEOUT;
+    }
+    ofonoext_mm_unref(bench->mm);
+    bench->mm = NULL;
+
+    for (i = 0; i < bench->runs; i++) {
+        const gint64 start = g_get_monotonic_time();
+        gint64 t;
+        gboolean valid;
+
+        bench->mm = ofonoext_mm_new();
+        valid = bench_wait_valid(bench, bench->timeout);
+        t = g_get_monotonic_time() - start;
+        ofonoext_mm_unref(bench->mm);
+        bench->mm = NULL;
+        if (!valid) {
+            GERR("Startup timed out");
+            return RET_TIMEOUT;
+        }
+        total += t;
+        if (!i || t < min) min = t;
+        if (!i || t > max) max = t;
+    }
+    if (bench->runs > 0) {
+        printf("Startup: %d run(s), min %.3f ms, avg %.3f ms, max %.3f ms\n",
+            bench->runs, min/1000.0, total/1000.0/bench->runs, max/1000.0);
+    }
+    return RET_OK;
+}
+
+static
+void
+bench_print_usage(
+    const BenchSample* sample,
+    guint n,
+    const char* what)
+{
+    printf("CPU: %.3f ms total, %.2f us per %s\n", sample->cpu/1000.0,
+        n ? ((double)sample->cpu)/n : 0.0, what);
+#if BENCH_HAVE_ALLOCS
+    printf("Allocations: %" G_GINT64_FORMAT ", %.2f per %s\n",
+        sample->allocs, n ? ((double)sample->allocs)/n : 0.0, what);
+#endif
+}
+
+static
+int
+bench_throughput(
+    Bench* bench)
+{
+    int ret = RET_ERR;
+    GVariant* reply;
+    BenchSample sample;
+
+    bench_add_handlers(bench);
+    bench_sample(&sample);
+    reply = bench_control(bench, "Start", g_variant_new("(u)",
+        bench->signals));
+    bench_sample_diff(&sample);
+    if (reply) {
+        printf("Throughput: %d signal(s) in %.3f s, %.0f signals/s, "
+            "%u notification(s)\n", bench->signals,
+            sample.time/1000000.0, bench->signals * 1000000.0 / sample.time,
+            bench_total_events(bench));
+        bench_print_usage(&sample, bench->signals, "signal");
+        g_variant_unref(reply);
+        ret = RET_OK;
+    } else if (bench->timed_out) {
+        ret = RET_TIMEOUT;
+    }
+    ofonoext_mm_remove_all_handlers(bench->mm, bench->event_id);
+    return ret;
+}
+
+static
+int
+bench_replay(
+    Bench* bench)
+{
+    int ret = RET_ERR;
+    GVariant* reply;
+    BenchSample sample;
+
+    bench_add_handlers(bench);
+    bench_sample(&sample);
+    reply = bench_control(bench, "Replay", g_variant_new("(sb)",
+        bench->replay, bench->realtime));
+    bench_sample_diff(&sample);
+    if (reply) {
+        guint i, n = 0;
+
+        g_variant_get(reply, "(u)", &n);
+        printf("Replay: %u event(s) in %.3f s, %u notification(s)\n", n,
+            sample.time/1000000.0, bench_total_events(bench));
+        for (i = 0; i < BENCH_EVENT_COUNT; i++) {
+            if (bench->events[i]) {
+                printf("  %s: %u\n", bench_event_names[i], bench->events[i]);
+            }
+        }
+        bench_print_usage(&sample, n, "event");
+        g_variant_unref(reply);
+        ret = RET_OK;
+    } else if (bench->timed_out) {
+        ret = RET_TIMEOUT;
+    }
+    ofonoext_mm_remove_all_handlers(bench->mm, bench->event_id);
+    return ret;
+}
+
+static
+int
+bench_churn(
+    Bench* bench)
+{
+    int ret = RET_ERR;
+    GVariant* reply;
+    BenchSample sample;
+    const long rss = bench_status_kb("VmRSS:");
+
+    bench_add_handlers(bench);
+    bench_sample(&sample);
+    reply = bench_control(bench, "Resync", g_variant_new("(u)",
+        bench->churn));
+    bench_sample_diff(&sample);
+    if (reply) {
+        printf("Churn: %d resync(s) in %.3f s, %u notification(s)\n",
+            bench->churn, sample.time/1000000.0, bench_total_events(bench));
+        bench_print_usage(&sample, bench->churn, "resync");
+        printf("RSS: %ld kB before, %ld kB after\n", rss,
+            bench_status_kb("VmRSS:"));
+        g_variant_unref(reply);
+        ret = RET_OK;
+    } else if (bench->timed_out) {
+        ret = RET_TIMEOUT;
+    }
+    ofonoext_mm_remove_all_handlers(bench->mm, bench->event_id);
+    return ret;
+}
+
+static
+gboolean
+bench_busy(
+    gpointer data)
+{
+    Bench* bench = data;
+    const gint64 end = g_get_monotonic_time() + bench->busy * 1000;
+
+    /* Keep the main loop busy without sleeping */
+    while (g_get_monotonic_time() < end);
+    return G_SOURCE_CONTINUE;
+}
+
+static
+void
+bench_probe_received(
+    OfonoExtModemManager* mm,
+    void* data)
+{
+    Bench* bench = data;
+    const char* sent = mm->data_imsi;
+
+    if (sent && bench->probe_received < (guint)bench->probe) {
+        bench->probe_usec[bench->probe_received++] =
+            g_get_monotonic_time() - g_ascii_strtoll(sent, NULL, 10);
+        if (bench->probe_received == (guint)bench->probe &&
+            bench->probe_wait) {
+            g_main_loop_quit(bench->loop);
+        }
+    }
+}
+
+static
+int
+bench_compare_usec(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const gint64 v1 = *(const gint64*)a;
+    const gint64 v2 = *(const gint64*)b;
+
+    return (v1 < v2) ? -1 : (v1 > v2) ? 1 : 0;
+}
+
+static
+void
+bench_noise_received(
+    GDBusConnection* bus,
+    const char* sender,
+    const char* path,
+    const char* iface,
+    const char* name,
+    GVariant* args,
+    gpointer data)
+{
+    Bench* bench = data;
+
+    bench->noise_received++;
+}
+
+/*
+ * The noise is received on the shared connection, the one that
+ * OfonoExtModemManager is using unless it has its own.
+ */
+static
+guint
+bench_noise_start(
+    Bench* bench)
+{
+    guint id = g_dbus_connection_signal_subscribe(bench->bus, NULL,
+        BENCH_CONTROL_INTERFACE, "Noise", BENCH_CONTROL_PATH, NULL,
+        G_DBUS_SIGNAL_FLAGS_NONE, bench_noise_received, bench, NULL);
+    GVariant* reply;
+
+    bench->noise_received = 0;
+    reply = bench_control(bench, "Noise", g_variant_new("(uu)",
+        bench->noise, bench->noise_size));
+    if (reply) {
+        g_variant_unref(reply);
+    }
+    return id;
+}
+
+static
+void
+bench_noise_stop(
+    Bench* bench,
+    guint id)
+{
+    GVariant* reply = bench_control(bench, "Noise",
+        g_variant_new("(uu)", 0, 0));
+
+    if (reply) {
+        g_variant_unref(reply);
+    }
+    g_dbus_connection_signal_unsubscribe(bench->bus, id);
+}
+
+static
+int
+bench_latency(
+    Bench* bench)
+{
+    int ret = RET_ERR;
+    GVariant* reply;
+    const guint n = bench->probe;
+    guint busy_id = 0, noise_id = 0;
+    gulong id = ofonoext_mm_add_data_imsi_changed_handler(bench->mm,
+        bench_probe_received, bench);
+
+    bench->probe_usec = g_new0(gint64, n);
+    bench->probe_received = 0;
+    if (bench->busy > 0) {
+        busy_id = g_timeout_add(BENCH_FRAME_MS, bench_busy, bench);
+    }
+    if (bench->noise > 0) {
+        noise_id = bench_noise_start(bench);
+    }
+    reply = bench_control(bench, "Probe", g_variant_new("(uu)", n,
+        bench->probe_interval));
+    if (reply) {
+        g_variant_unref(reply);
+
+        /* With the worker thread, the reply may overtake the signals */
+        if (bench->probe_received < n) {
+            bench->probe_wait = TRUE;
+            bench_run_loop(bench, bench->timeout);
+            bench->probe_wait = FALSE;
+        }
+    }
+    if (busy_id) {
+        g_source_remove(busy_id);
+    }
+    if (noise_id) {
+        bench_noise_stop(bench, noise_id);
+    }
+    ofonoext_mm_remove_handler(bench->mm, id);
+
+    if (bench->probe_received) {
+        const guint k = bench->probe_received;
+        gint64* usec = bench->probe_usec;
+        gint64 total = 0;
+        guint i;
+
+        qsort(usec, k, sizeof(usec[0]), bench_compare_usec);
+        for (i = 0; i < k; i++) {
+            total += usec[i];
+        }
+        printf("Latency: %u probe(s), %s, %s, busy %d ms per %d ms\n", k,
+            bench->worker ? "worker thread" : "main thread",
+            bench->private_bus ? "private bus" : "shared bus", bench->busy,
+            BENCH_FRAME_MS);
+        if (bench->noise > 0) {
+            printf("  noise %d signal(s)/s of %d byte(s), %u received\n",
+                bench->noise, bench->noise_size, bench->noise_received);
+        }
+        printf("  min %.3f ms, avg %.3f ms, median %.3f ms, "
+            "p99 %.3f ms, max %.3f ms\n", usec[0]/1000.0,
+            total/1000.0/k, usec[k/2]/1000.0, usec[(k - 1) * 99 / 100]/1000.0,
+            usec[k - 1]/1000.0);
+        ret = (k == n) ? RET_OK : RET_TIMEOUT;
+    } else if (bench->timed_out) {
+        ret = RET_TIMEOUT;
+    }
+    g_free(bench->probe_usec);
+    bench->probe_usec = NULL;
+    return ret;
+}
+
+typedef struct bench_barrier {
+    GMutex mutex;
+    GCond cond;
+    gint count;
+    gint waiting;
+    guint round;
+} BenchBarrier;
+
+typedef struct bench_thread {
+    Bench* bench;
+    GThread* thread;
+    BenchBarrier* barrier;
+    gint* done;
+    guint distinct;
+} BenchThread;
+
+static
+void
+bench_barrier_wait(
+    BenchBarrier* barrier)
+{
+    g_mutex_lock(&barrier->mutex);
+    if (++barrier->waiting == barrier->count) {
+        barrier->waiting = 0;
+        barrier->round++;
+        g_cond_broadcast(&barrier->cond);
+    } else {
+        const guint round = barrier->round;
+
+        while (barrier->round == round) {
+            g_cond_wait(&barrier->cond, &barrier->mutex);
+        }
+    }
+    g_mutex_unlock(&barrier->mutex);
+}
+
+static
+gpointer
+bench_thread_proc(
+    gpointer data)
+{
+    BenchThread* thread = data;
+    OfonoExtModemManager* prev = NULL;
+    gint i;
+
+    for (i = 0; i < thread->bench->iterations; i++) {
+        OfonoExtModemManager* mm;
+
+        /*
+         * Now and then nobody holds the default instance. The first
+         * creates after the barrier race with the last unref, which
+         * may still be disposing it.
+         */
+        if (!(i % BENCH_THREAD_DROP_EVERY)) {
+            ofonoext_mm_unref(prev);
+            prev = NULL;
+            bench_barrier_wait(thread->barrier);
+        }
+
+        mm = ofonoext_mm_new();
+
+        /* Count how often a new instance had to be created */
+        if (mm != prev) {
+            thread->distinct++;
+        }
+        /* Keep every other instance for a while, drop the rest at once */
+        if (i & 1) {
+            ofonoext_mm_unref(prev);
+            prev = mm;
+        } else {
+            ofonoext_mm_unref(mm);
+        }
+    }
+    ofonoext_mm_unref(prev);
+    g_atomic_int_inc(thread->done);
+    g_main_context_wakeup(NULL);
+    return NULL;
+}
+
+static
+int
+bench_threads(
+    Bench* bench)
+{
+    BenchThread* threads = g_new0(BenchThread, bench->threads);
+    const gint64 start = g_get_monotonic_time();
+    BenchBarrier barrier;
+    guint distinct = 0;
+    gint done = 0;
+    gint64 t;
+    gint i;
+
+    memset(&barrier, 0, sizeof(barrier));
+    g_mutex_init(&barrier.mutex);
+    g_cond_init(&barrier.cond);
+    barrier.count = bench->threads;
+    for (i = 0; i < bench->threads; i++) {
+        BenchThread* thread = threads + i;
+
+        thread->bench = bench;
+        thread->barrier = &barrier;
+        thread->done = &done;
+        thread->thread = g_thread_new("mm-bench", bench_thread_proc, thread);
+    }
+
+    /* Async completions are dispatched here */
+    while (g_atomic_int_get(&done) < bench->threads) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+
+    for (i = 0; i < bench->threads; i++) {
+        g_thread_join(threads[i].thread);
+        distinct += threads[i].distinct;
+    }
+    while (g_main_context_iteration(NULL, FALSE));
+    t = g_get_monotonic_time() - start;
+
+    printf("Threads: %d x %d create/unref in %.3f ms, %.0f per second, "
+        "%u instance switch(es)\n", bench->threads, bench->iterations,
+        t/1000.0, bench->threads * (double)bench->iterations * 1000000 / t,
+        distinct);
+    g_cond_clear(&barrier.cond);
+    g_mutex_clear(&barrier.mutex);
+    g_free(threads);
+    return RET_OK;
+}
+
+static
+void
+bench_scenario_valid(
+    OfonoExtModemManager* mm,
+    void* data)
+{
+    Bench* bench = data;
+
+    if (mm->valid && ++bench->valid_count == (guint)bench->instances) {
+        g_main_loop_quit(bench->loop);
+    }
+}
+
+/* Many consumers of the offline backend, no D-Bus involved */
+static
+int
+bench_scenario(
+    Bench* bench)
+{
+    const guint n = bench->instances;
+    OfonoExtModemManager** mm = g_new0(OfonoExtModemManager*, n);
+    gulong* valid_id = g_new0(gulong, n);
+    gulong* id = g_new0(gulong, n * BENCH_EVENT_COUNT);
+    const long rss = bench_status_kb("VmRSS:");
+    int ret = RET_OK;
+    BenchSample sample;
+    GError* error = NULL;
+    guint i;
+
+    memset(bench->events, 0, sizeof(bench->events));
+    bench->valid_count = 0;
+    bench_sample(&sample);
+    for (i = 0; i < n && ret == RET_OK; i++) {
+        mm[i] = ofonoext_mm_new_from_scenario(bench->scenario, &error);
+        if (mm[i]) {
+            valid_id[i] = ofonoext_mm_add_valid_changed_handler(mm[i],
+                bench_scenario_valid, bench);
+            bench_connect(mm[i], bench->events, id + i * BENCH_EVENT_COUNT);
+        } else {
+            GERR("%s: %s", bench->scenario, GERRMSG(error));
+            g_error_free(error);
+            ret = RET_ERR;
+        }
+    }
+    if (ret == RET_OK) {
+        bench_run_loop(bench, bench->timeout);
+        bench_sample_diff(&sample);
+        if (bench->valid_count < n) {
+            GERR("Startup timed out");
+            ret = RET_TIMEOUT;
+        } else {
+            guint events;
+
+            printf("Scenario: %u instance(s) valid in %.3f ms\n", n,
+                sample.time/1000.0);
+            bench_print_usage(&sample, n, "instance");
+
+            /* Then let the timeline run */
+            memset(bench->events, 0, sizeof(bench->events));
+            bench_sample(&sample);
+            bench_run_loop(bench, bench->duration);
+            bench_sample_diff(&sample);
+            events = bench_total_events(bench);
+            printf("Timeline: %u notification(s) in %.3f s\n", events,
+                sample.time/1000000.0);
+            for (i = 0; i < BENCH_EVENT_COUNT; i++) {
+                if (bench->events[i]) {
+                    printf("  %s: %u\n", bench_event_names[i],
+                        bench->events[i]);
+                }
+            }
+            bench_print_usage(&sample, events, "notification");
+            printf("RSS: %ld kB before, %ld kB after\n", rss,
+                bench_status_kb("VmRSS:"));
+        }
+    }
+    for (i = 0; i < n; i++) {
+        if (mm[i]) {
+            ofonoext_mm_remove_handler(mm[i], valid_id[i]);
+            ofonoext_mm_remove_handlers(mm[i], id + i * BENCH_EVENT_COUNT,
+                BENCH_EVENT_COUNT);
+            ofonoext_mm_unref(mm[i]);
+        }
+    }
+    g_free(mm);
+    g_free(valid_id);
+    g_free(id);
+    return ret;
+}
+
+static
+void
+bench_batch(
+    OfonoExtModemManager* mm,
+    OFONOEXT_MM_CHANGED changed,
+    void* data)
+{
+    ((Bench*)data)->batch_calls++;
+}
+
+/* Pages through the journal, the count should match the notifications */
+static
+void
+bench_print_journal(
+    Bench* bench,
+    guint64 seq)
+{
+    OfonoExtModemManagerEvent events[64];
+    guint n, total = 0;
+    gboolean lost = FALSE, gap;
+
+    while ((n = ofonoext_mm_events_since(bench->mm, seq, events,
+        G_N_ELEMENTS(events), &gap)) > 0) {
+        lost |= gap;
+        total += n;
+        seq = events[n - 1].seq;
+    }
+    printf("Journal: %u event(s)%s\n", total, (lost || gap) ?
+        ", some lost" : "");
+}
+
+static
+void
+bench_print_handler_stats(
+    Bench* bench)
+{
+    guint i, n = 0;
+    OfonoExtModemManagerHandlerStats* stats =
+        ofonoext_mm_handler_stats(bench->mm, &n);
+
+    printf("Handlers:\n");
+    for (i = 0; i < n; i++) {
+        const OfonoExtModemManagerHandlerStats* s = stats + i;
+
+        printf("  %s %p: %u call(s), %u slow, total %.3f ms, "
+            "max %" G_GUINT64_FORMAT " us\n", s->signal, s->fn,
+            s->count, s->slow, s->total_us/1000.0, s->max_us);
+    }
+    g_free(stats);
+}
+
+/* The journal is enabled after some changes have already happened */
+static
+gboolean
+bench_check_journal(
+    Bench* bench)
+{
+    OfonoExtModemManager* mm = bench->mm;
+    OfonoExtModemManagerEvent events[BENCH_CHECK_JOURNAL_SIZE * 2];
+    const guint64 start = ofonoext_mm_generation(mm);
+    gboolean lost = FALSE;
+    GVariant* reply;
+    guint64 last;
+    guint i, n;
+
+    BENCH_CHECK(start > 0);
+    ofonoext_mm_set_journal_size(mm, BENCH_CHECK_JOURNAL_SIZE);
+
+    /* Those have never been journalled, and nothing has changed yet */
+    n = ofonoext_mm_events_since(mm, start - 1, events,
+        G_N_ELEMENTS(events), &lost);
+    BENCH_CHECK(!n && lost);
+    n = ofonoext_mm_events_since(mm, start, events, G_N_ELEMENTS(events),
+        &lost);
+    BENCH_CHECK(!n && !lost);
+
+    /* Overflow the journal */
+    reply = bench_control(bench, "Start", g_variant_new("(u)",
+        BENCH_CHECK_JOURNAL_SIZE * 8));
+    BENCH_CHECK(reply);
+    g_variant_unref(reply);
+    last = ofonoext_mm_generation(mm);
+    BENCH_CHECK(last - start > BENCH_CHECK_JOURNAL_SIZE);
+
+    /* The oldest events are gone, the rest are in order */
+    n = ofonoext_mm_events_since(mm, start, events, G_N_ELEMENTS(events),
+        &lost);
+    BENCH_CHECK(n == BENCH_CHECK_JOURNAL_SIZE && lost);
+    for (i = 0; i < n; i++) {
+        BENCH_CHECK(events[i].seq == last - n + 1 + i);
+        BENCH_CHECK(events[i].change != OFONOEXT_MM_CHANGED_NONE);
+    }
+    n = ofonoext_mm_events_since(mm, last - 2, events, G_N_ELEMENTS(events),
+        &lost);
+    BENCH_CHECK(n == 2 && !lost && events[1].seq == last);
+    n = ofonoext_mm_events_since(mm, last, events, G_N_ELEMENTS(events),
+        &lost);
+    BENCH_CHECK(!n && !lost);
+    ofonoext_mm_set_journal_size(mm, 0);
+    return TRUE;
+}
+
+static
+void
+bench_check_sim_settings_valid(
+    OfonoExtSimSettings* ss,
+    void* data)
+{
+    Bench* bench = data;
+
+    g_main_loop_quit(bench->loop);
+}
+
+static
+gboolean
+bench_check_sim_settings_wait(
+    Bench* bench,
+    OfonoExtSimSettings* ss,
+    gboolean valid)
+{
+    if (ss->valid != valid) {
+        const gulong id = ofonoext_sim_settings_add_valid_changed_handler(ss,
+            bench_check_sim_settings_valid, bench);
+
+        bench_run_loop(bench, BENCH_CHECK_SIM_SETTINGS_SEC);
+        ofonoext_sim_settings_remove_handler(ss, id);
+    }
+    return ss->valid == valid;
+}
+
+static
+gboolean
+bench_check_sim_settings_control(
+    Bench* bench,
+    const char* method,
+    GVariant* args)
+{
+    GVariant* reply = bench_control(bench, method, args);
+
+    if (reply) {
+        g_variant_unref(reply);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static
+guint
+bench_check_sim_settings_calls(
+    Bench* bench)
+{
+    GVariant* reply = bench_control(bench, "SimSettingsCalls", NULL);
+    guint calls = 0;
+
+    if (reply) {
+        g_variant_get(reply, "(u)", &calls);
+        g_variant_unref(reply);
+    }
+    return calls;
+}
+
+static
+gboolean
+bench_check_sim_settings_shared(
+    Bench* bench,
+    OfonoExtSimSettings* ss[3])
+{
+    ss[0] = ofonoext_sim_settings_new("/ril_0");
+    ss[1] = ofonoext_sim_settings_new("/ril_0");
+    ss[2] = ofonoext_sim_settings_new("/ril_1");
+
+    /* One instance per path */
+    BENCH_CHECK(ss[0] && ss[0] == ss[1]);
+    BENCH_CHECK(ss[2] && ss[2] != ss[0]);
+    BENCH_CHECK(bench_check_sim_settings_wait(bench, ss[0], TRUE));
+    BENCH_CHECK(bench_check_sim_settings_wait(bench, ss[2], TRUE));
+    BENCH_CHECK(!g_strcmp0(ofonoext_sim_settings_get_string(ss[0],
+        "DisplayName"), "SIM1"));
+    BENCH_CHECK(!g_strcmp0(ofonoext_sim_settings_get_string(ss[2],
+        "DisplayName"), "SIM2"));
+
+    /* The interface goes away and comes back */
+    BENCH_CHECK(bench_check_sim_settings_control(bench, "SimSettings",
+        g_variant_new("(ub)", 0, FALSE)));
+    BENCH_CHECK(bench_check_sim_settings_wait(bench, ss[0], FALSE));
+    BENCH_CHECK(!ofonoext_sim_settings_get_string(ss[0], "DisplayName"));
+    BENCH_CHECK(ss[2]->valid);
+    BENCH_CHECK(bench_check_sim_settings_control(bench, "SimSettings",
+        g_variant_new("(ub)", 0, TRUE)));
+    BENCH_CHECK(bench_check_sim_settings_wait(bench, ss[0], TRUE));
+    BENCH_CHECK(!g_strcmp0(ofonoext_sim_settings_get_string(ss[0],
+        "DisplayName"), "SIM1"));
+    return TRUE;
+}
+
+static
+gboolean
+bench_check_sim_settings_retry(
+    Bench* bench,
+    OfonoExtSimSettings** ss)
+{
+    guint calls;
+
+    /* The first GetProperties times out, the retry succeeds */
+    BENCH_CHECK(bench_check_sim_settings_control(bench, "SimSettingsFail",
+        g_variant_new("(u)", 1)));
+    calls = bench_check_sim_settings_calls(bench);
+    *ss = ofonoext_sim_settings_new("/ril_1");
+    BENCH_CHECK(*ss);
+    BENCH_CHECK(bench_check_sim_settings_wait(bench, *ss, TRUE));
+    BENCH_CHECK(bench_check_sim_settings_calls(bench) == calls + 2);
+    BENCH_CHECK(!g_strcmp0(ofonoext_sim_settings_get_string(*ss,
+        "DisplayName"), "SIM2"));
+    return TRUE;
+}
+
+static
+gboolean
+bench_check_sim_settings(
+    Bench* bench)
+{
+    OfonoExtSimSettings* ss[3];
+    gpointer weak[2];
+    gboolean ok;
+    guint i;
+
+    ok = bench_check_sim_settings_shared(bench, ss);
+    weak[0] = ss[0];
+    weak[1] = ss[2];
+    for (i = 0; i < G_N_ELEMENTS(weak); i++) {
+        if (weak[i]) {
+            g_object_add_weak_pointer(G_OBJECT(weak[i]), weak + i);
+        }
+    }
+    for (i = 0; i < G_N_ELEMENTS(ss); i++) {
+        ofonoext_sim_settings_unref(ss[i]);
+    }
+    if (ok) {
+        /* Nothing else holds a reference, the next one is a new instance */
+        BENCH_CHECK(!weak[0] && !weak[1]);
+        ok = bench_check_sim_settings_retry(bench, ss);
+        ofonoext_sim_settings_unref(ss[0]);
+    }
+    return ok;
+}
+
+static
+int
+bench_check(
+    Bench* bench)
+{
+    static const struct bench_check {
+        const char* name;
+        gboolean (*fn)(Bench* bench);
+    } checks[] = {
+        { "journal", bench_check_journal },
+        { "sim-settings", bench_check_sim_settings }
+    };
+    int ret = RET_OK;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(checks); i++) {
+        const gboolean ok = checks[i].fn(bench);
+
+        printf("Check %s: %s\n", checks[i].name, ok ? "ok" : "FAILED");
+        if (!ok) {
+            ret = RET_ERR;
+        }
+    }
+    return ret;
+}
+
+static
+int
+bench_workload(
+    Bench* bench)
+{
+    int ret = RET_OK;
+    GError* error = NULL;
+    gulong batch_id = 0;
+    guint64 seq = 0;
+    OFONOEXT_MM_FLAGS flags = OFONOEXT_MM_FLAGS_NONE;
+    OfonoExtExporter* exporter = NULL;
+
+    if (bench->worker) {
+        flags |= OFONOEXT_MM_FLAG_WORKER_THREAD;
+    }
+    if (bench->private_bus) {
+        flags |= OFONOEXT_MM_FLAG_PRIVATE_BUS;
+    }
+    bench->mm = flags ? ofonoext_mm_new_with_flags(flags) :
+        ofonoext_mm_new();
+    if (bench->handler_budget >= 0) {
+        ofonoext_mm_set_handler_timing(bench->mm, TRUE,
+            bench->handler_budget);
+    }
+    if (bench->journal > 0) {
+        ofonoext_mm_set_journal_size(bench->mm, bench->journal);
+    }
+    if (bench->batch >= 0) {
+        bench->batch_calls = 0;
+        batch_id = ofonoext_mm_add_batch_handler(bench->mm,
+            OFONOEXT_MM_CHANGED_ALL, bench->batch, bench_batch, bench);
+    }
+    if (bench->metrics) {
+        exporter = ofonoext_exporter_new(bench->metrics, &error);
+        if (exporter) {
+            ofonoext_exporter_add(exporter, bench->mm);
+        } else {
+            GERR("%s", GERRMSG(error));
+            g_clear_error(&error);
+        }
+    }
+    if (bench->record && !ofonoext_mm_start_recording(bench->mm,
+        bench->record, 0, &error)) {
+        GERR("%s", GERRMSG(error));
+        g_error_free(error);
+        ret = RET_ERR;
+    } else if (!bench_wait_valid(bench, bench->timeout)) {
+        GERR("Startup timed out");
+        ret = RET_TIMEOUT;
+    } else if (bench->check) {
+        ret = bench_check(bench);
+    } else if (bench->replay) {
+        seq = ofonoext_mm_generation(bench->mm);
+        ret = bench_replay(bench);
+    } else if (bench->churn > 0) {
+        ret = bench_churn(bench);
+    } else if (bench->probe > 0) {
+        ret = bench_latency(bench);
+    } else if (bench->signals > 0) {
+        seq = ofonoext_mm_generation(bench->mm);
+        ret = bench_throughput(bench);
+    }
+    if (bench->journal > 0) {
+        bench_print_journal(bench, seq);
+    }
+    if (bench->handler_budget >= 0) {
+        bench_print_handler_stats(bench);
+    }
+    if (batch_id) {
+        printf("Batch: %u call(s), interval %d ms\n", bench->batch_calls,
+            bench->batch);
+        ofonoext_mm_remove_handler(bench->mm, batch_id);
+    }
+    if (exporter) {
+        char* text = ofonoext_exporter_snapshot(exporter);
+
+        printf("Metrics:\n%s", text);
+        g_free(text);
+        ofonoext_exporter_free(exporter);
+    }
+    ofonoext_mm_unref(bench->mm);
+    bench->mm = NULL;
+    return ret;
+}
+
+static
+int
+bench_run(
+    Bench* bench)
+{
+    int ret = RET_ERR;
+    GError* error = NULL;
+
+    if (bench->scenario) {
+        /* The offline backend needs neither the bus nor the mock */
+        bench->loop = g_main_loop_new(NULL, FALSE);
+        ret = bench_scenario(bench);
+        printf("Memory: RSS %ld kB, peak %ld kB\n",
+            bench_status_kb("VmRSS:"), bench_status_kb("VmHWM:"));
+        g_main_loop_unref(bench->loop);
+        return ret;
+    }
+
+    bench->dbus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(bench->dbus);
+
+    /* Make the library connect to our private bus */
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS",
+        g_test_dbus_get_bus_address(bench->dbus), TRUE);
+    GDEBUG("Bus address %s", g_test_dbus_get_bus_address(bench->dbus));
+
+    bench->loop = g_main_loop_new(NULL, FALSE);
+    bench->bus = g_bus_get_sync(OFONO_BUS_TYPE, NULL, &error);
+    if (!bench->bus) {
+        GERR("%s", GERRMSG(error));
+        g_error_free(error);
+    } else if (bench_start_mock(bench)) {
+        const guint32 v = ofonoext_version();
+        printf("libgofonoext %u.%u.%u, interface version %d, %d slot(s), "
+            "latency %d ms\n", v >> 24, (v >> 16) & 0xff, v & 0xffff,
+            bench->version, bench->slots, bench->latency);
+        ret = bench_startup(bench);
+        if (ret == RET_OK && bench->threads > 0) {
+            ret = bench_threads(bench);
+        }
+        if (ret == RET_OK) {
+            ret = bench_workload(bench);
+        }
+        printf("Memory: RSS %ld kB, peak %ld kB\n",
+            bench_status_kb("VmRSS:"), bench_status_kb("VmHWM:"));
+        bench_stop_mock(bench);
+    }
+    if (bench->bus) {
+        g_object_unref(bench->bus);
+    }
+    g_main_loop_unref(bench->loop);
+    g_test_dbus_down(bench->dbus);
+    g_object_unref(bench->dbus);
+    return ret;
+}
+
+static
+gboolean
+bench_opt_verbose(
+    const gchar* name,
+    const gchar* value,
+    gpointer data,
+    GError** error)
+{
+    gutil_log_default.level = GLOG_LEVEL_VERBOSE;
+    return TRUE;
+}
+
+static
+char*
+bench_abs_path(
+    char* path)
+{
+    if (path && !g_path_is_absolute(path)) {
+        char* dir = g_get_current_dir();
+        char* abs = g_build_filename(dir, path, NULL);
+        g_free(dir);
+        g_free(path);
+        return abs;
+    }
+    return path;
+}
+
+static
+gboolean
+bench_init(
+    Bench* bench,
+    int argc,
+    char* argv[])
+{
+    gboolean ok = FALSE;
+    GOptionEntry entries[] = {
+        { "verbose", 'v', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
+          bench_opt_verbose, "Enable verbose output", NULL },
+        { "mock", 'm', 0, G_OPTION_ARG_FILENAME,
+          &bench->mock, "Mock service executable", "FILE" },
+        { "slots", 's', 0, G_OPTION_ARG_INT,
+          &bench->slots, "Number of modem slots [2]", "N" },
+        { "version", 'V', 0, G_OPTION_ARG_INT,
+          &bench->version, "Interface version, 1 to 5 [5]", "N" },
+        { "latency", 'l', 0, G_OPTION_ARG_INT,
+          &bench->latency, "Mock reply latency in milliseconds [0]", "MS" },
+        { "rate", 'r', 0, G_OPTION_ARG_INT,
+          &bench->rate, "Signals per second, 0 = unlimited [0]", "N" },
+        { "signals", 'n', 0, G_OPTION_ARG_INT,
+          &bench->signals, "Number of signals to send [100000]", "N" },
+        { "runs", 'R', 0, G_OPTION_ARG_INT,
+          &bench->runs, "Number of startup runs [20]", "N" },
+        { "threads", 'T', 0, G_OPTION_ARG_INT,
+          &bench->threads, "Concurrent create/unref threads [0]", "N" },
+        { "iterations", 'I', 0, G_OPTION_ARG_INT,
+          &bench->iterations, "Create/unref iterations per thread "
+          "[10000]", "N" },
+        { "replay", 0, 0, G_OPTION_ARG_FILENAME,
+          &bench->replay, "Replay the trace instead of the synthetic "
+          "workload", "FILE" },
+        { "realtime", 0, 0, G_OPTION_ARG_NONE,
+          &bench->realtime, "Replay with the recorded timing", NULL },
+        { "churn", 0, 0, G_OPTION_ARG_INT,
+          &bench->churn, "Measure N resync cycles instead of the synthetic "
+          "workload", "N" },
+        { "probe", 0, 0, G_OPTION_ARG_INT,
+          &bench->probe, "Measure the latency of N signals instead of "
+          "the synthetic workload", "N" },
+        { "probe-interval", 0, 0, G_OPTION_ARG_INT,
+          &bench->probe_interval, "Interval between the probes [10]",
+          "MS" },
+        { "busy", 0, 0, G_OPTION_ARG_INT,
+          &bench->busy, "Keep the main loop busy for MS out of every "
+          G_STRINGIFY(BENCH_FRAME_MS) " ms [0]", "MS" },
+        { "worker", 0, 0, G_OPTION_ARG_NONE,
+          &bench->worker, "Receive the signals on a worker thread", NULL },
+        { "private-bus", 0, 0, G_OPTION_ARG_NONE,
+          &bench->private_bus, "Give the modem manager its own bus "
+          "connection", NULL },
+        { "noise", 0, 0, G_OPTION_ARG_INT,
+          &bench->noise, "Flood the shared connection with N unrelated "
+          "signals per second while probing [0]", "N" },
+        { "noise-size", 0, 0, G_OPTION_ARG_INT,
+          &bench->noise_size, "Size of each noise signal [4096]", "BYTES" },
+        { "scenario", 0, 0, G_OPTION_ARG_FILENAME,
+          &bench->scenario, "Run consumers of the offline backend instead "
+          "of the mock", "FILE" },
+        { "instances", 0, 0, G_OPTION_ARG_INT,
+          &bench->instances, "Number of scenario instances [100]", "N" },
+        { "duration", 0, 0, G_OPTION_ARG_INT,
+          &bench->duration, "How long to run the scenario [5]", "SECONDS" },
+        { "handler-budget", 0, 0, G_OPTION_ARG_INT,
+          &bench->handler_budget, "Time the handlers, report those "
+          "slower than US (0 = no budget)", "US" },
+        { "batch", 0, 0, G_OPTION_ARG_INT,
+          &bench->batch, "Also count the deliveries to a batch handler "
+          "with this interval (0 = at idle)", "MS" },
+        { "journal", 0, 0, G_OPTION_ARG_INT,
+          &bench->journal, "Keep a journal of N changes and page through "
+          "it after the workload", "N" },
+        { "metrics", 0, 0, G_OPTION_ARG_STRING,
+          &bench->metrics, "Export the metrics at this socket and print "
+          "them after the workload", "PATH" },
+        { "check", 0, 0, G_OPTION_ARG_NONE,
+          &bench->check, "Run the self-checks instead of the workload",
+          NULL },
+        { "record", 0, 0, G_OPTION_ARG_FILENAME,
+          &bench->record, "Run the workload with the recorder on", "FILE" },
+        { "timeout", 't', 0, G_OPTION_ARG_INT,
+          &bench->timeout, "Timeout in seconds [60]", "SECONDS" },
+        { NULL }
+    };
+    GError* error = NULL;
+    GOptionContext* options = g_option_context_new(NULL);
+    g_option_context_add_main_entries(options, entries, NULL);
+    g_option_context_set_summary(options,
+        "Runs libgofonoext against the mock ModemManager service\n"
+        "on a private D-Bus daemon.");
+    if (g_option_context_parse(options, &argc, &argv, &error)) {
+        if (argc == 1 && bench->slots > 0 && bench->timeout > 0 &&
+            bench->version >= 1 && bench->version <= 5 &&
+            bench->instances > 0 && bench->duration > 0 &&
+            bench->noise >= 0 && bench->noise_size >= 0) {
+            if (!bench->mock) {
+                char* dir = g_path_get_dirname(argv[0]);
+                bench->mock = g_build_filename(dir, BENCH_MOCK_NAME, NULL);
+                g_free(dir);
+            }
+            /* The mock may have a different working directory */
+            bench->replay = bench_abs_path(bench->replay);
+            ok = TRUE;
+        } else {
+            char* help = g_option_context_get_help(options, TRUE, NULL);
+            fprintf(stderr, "%s", help);
+            g_free(help);
+        }
+    } else {
+        GERR("%s", error->message);
+        g_error_free(error);
+    }
+    g_option_context_free(options);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    int ret = RET_ERR;
+    Bench bench;
+    memset(&bench, 0, sizeof(bench));
+    bench.slots = 2;
+    bench.version = 5;
+    bench.signals = 100000;
+    bench.runs = 20;
+    bench.iterations = 10000;
+    bench.timeout = 60;
+    bench.probe_interval = 10;
+    bench.instances = 100;
+    bench.duration = 5;
+    bench.handler_budget = -1;
+    bench.batch = -1;
+    bench.noise_size = 4096;
+    gutil_log_timestamp = FALSE;
+    gutil_log_set_type(GLOG_TYPE_STDERR, "mm-bench");
+    gutil_log_default.level = GLOG_LEVEL_DEFAULT;
+    if (bench_init(&bench, argc, argv)) {
+        ret = bench_run(&bench);
+    }
+    g_free(bench.mock);
+    g_free(bench.replay);
+    g_free(bench.record);
+    g_free(bench.metrics);
+    g_free(bench.scenario);
+    return ret;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
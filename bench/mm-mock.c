@@ -0,0 +1,1677 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "org.nemomobile.ofono.ModemManager.h"
+
+#include <gofono_names.h>
+
+#include <gutil_log.h>
+#include <gutil_strv.h>
+
+#include <glib-unix.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RET_OK          (0)
+#define RET_ERR         (2)
+
+#define MOCK_CONTROL_PATH "/mock"
+#define MOCK_CONTROL_INTERFACE "org.nemomobile.ofono.ModemManagerMock"
+
+/* Just enough of ofono for OfonoModem and OfonoExtSimSettings */
+#define MOCK_MANAGER_INTERFACE "org.ofono.Manager"
+#define MOCK_MODEM_INTERFACE "org.ofono.Modem"
+#define MOCK_SIM_SETTINGS_INTERFACE "org.nemomobile.ofono.SimSettings"
+
+/* Number of signals emitted per main loop iteration in flat-out mode */
+#define MOCK_BATCH (64)
+
+/* How long replay waits for the client to fetch the state after
+ * re-acquiring the service name */
+#define MOCK_RESYNC_TIMEOUT_MS (1000)
+
+static const char mock_control_xml[] =
+    "<node>"
+    "  <interface name='" MOCK_CONTROL_INTERFACE "'>"
+    "    <method name='Start'>"
+    "      <arg name='count' type='u' direction='in'/>"
+    "    </method>"
+    "    <method name='Replay'>"
+    "      <arg name='file' type='s' direction='in'/>"
+    "      <arg name='realtime' type='b' direction='in'/>"
+    "      <arg name='count' type='u' direction='out'/>"
+    "    </method>"
+    "    <method name='Probe'>"
+    "      <arg name='count' type='u' direction='in'/>"
+    "      <arg name='interval' type='u' direction='in'/>"
+    "    </method>"
+    "    <method name='Resync'>"
+    "      <arg name='cycles' type='u' direction='in'/>"
+    "      <arg name='count' type='u' direction='out'/>"
+    "    </method>"
+    "    <method name='Noise'>"
+    "      <arg name='rate' type='u' direction='in'/>"
+    "      <arg name='size' type='u' direction='in'/>"
+    "    </method>"
+    "    <signal name='Noise'>"
+    "      <arg name='payload' type='ay'/>"
+    "    </signal>"
+    "    <method name='SimSettings'>"
+    "      <arg name='slot' type='u' direction='in'/>"
+    "      <arg name='present' type='b' direction='in'/>"
+    "    </method>"
+    "    <method name='SimSettingsFail'>"
+    "      <arg name='count' type='u' direction='in'/>"
+    "    </method>"
+    "    <method name='SimSettingsCalls'>"
+    "      <arg name='count' type='u' direction='out'/>"
+    "    </method>"
+    "  </interface>"
+    "</node>";
+
+static const char mock_ofono_xml[] =
+    "<node>"
+    "  <interface name='" MOCK_MANAGER_INTERFACE "'>"
+    "    <method name='GetModems'>"
+    "      <arg name='modems' type='a(oa{sv})' direction='out'/>"
+    "    </method>"
+    "    <signal name='ModemAdded'>"
+    "      <arg name='path' type='o'/>"
+    "      <arg name='properties' type='a{sv}'/>"
+    "    </signal>"
+    "    <signal name='ModemRemoved'>"
+    "      <arg name='path' type='o'/>"
+    "    </signal>"
+    "  </interface>"
+    "  <interface name='" MOCK_MODEM_INTERFACE "'>"
+    "    <method name='GetProperties'>"
+    "      <arg name='properties' type='a{sv}' direction='out'/>"
+    "    </method>"
+    "    <signal name='PropertyChanged'>"
+    "      <arg name='name' type='s'/>"
+    "      <arg name='value' type='v'/>"
+    "    </signal>"
+    "  </interface>"
+    "  <interface name='" MOCK_SIM_SETTINGS_INTERFACE "'>"
+    "    <method name='GetProperties'>"
+    "      <arg name='properties' type='a{sv}' direction='out'/>"
+    "    </method>"
+    "    <method name='SetProperty'>"
+    "      <arg name='name' type='s' direction='in'/>"
+    "      <arg name='value' type='v' direction='in'/>"
+    "    </method>"
+    "    <signal name='PropertyChanged'>"
+    "      <arg name='name' type='s'/>"
+    "      <arg name='value' type='v'/>"
+    "    </signal>"
+    "  </interface>"
+    "</node>";
+
+typedef enum mock_event_type {
+    MOCK_EVENT_ENABLED_MODEMS,
+    MOCK_EVENT_PRESENT_SIMS,
+    MOCK_EVENT_DATA_IMSI,
+    MOCK_EVENT_VOICE_IMSI,
+    MOCK_EVENT_DATA_MODEM,
+    MOCK_EVENT_VOICE_MODEM,
+    MOCK_EVENT_MMS_IMSI,
+    MOCK_EVENT_MMS_MODEM,
+    MOCK_EVENT_READY,
+    MOCK_EVENT_NAME_LOST,
+    MOCK_EVENT_NAME_ACQUIRED
+} MOCK_EVENT_TYPE;
+
+static const char* mock_event_names[] = {
+    "EnabledModemsChanged",
+    "PresentSimsChanged",
+    "DefaultDataSimChanged",
+    "DefaultVoiceSimChanged",
+    "DefaultDataModemChanged",
+    "DefaultVoiceModemChanged",
+    "MmsSimChanged",
+    "MmsModemChanged",
+    "ReadyChanged",
+    "NameLost",
+    "NameAcquired"
+};
+
+typedef struct mock_event {
+    gint64 time;        /* Milliseconds since the start of the trace */
+    MOCK_EVENT_TYPE type;
+    char* str;
+    GStrV* strv;
+    gint index;
+    gboolean flag;
+} MockEvent;
+
+typedef struct mock {
+    GMainLoop* loop;
+    GDBusConnection* bus;
+    GDBusNodeInfo* control_info;
+    GDBusNodeInfo* ofono_info;
+    guint* ofono_id;            /* Manager, then modem + SimSettings */
+    OrgNemomobileOfonoModemManager* skel;
+    guint own_name_id;
+    guint control_id;
+    gint version;
+    gint slots;
+    gint latency;
+    gint rate;
+    GStrV* available;
+    GStrV* enabled;
+    GStrV* imei;
+    GStrV* imsi;
+    gboolean* present;
+    char* data_imsi;
+    char* voice_imsi;
+    char* mms_imsi;
+    char* data_path;
+    char* voice_path;
+    char* mms_path;
+    gboolean ready;
+    gboolean* sim_settings;     /* Whether the modem has SimSettings */
+    GStrV* sim_names;           /* DisplayName of each SimSettings */
+    guint sim_settings_fail;    /* Fail this many GetProperties calls */
+    guint sim_settings_calls;
+    gboolean owner;
+    guint get_all_count;
+    GDBusMethodInvocation* control_call;
+    /* Synthetic workload */
+    guint gen_id;
+    guint gen_count;
+    guint gen_sent;
+    gint64 gen_start;
+    /* Latency probes */
+    guint probe_id;
+    guint probe_count;
+    guint probe_sent;
+    /* Unrelated traffic */
+    guint noise_id;
+    guint noise_rate;
+    guint noise_sent;
+    gint64 noise_start;
+    GVariant* noise_payload;
+    /* Replay */
+    GPtrArray* replay;
+    guint replay_pos;
+    guint replay_id;
+    gboolean replay_realtime;
+    gint64 replay_start;
+    guint replay_resync;
+    gint64 replay_resync_deadline;
+    int ret;
+} Mock;
+
+typedef struct mock_reply {
+    Mock* mock;
+    GDBusMethodInvocation* call;
+    int version;
+} MockReply;
+
+static
+void
+mock_set_str(
+    char** ptr,
+    const char* value)
+{
+    g_free(*ptr);
+    *ptr = g_strdup(value);
+}
+
+static
+GVariant*
+mock_present_sims(
+    Mock* mock)
+{
+    gint i;
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("ab"));
+    for (i = 0; i < mock->slots; i++) {
+        g_variant_builder_add(&builder, "b", mock->present[i]);
+    }
+    return g_variant_builder_end(&builder);
+}
+
+static
+void
+mock_toggle_enabled(
+    Mock* mock,
+    gint slot)
+{
+    const char* path = mock->available[slot];
+    const int pos = gutil_strv_find(mock->enabled, path);
+    if (pos < 0) {
+        mock->enabled = gutil_strv_add(mock->enabled, path);
+    } else {
+        mock->enabled = gutil_strv_remove_at(mock->enabled, pos, TRUE);
+    }
+}
+
+static
+gint
+mock_find_imsi(
+    Mock* mock,
+    const char* imsi)
+{
+    return (imsi && imsi[0]) ? gutil_strv_find(mock->imsi, imsi) : -1;
+}
+
+static
+const char*
+mock_slot_path(
+    Mock* mock,
+    gint slot)
+{
+    return (slot >= 0) ? mock->available[slot] : "";
+}
+
+static
+void
+mock_return_control_call(
+    Mock* mock,
+    GVariant* result)
+{
+    if (mock->control_call) {
+        /* Make sure that the reply follows all the signals */
+        g_dbus_method_invocation_return_value(mock->control_call, result);
+        mock->control_call = NULL;
+    } else if (result) {
+        g_variant_unref(g_variant_ref_sink(result));
+    }
+}
+
+static
+gboolean
+mock_reply_cb(
+    gpointer data)
+{
+    MockReply* reply = data;
+    Mock* mock = reply->mock;
+    OrgNemomobileOfonoModemManager* skel = mock->skel;
+    const gchar* const* available = (const gchar* const*)mock->available;
+    const gchar* const* enabled = (const gchar* const*)mock->enabled;
+    const gchar* const* imei = (const gchar* const*)mock->imei;
+
+    switch (reply->version) {
+    case 1:
+        org_nemomobile_ofono_modem_manager_complete_get_all(skel,
+            reply->call, mock->version, available, enabled, mock->data_imsi,
+            mock->voice_imsi, mock->data_path, mock->voice_path);
+        break;
+    case 2:
+        org_nemomobile_ofono_modem_manager_complete_get_all2(skel,
+            reply->call, mock->version, available, enabled, mock->data_imsi,
+            mock->voice_imsi, mock->data_path, mock->voice_path,
+            mock_present_sims(mock));
+        break;
+    case 3:
+        org_nemomobile_ofono_modem_manager_complete_get_all3(skel,
+            reply->call, mock->version, available, enabled, mock->data_imsi,
+            mock->voice_imsi, mock->data_path, mock->voice_path,
+            mock_present_sims(mock), imei);
+        break;
+    case 4:
+        org_nemomobile_ofono_modem_manager_complete_get_all4(skel,
+            reply->call, mock->version, available, enabled, mock->data_imsi,
+            mock->voice_imsi, mock->data_path, mock->voice_path,
+            mock_present_sims(mock), imei, mock->mms_imsi, mock->mms_path);
+        break;
+    default:
+        org_nemomobile_ofono_modem_manager_complete_get_all5(skel,
+            reply->call, mock->version, available, enabled, mock->data_imsi,
+            mock->voice_imsi, mock->data_path, mock->voice_path,
+            mock_present_sims(mock), imei, mock->mms_imsi, mock->mms_path,
+            mock->ready);
+        break;
+    }
+
+    /* The last call of the initialization sequence */
+    if (reply->version == 1 ? (mock->version == 1) :
+        (reply->version == mock->version)) {
+        mock->get_all_count++;
+    }
+    g_free(reply);
+    return G_SOURCE_REMOVE;
+}
+
+static
+gboolean
+mock_reply(
+    Mock* mock,
+    GDBusMethodInvocation* call,
+    int version)
+{
+    MockReply* reply = g_new0(MockReply, 1);
+    reply->mock = mock;
+    reply->call = call;
+    reply->version = version;
+    GDEBUG("GetAll%d", version);
+    if (mock->latency > 0) {
+        g_timeout_add(mock->latency, mock_reply_cb, reply);
+    } else {
+        mock_reply_cb(reply);
+    }
+    return TRUE;
+}
+
+static
+gboolean
+mock_handle_get_all(
+    OrgNemomobileOfonoModemManager* skel,
+    GDBusMethodInvocation* call,
+    gpointer mock)
+{
+    return mock_reply(mock, call, 1);
+}
+
+static
+gboolean
+mock_handle_get_all2(
+    OrgNemomobileOfonoModemManager* skel,
+    GDBusMethodInvocation* call,
+    gpointer mock)
+{
+    return mock_reply(mock, call, 2);
+}
+
+static
+gboolean
+mock_handle_get_all3(
+    OrgNemomobileOfonoModemManager* skel,
+    GDBusMethodInvocation* call,
+    gpointer mock)
+{
+    return mock_reply(mock, call, 3);
+}
+
+static
+gboolean
+mock_handle_get_all4(
+    OrgNemomobileOfonoModemManager* skel,
+    GDBusMethodInvocation* call,
+    gpointer mock)
+{
+    return mock_reply(mock, call, 4);
+}
+
+static
+gboolean
+mock_handle_get_all5(
+    OrgNemomobileOfonoModemManager* skel,
+    GDBusMethodInvocation* call,
+    gpointer mock)
+{
+    return mock_reply(mock, call, 5);
+}
+
+static
+void
+mock_set_data_imsi(
+    Mock* mock,
+    const char* imsi)
+{
+    mock_set_str(&mock->data_imsi, imsi);
+    org_nemomobile_ofono_modem_manager_emit_default_data_sim_changed(
+        mock->skel, imsi);
+}
+
+static
+void
+mock_set_data_path(
+    Mock* mock,
+    const char* path)
+{
+    mock_set_str(&mock->data_path, path);
+    org_nemomobile_ofono_modem_manager_emit_default_data_modem_changed(
+        mock->skel, path);
+}
+
+static
+void
+mock_set_voice_imsi(
+    Mock* mock,
+    const char* imsi)
+{
+    mock_set_str(&mock->voice_imsi, imsi);
+    org_nemomobile_ofono_modem_manager_emit_default_voice_sim_changed(
+        mock->skel, imsi);
+}
+
+static
+void
+mock_set_voice_path(
+    Mock* mock,
+    const char* path)
+{
+    mock_set_str(&mock->voice_path, path);
+    org_nemomobile_ofono_modem_manager_emit_default_voice_modem_changed(
+        mock->skel, path);
+}
+
+static
+void
+mock_set_mms_imsi(
+    Mock* mock,
+    const char* imsi)
+{
+    mock_set_str(&mock->mms_imsi, imsi);
+    org_nemomobile_ofono_modem_manager_emit_mms_sim_changed(
+        mock->skel, imsi);
+}
+
+static
+void
+mock_set_mms_path(
+    Mock* mock,
+    const char* path)
+{
+    mock_set_str(&mock->mms_path, path);
+    org_nemomobile_ofono_modem_manager_emit_mms_modem_changed(
+        mock->skel, path);
+}
+
+static
+void
+mock_set_enabled(
+    Mock* mock,
+    const GStrV* enabled)
+{
+    if (enabled != mock->enabled) {
+        g_strfreev(mock->enabled);
+        mock->enabled = g_strdupv((char**)enabled);
+    }
+    org_nemomobile_ofono_modem_manager_emit_enabled_modems_changed(
+        mock->skel, (const gchar* const*)mock->enabled);
+}
+
+static
+void
+mock_set_present(
+    Mock* mock,
+    gint slot,
+    gboolean present)
+{
+    if (slot >= 0 && slot < mock->slots) {
+        mock->present[slot] = present;
+        org_nemomobile_ofono_modem_manager_emit_present_sims_changed(
+            mock->skel, slot, present);
+    }
+}
+
+static
+void
+mock_set_ready(
+    Mock* mock,
+    gboolean ready)
+{
+    mock->ready = ready;
+    org_nemomobile_ofono_modem_manager_emit_ready_changed(mock->skel, ready);
+}
+
+static
+gboolean
+mock_handle_set_enabled_modems(
+    OrgNemomobileOfonoModemManager* skel,
+    GDBusMethodInvocation* call,
+    const gchar* const* modems,
+    gpointer mock)
+{
+    org_nemomobile_ofono_modem_manager_complete_set_enabled_modems(skel, call);
+    mock_set_enabled(mock, (const GStrV*)modems);
+    return TRUE;
+}
+
+static
+gboolean
+mock_handle_set_default_data_sim(
+    OrgNemomobileOfonoModemManager* skel,
+    GDBusMethodInvocation* call,
+    const gchar* imsi,
+    gpointer data)
+{
+    Mock* mock = data;
+    const gint slot = mock_find_imsi(mock, imsi);
+    org_nemomobile_ofono_modem_manager_complete_set_default_data_sim(skel,
+        call);
+    mock_set_data_imsi(mock, (slot >= 0) ? imsi : "");
+    mock_set_data_path(mock, mock_slot_path(mock, slot));
+    return TRUE;
+}
+
+static
+gboolean
+mock_handle_set_default_voice_sim(
+    OrgNemomobileOfonoModemManager* skel,
+    GDBusMethodInvocation* call,
+    const gchar* imsi,
+    gpointer data)
+{
+    Mock* mock = data;
+    const gint slot = mock_find_imsi(mock, imsi);
+    org_nemomobile_ofono_modem_manager_complete_set_default_voice_sim(skel,
+        call);
+    mock_set_voice_imsi(mock, (slot >= 0) ? imsi : "");
+    mock_set_voice_path(mock, mock_slot_path(mock, slot));
+    return TRUE;
+}
+
+static
+gboolean
+mock_handle_set_mms_sim(
+    OrgNemomobileOfonoModemManager* skel,
+    GDBusMethodInvocation* call,
+    const gchar* imsi,
+    gpointer data)
+{
+    Mock* mock = data;
+    const gint slot = mock_find_imsi(mock, imsi);
+    org_nemomobile_ofono_modem_manager_complete_set_mms_sim(skel, call,
+        mock_slot_path(mock, slot));
+    mock_set_mms_imsi(mock, (slot >= 0) ? imsi : "");
+    mock_set_mms_path(mock, mock_slot_path(mock, slot));
+    return TRUE;
+}
+
+/*==========================================================================*
+ * Synthetic workload
+ *==========================================================================*/
+
+/*
+ * Emits one signal of the synthetic workload. The mix only contains
+ * signals supported by the configured interface version.
+ */
+static
+void
+mock_emit_next(
+    Mock* mock)
+{
+    const guint n = mock->gen_sent++;
+    const gint slot = (n / 8) % mock->slots;
+    const guint kinds = (mock->version >= 4) ? 8 :
+        (mock->version >= 2) ? 6 : 5;
+
+    switch (n % kinds) {
+    case 0:
+        mock_set_data_imsi(mock, mock->imsi[slot]);
+        break;
+    case 1:
+        mock_set_data_path(mock, mock->available[slot]);
+        break;
+    case 2:
+        mock_set_voice_imsi(mock, mock->imsi[(slot + 1) % mock->slots]);
+        break;
+    case 3:
+        mock_set_voice_path(mock, mock->available[(slot + 1) % mock->slots]);
+        break;
+    case 4:
+        mock_toggle_enabled(mock, slot);
+        mock_set_enabled(mock, mock->enabled);
+        break;
+    case 5:
+        mock_set_present(mock, slot, !mock->present[slot]);
+        break;
+    case 6:
+        mock_set_mms_imsi(mock, mock->imsi[slot]);
+        break;
+    case 7:
+        mock_set_mms_path(mock, mock->available[slot]);
+        break;
+    }
+}
+
+static
+gboolean
+mock_generator_cb(
+    gpointer data)
+{
+    Mock* mock = data;
+    guint due;
+
+    if (mock->rate > 0) {
+        const gint64 elapsed = g_get_monotonic_time() - mock->gen_start;
+        due = MIN(elapsed * mock->rate / G_USEC_PER_SEC, mock->gen_count);
+    } else {
+        due = MIN(mock->gen_sent + MOCK_BATCH, mock->gen_count);
+    }
+    while (mock->gen_sent < due) {
+        mock_emit_next(mock);
+    }
+    if (mock->gen_sent < mock->gen_count) {
+        return G_SOURCE_CONTINUE;
+    } else {
+        GDEBUG("Sent %u signal(s)", mock->gen_sent);
+        mock->gen_id = 0;
+        mock_return_control_call(mock, NULL);
+        return G_SOURCE_REMOVE;
+    }
+}
+
+static
+void
+mock_start(
+    Mock* mock,
+    guint count)
+{
+    GDEBUG("Sending %u signal(s)", count);
+    mock->gen_count = count;
+    mock->gen_sent = 0;
+    mock->gen_start = g_get_monotonic_time();
+    mock->gen_id = (mock->rate > 0) ?
+        g_timeout_add(1, mock_generator_cb, mock) :
+        g_idle_add(mock_generator_cb, mock);
+}
+
+/*==========================================================================*
+ * Latency probes
+ *
+ * Each probe is a DefaultDataSimChanged signal carrying the monotonic
+ * time (in microseconds) when it was sent. The clock is the same for
+ * all processes, so the receiver can tell how long the delivery took.
+ *==========================================================================*/
+
+static
+gboolean
+mock_probe_cb(
+    gpointer data)
+{
+    Mock* mock = data;
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "%" G_GINT64_FORMAT, g_get_monotonic_time());
+    mock_set_data_imsi(mock, buf);
+    if (++mock->probe_sent < mock->probe_count) {
+        return G_SOURCE_CONTINUE;
+    } else {
+        GDEBUG("Sent %u probe(s)", mock->probe_sent);
+        mock->probe_id = 0;
+        mock_return_control_call(mock, NULL);
+        return G_SOURCE_REMOVE;
+    }
+}
+
+static
+void
+mock_probe(
+    Mock* mock,
+    guint count,
+    guint interval)
+{
+    GDEBUG("Sending %u probe(s)", count);
+    mock->probe_count = count;
+    mock->probe_sent = 0;
+    if (count) {
+        mock->probe_id = g_timeout_add(MAX(interval, 1), mock_probe_cb,
+            mock);
+    } else {
+        mock_return_control_call(mock, NULL);
+    }
+}
+
+/*==========================================================================*
+ * Noise
+ *
+ * Broadcasts Noise signals at the requested rate, until it's changed
+ * to zero. They have nothing to do with ModemManager, they are only
+ * there to keep the bus (and the client connections subscribed to
+ * them) busy.
+ *==========================================================================*/
+
+static
+gboolean
+mock_noise_cb(
+    gpointer data)
+{
+    Mock* mock = data;
+    const gint64 elapsed = g_get_monotonic_time() - mock->noise_start;
+    const guint64 due = (guint64)elapsed * mock->noise_rate / 1000000;
+
+    while (mock->noise_sent < due) {
+        g_dbus_connection_emit_signal(mock->bus, NULL, MOCK_CONTROL_PATH,
+            MOCK_CONTROL_INTERFACE, "Noise", g_variant_new("(@ay)",
+            mock->noise_payload), NULL);
+        mock->noise_sent++;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static
+void
+mock_noise_stop(
+    Mock* mock)
+{
+    if (mock->noise_id) {
+        GDEBUG("Sent %u noise signal(s)", mock->noise_sent);
+        g_source_remove(mock->noise_id);
+        mock->noise_id = 0;
+    }
+    if (mock->noise_payload) {
+        g_variant_unref(mock->noise_payload);
+        mock->noise_payload = NULL;
+    }
+}
+
+static
+void
+mock_noise(
+    Mock* mock,
+    guint rate,
+    guint size)
+{
+    mock_noise_stop(mock);
+    if (rate) {
+        guchar* bytes = g_malloc0(size);
+
+        GDEBUG("Sending %u noise signal(s) per second", rate);
+        mock->noise_rate = rate;
+        mock->noise_sent = 0;
+        mock->noise_start = g_get_monotonic_time();
+        mock->noise_payload = g_variant_ref_sink(g_variant_new_fixed_array
+            (G_VARIANT_TYPE_BYTE, bytes, size, 1));
+        mock->noise_id = g_timeout_add(1, mock_noise_cb, mock);
+        g_free(bytes);
+    }
+}
+
+/*==========================================================================*
+ * Replay
+ *
+ * The trace is a text file, one event per line:
+ *
+ *   <milliseconds> <event> [arguments]
+ *
+ * where <event> is one of the ModemManager signal names or NameLost/
+ * NameAcquired for service name ownership changes. String arguments
+ * are separated by white space, "-" stands for an empty string, the
+ * PresentSimsChanged arguments are slot index and true/false, the
+ * ReadyChanged argument is true/false. Empty lines and lines starting
+ * with '#' are ignored.
+ *==========================================================================*/
+
+static
+void
+mock_event_free(
+    gpointer data)
+{
+    MockEvent* event = data;
+    g_free(event->str);
+    g_strfreev(event->strv);
+    g_free(event);
+}
+
+static
+gboolean
+mock_parse_bool(
+    const char* str,
+    gboolean* value)
+{
+    if (!g_ascii_strcasecmp(str, "true") || !strcmp(str, "1")) {
+        *value = TRUE;
+        return TRUE;
+    } else if (!g_ascii_strcasecmp(str, "false") || !strcmp(str, "0")) {
+        *value = FALSE;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static
+MockEvent*
+mock_parse_event(
+    const char* line)
+{
+    MockEvent* event = NULL;
+    char** tokens = g_strsplit_set(line, " \t", -1);
+    GStrV* args = NULL;
+    char* end = NULL;
+    guint i, n;
+
+    /* Drop empty tokens */
+    for (i = 0; tokens[i]; i++) {
+        if (tokens[i][0]) {
+            args = gutil_strv_add(args, strcmp(tokens[i], "-") ?
+                tokens[i] : "");
+        }
+    }
+    g_strfreev(tokens);
+
+    n = gutil_strv_length(args);
+    if (n >= 2) {
+        const gint64 time = g_ascii_strtoll(args[0], &end, 10);
+        if (end && !*end && time >= 0) {
+            for (i = 0; i < G_N_ELEMENTS(mock_event_names); i++) {
+                if (!strcmp(args[1], mock_event_names[i])) {
+                    event = g_new0(MockEvent, 1);
+                    event->time = time;
+                    event->type = i;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (event) {
+        gboolean ok;
+        switch (event->type) {
+        case MOCK_EVENT_ENABLED_MODEMS:
+            event->strv = g_strdupv(args + 2);
+            ok = TRUE;
+            break;
+        case MOCK_EVENT_PRESENT_SIMS:
+            ok = (n == 4 && mock_parse_bool(args[3], &event->flag));
+            if (ok) {
+                event->index = (gint)g_ascii_strtoll(args[2], &end, 10);
+                ok = (end && !*end);
+            }
+            break;
+        case MOCK_EVENT_READY:
+            ok = (n == 3 && mock_parse_bool(args[2], &event->flag));
+            break;
+        case MOCK_EVENT_NAME_LOST:
+        case MOCK_EVENT_NAME_ACQUIRED:
+            ok = (n == 2);
+            break;
+        default:
+            event->str = g_strdup((n == 3) ? args[2] : "");
+            ok = (n <= 3);
+            break;
+        }
+        if (!ok) {
+            mock_event_free(event);
+            event = NULL;
+        }
+    }
+    g_strfreev(args);
+    return event;
+}
+
+static
+GPtrArray*
+mock_load_trace(
+    const char* file,
+    GError** error)
+{
+    char* buf = NULL;
+    GPtrArray* trace = NULL;
+
+    if (g_file_get_contents(file, &buf, NULL, error)) {
+        char** lines = g_strsplit(buf, "\n", -1);
+        guint i;
+
+        trace = g_ptr_array_new_with_free_func(mock_event_free);
+        for (i = 0; lines[i] && trace; i++) {
+            const char* line = g_strstrip(lines[i]);
+            if (line[0] && line[0] != '#') {
+                MockEvent* event = mock_parse_event(line);
+                if (event) {
+                    g_ptr_array_add(trace, event);
+                } else {
+                    g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "%s:%u: invalid event", file, i + 1);
+                    g_ptr_array_free(trace, TRUE);
+                    trace = NULL;
+                }
+            }
+        }
+        g_strfreev(lines);
+        g_free(buf);
+    }
+    return trace;
+}
+
+static
+void
+mock_name_acquired(
+    GDBusConnection* bus,
+    const gchar* name,
+    gpointer data);
+
+static
+void
+mock_name_lost(
+    GDBusConnection* bus,
+    const gchar* name,
+    gpointer data);
+
+static
+void
+mock_own_name(
+    Mock* mock)
+{
+    mock->owner = TRUE;
+    mock->own_name_id = g_bus_own_name_on_connection(mock->bus,
+        OFONO_SERVICE, G_BUS_NAME_OWNER_FLAGS_NONE, mock_name_acquired,
+        mock_name_lost, mock, NULL);
+}
+
+static
+void
+mock_unown_name(
+    Mock* mock)
+{
+    if (mock->own_name_id) {
+        mock->owner = FALSE;
+        g_bus_unown_name(mock->own_name_id);
+        mock->own_name_id = 0;
+    }
+}
+
+static
+void
+mock_replay_event(
+    Mock* mock,
+    const MockEvent* event)
+{
+    switch (event->type) {
+    case MOCK_EVENT_ENABLED_MODEMS:
+        mock_set_enabled(mock, event->strv);
+        break;
+    case MOCK_EVENT_PRESENT_SIMS:
+        mock_set_present(mock, event->index, event->flag);
+        break;
+    case MOCK_EVENT_DATA_IMSI:
+        mock_set_data_imsi(mock, event->str);
+        break;
+    case MOCK_EVENT_VOICE_IMSI:
+        mock_set_voice_imsi(mock, event->str);
+        break;
+    case MOCK_EVENT_DATA_MODEM:
+        mock_set_data_path(mock, event->str);
+        break;
+    case MOCK_EVENT_VOICE_MODEM:
+        mock_set_voice_path(mock, event->str);
+        break;
+    case MOCK_EVENT_MMS_IMSI:
+        mock_set_mms_imsi(mock, event->str);
+        break;
+    case MOCK_EVENT_MMS_MODEM:
+        mock_set_mms_path(mock, event->str);
+        break;
+    case MOCK_EVENT_READY:
+        mock_set_ready(mock, event->flag);
+        break;
+    case MOCK_EVENT_NAME_LOST:
+        mock_unown_name(mock);
+        break;
+    case MOCK_EVENT_NAME_ACQUIRED:
+        if (!mock->owner) {
+            /* Wait for the client to pick up the new state */
+            mock->replay_resync = mock->get_all_count + 1;
+            mock->replay_resync_deadline = g_get_monotonic_time() +
+                MOCK_RESYNC_TIMEOUT_MS * 1000;
+            mock_own_name(mock);
+        }
+        break;
+    }
+}
+
+static
+void
+mock_replay_done(
+    Mock* mock)
+{
+    const guint count = mock->replay->len;
+    GDEBUG("Replayed %u event(s)", count);
+    g_ptr_array_free(mock->replay, TRUE);
+    mock->replay = NULL;
+    mock->replay_id = 0;
+    if (!mock->owner) {
+        mock_own_name(mock);
+    }
+    g_dbus_connection_flush(mock->bus, NULL, NULL, NULL);
+    mock_return_control_call(mock, g_variant_new("(u)", count));
+}
+
+static
+gboolean
+mock_replay_cb(
+    gpointer data)
+{
+    Mock* mock = data;
+    GPtrArray* trace = mock->replay;
+    const gint64 now = g_get_monotonic_time();
+
+    while (mock->replay_pos < trace->len) {
+        const MockEvent* event = trace->pdata[mock->replay_pos];
+
+        if (mock->replay_resync) {
+            if (mock->get_all_count < mock->replay_resync &&
+                now < mock->replay_resync_deadline) {
+                return G_SOURCE_CONTINUE;
+            }
+            mock->replay_resync = 0;
+        }
+        if (mock->replay_realtime &&
+            mock->replay_start + event->time * 1000 > now) {
+            return G_SOURCE_CONTINUE;
+        }
+        mock_replay_event(mock, event);
+        mock->replay_pos++;
+        if (!mock->replay_realtime && mock->replay_pos % MOCK_BATCH == 0) {
+            return G_SOURCE_CONTINUE;
+        }
+    }
+    mock_replay_done(mock);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+mock_replay(
+    Mock* mock,
+    GPtrArray* trace,
+    gboolean realtime)
+{
+    GDEBUG("Replaying %u event(s)", trace->len);
+    mock->replay = trace;
+    mock->replay_pos = 0;
+    mock->replay_realtime = realtime;
+    mock->replay_start = g_get_monotonic_time();
+    mock->replay_resync = 0;
+    mock->replay_id = realtime ?
+        g_timeout_add(1, mock_replay_cb, mock) :
+        g_idle_add(mock_replay_cb, mock);
+}
+
+/*
+ * Resync churn: the service name goes away and comes back, a few IMSIs
+ * change in between and afterwards. Each cycle makes the client drop
+ * and refetch the entire state.
+ */
+static
+MockEvent*
+mock_churn_event(
+    MOCK_EVENT_TYPE type,
+    const char* str)
+{
+    MockEvent* event = g_new0(MockEvent, 1);
+    event->type = type;
+    event->str = g_strdup(str);
+    return event;
+}
+
+static
+GPtrArray*
+mock_churn_trace(
+    Mock* mock,
+    guint cycles)
+{
+    GPtrArray* trace = g_ptr_array_new_with_free_func(mock_event_free);
+    const guint n = gutil_strv_length(mock->imsi);
+    guint i;
+
+    for (i = 0; i < cycles; i++) {
+        const char* imsi1 = n ? mock->imsi[i % n] : "";
+        const char* imsi2 = n ? mock->imsi[(i + 1) % n] : "";
+
+        g_ptr_array_add(trace, mock_churn_event(MOCK_EVENT_NAME_LOST, NULL));
+        g_ptr_array_add(trace, mock_churn_event(MOCK_EVENT_DATA_IMSI,
+            imsi1));
+        g_ptr_array_add(trace, mock_churn_event(MOCK_EVENT_NAME_ACQUIRED,
+            NULL));
+        g_ptr_array_add(trace, mock_churn_event(MOCK_EVENT_VOICE_IMSI,
+            imsi2));
+        g_ptr_array_add(trace, mock_churn_event(MOCK_EVENT_MMS_IMSI,
+            imsi1));
+    }
+    return trace;
+}
+
+/*==========================================================================*
+ * Control interface
+ *==========================================================================*/
+
+static
+GVariant*
+mock_modem_interfaces(
+    Mock* mock,
+    gint slot)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("as"));
+    if (mock->sim_settings[slot]) {
+        g_variant_builder_add(&builder, "s", MOCK_SIM_SETTINGS_INTERFACE);
+    }
+    return g_variant_builder_end(&builder);
+}
+
+static
+GVariant*
+mock_modem_properties(
+    Mock* mock,
+    gint slot)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&builder, "{sv}", "Powered",
+        g_variant_new_boolean(TRUE));
+    g_variant_builder_add(&builder, "{sv}", "Online",
+        g_variant_new_boolean(TRUE));
+    g_variant_builder_add(&builder, "{sv}", "Interfaces",
+        mock_modem_interfaces(mock, slot));
+    return g_variant_builder_end(&builder);
+}
+
+static
+void
+mock_property_changed(
+    Mock* mock,
+    const char* path,
+    const char* iface,
+    const char* name,
+    GVariant* value)
+{
+    g_dbus_connection_emit_signal(mock->bus, NULL, path, iface,
+        "PropertyChanged", g_variant_new("(sv)", name, value), NULL);
+}
+
+static
+void
+mock_set_sim_settings(
+    Mock* mock,
+    gint slot,
+    gboolean present)
+{
+    if (mock->sim_settings[slot] != present) {
+        mock->sim_settings[slot] = present;
+        mock_property_changed(mock, mock->available[slot],
+            MOCK_MODEM_INTERFACE, "Interfaces",
+            mock_modem_interfaces(mock, slot));
+    }
+}
+
+static
+void
+mock_ofono_call(
+    GDBusConnection* bus,
+    const char* sender,
+    const char* path,
+    const char* iface,
+    const char* method,
+    GVariant* args,
+    GDBusMethodInvocation* call,
+    gpointer data)
+{
+    Mock* mock = data;
+    const gint slot = gutil_strv_find(mock->available, path);
+
+    if (!g_strcmp0(iface, MOCK_MANAGER_INTERFACE)) {
+        GVariantBuilder builder;
+        gint i;
+
+        g_variant_builder_init(&builder, G_VARIANT_TYPE("a(oa{sv})"));
+        for (i = 0; i < mock->slots; i++) {
+            g_variant_builder_add(&builder, "(o@a{sv})", mock->available[i],
+                mock_modem_properties(mock, i));
+        }
+        g_dbus_method_invocation_return_value(call,
+            g_variant_new("(@a(oa{sv}))", g_variant_builder_end(&builder)));
+    } else if (slot < 0) {
+        g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
+            G_DBUS_ERROR_UNKNOWN_OBJECT, "No such object %s", path);
+    } else if (!g_strcmp0(iface, MOCK_MODEM_INTERFACE)) {
+        g_dbus_method_invocation_return_value(call,
+            g_variant_new("(@a{sv})", mock_modem_properties(mock, slot)));
+    } else if (!g_strcmp0(method, "GetProperties")) {
+        mock->sim_settings_calls++;
+        if (mock->sim_settings_fail) {
+            /* The client retries calls which have timed out */
+            mock->sim_settings_fail--;
+            g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
+                G_DBUS_ERROR_TIMEOUT, "Timeout");
+        } else {
+            GVariantBuilder builder;
+
+            g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+            g_variant_builder_add(&builder, "{sv}", "DisplayName",
+                g_variant_new_string(mock->sim_names[slot]));
+            g_dbus_method_invocation_return_value(call,
+                g_variant_new("(@a{sv})", g_variant_builder_end(&builder)));
+        }
+    } else {
+        const char* name = NULL;
+        GVariant* value = NULL;
+
+        g_variant_get(args, "(&sv)", &name, &value);
+        if (!g_strcmp0(name, "DisplayName") &&
+            g_variant_is_of_type(value, G_VARIANT_TYPE_STRING)) {
+            mock_set_str(mock->sim_names + slot,
+                g_variant_get_string(value, NULL));
+            mock_property_changed(mock, path, MOCK_SIM_SETTINGS_INTERFACE,
+                name, value);
+            g_dbus_method_invocation_return_value(call, NULL);
+        } else {
+            g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
+                G_DBUS_ERROR_INVALID_ARGS, "Can't set %s", name);
+        }
+        g_variant_unref(value);
+    }
+}
+
+static const GDBusInterfaceVTable mock_ofono_vtable = {
+    mock_ofono_call, NULL, NULL
+};
+
+static
+gboolean
+mock_register_ofono(
+    Mock* mock,
+    GError** error)
+{
+    GDBusInterfaceInfo** intf = mock->ofono_info->interfaces;
+    guint n = 0;
+    gint i;
+
+    mock->ofono_id = g_new0(guint, 1 + 2 * mock->slots);
+    if (!(mock->ofono_id[n++] = g_dbus_connection_register_object(mock->bus,
+        "/", intf[0], &mock_ofono_vtable, mock, NULL, error))) {
+        return FALSE;
+    }
+    for (i = 0; i < mock->slots; i++) {
+        const char* path = mock->available[i];
+
+        if (!(mock->ofono_id[n++] = g_dbus_connection_register_object(
+            mock->bus, path, intf[1], &mock_ofono_vtable, mock, NULL,
+            error)) || !(mock->ofono_id[n++] =
+            g_dbus_connection_register_object(mock->bus, path, intf[2],
+            &mock_ofono_vtable, mock, NULL, error))) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static
+void
+mock_unregister_ofono(
+    Mock* mock)
+{
+    if (mock->ofono_id) {
+        const guint n = 1 + 2 * mock->slots;
+        guint i;
+
+        for (i = 0; i < n && mock->ofono_id[i]; i++) {
+            g_dbus_connection_unregister_object(mock->bus,
+                mock->ofono_id[i]);
+        }
+        g_free(mock->ofono_id);
+        mock->ofono_id = NULL;
+    }
+}
+
+static
+void
+mock_control_call(
+    GDBusConnection* bus,
+    const char* sender,
+    const char* path,
+    const char* iface,
+    const char* method,
+    GVariant* args,
+    GDBusMethodInvocation* call,
+    gpointer data)
+{
+    Mock* mock = data;
+    if (!g_strcmp0(method, "Noise")) {
+        guint rate = 0, size = 0;
+
+        /* Runs in the background, doesn't occupy the control call */
+        g_variant_get(args, "(uu)", &rate, &size);
+        mock_noise(mock, rate, size);
+        g_dbus_method_invocation_return_value(call, NULL);
+    } else if (!g_strcmp0(method, "SimSettings")) {
+        guint slot = 0;
+        gboolean present = FALSE;
+
+        /* The reply follows the PropertyChanged signal */
+        g_variant_get(args, "(ub)", &slot, &present);
+        if (slot < (guint)mock->slots) {
+            mock_set_sim_settings(mock, slot, present);
+            g_dbus_method_invocation_return_value(call, NULL);
+        } else {
+            g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
+                G_DBUS_ERROR_INVALID_ARGS, "Invalid slot %u", slot);
+        }
+    } else if (!g_strcmp0(method, "SimSettingsFail")) {
+        g_variant_get(args, "(u)", &mock->sim_settings_fail);
+        g_dbus_method_invocation_return_value(call, NULL);
+    } else if (!g_strcmp0(method, "SimSettingsCalls")) {
+        g_dbus_method_invocation_return_value(call,
+            g_variant_new("(u)", mock->sim_settings_calls));
+    } else if (mock->control_call) {
+        g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
+            G_DBUS_ERROR_LIMITS_EXCEEDED, "Busy");
+    } else if (!g_strcmp0(method, "Start")) {
+        guint count = 0;
+        g_variant_get(args, "(u)", &count);
+        mock->control_call = call;
+        mock_start(mock, count);
+    } else if (!g_strcmp0(method, "Replay")) {
+        const char* file = NULL;
+        gboolean realtime = FALSE;
+        GError* error = NULL;
+        GPtrArray* trace;
+
+        g_variant_get(args, "(&sb)", &file, &realtime);
+        trace = mock_load_trace(file, &error);
+        if (trace) {
+            mock->control_call = call;
+            mock_replay(mock, trace, realtime);
+        } else {
+            g_dbus_method_invocation_return_gerror(call, error);
+            g_error_free(error);
+        }
+    } else if (!g_strcmp0(method, "Probe")) {
+        guint count = 0, interval = 0;
+
+        g_variant_get(args, "(uu)", &count, &interval);
+        mock->control_call = call;
+        mock_probe(mock, count, interval);
+    } else if (!g_strcmp0(method, "Resync")) {
+        guint cycles = 0;
+
+        g_variant_get(args, "(u)", &cycles);
+        mock->control_call = call;
+        mock_replay(mock, mock_churn_trace(mock, cycles), FALSE);
+    } else {
+        g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
+            G_DBUS_ERROR_UNKNOWN_METHOD, "Unknown method %s", method);
+    }
+}
+
+static const GDBusInterfaceVTable mock_control_vtable = {
+    mock_control_call, NULL, NULL
+};
+
+static
+void
+mock_name_acquired(
+    GDBusConnection* bus,
+    const gchar* name,
+    gpointer data)
+{
+    Mock* mock = data;
+    GDEBUG("Acquired service name '%s'", name);
+    mock->ret = RET_OK;
+}
+
+static
+void
+mock_name_lost(
+    GDBusConnection* bus,
+    const gchar* name,
+    gpointer data)
+{
+    Mock* mock = data;
+    if (mock->owner) {
+        GERR("'%s' service already running or access denied", name);
+        mock->ret = RET_ERR;
+        g_main_loop_quit(mock->loop);
+    } else {
+        GDEBUG("Released service name '%s'", name);
+    }
+}
+
+static
+gboolean
+mock_signal(
+    gpointer data)
+{
+    Mock* mock = data;
+    GDEBUG("Terminated");
+    g_main_loop_quit(mock->loop);
+    return G_SOURCE_CONTINUE;
+}
+
+static
+void
+mock_init_state(
+    Mock* mock)
+{
+    gint i;
+    char buf[32];
+    mock->present = g_new(gboolean, mock->slots);
+    mock->sim_settings = g_new(gboolean, mock->slots);
+    for (i = 0; i < mock->slots; i++) {
+        snprintf(buf, sizeof(buf), "/ril_%d", i);
+        mock->available = gutil_strv_add(mock->available, buf);
+        snprintf(buf, sizeof(buf), "3538960400%05d", i);
+        mock->imei = gutil_strv_add(mock->imei, buf);
+        snprintf(buf, sizeof(buf), "2440100000%05d", i);
+        mock->imsi = gutil_strv_add(mock->imsi, buf);
+        mock->present[i] = TRUE;
+        mock->sim_settings[i] = TRUE;
+        snprintf(buf, sizeof(buf), "SIM%d", i + 1);
+        mock->sim_names = gutil_strv_add(mock->sim_names, buf);
+    }
+    mock->enabled = g_strdupv(mock->available);
+    mock->data_imsi = g_strdup(mock->imsi[0]);
+    mock->voice_imsi = g_strdup(mock->imsi[0]);
+    mock->mms_imsi = g_strdup("");
+    mock->data_path = g_strdup(mock->available[0]);
+    mock->voice_path = g_strdup(mock->available[0]);
+    mock->mms_path = g_strdup("");
+    mock->ready = TRUE;
+}
+
+static
+void
+mock_free_state(
+    Mock* mock)
+{
+    g_strfreev(mock->available);
+    g_strfreev(mock->enabled);
+    g_strfreev(mock->imei);
+    g_strfreev(mock->imsi);
+    g_free(mock->present);
+    g_free(mock->sim_settings);
+    g_strfreev(mock->sim_names);
+    g_free(mock->data_imsi);
+    g_free(mock->voice_imsi);
+    g_free(mock->mms_imsi);
+    g_free(mock->data_path);
+    g_free(mock->voice_path);
+    g_free(mock->mms_path);
+}
+
+static
+int
+mock_run(
+    Mock* mock)
+{
+    guint sigterm, sigint;
+    GError* error = NULL;
+    OrgNemomobileOfonoModemManager* skel;
+
+    mock->ret = RET_ERR;
+    mock->bus = g_bus_get_sync(OFONO_BUS_TYPE, NULL, &error);
+    if (!mock->bus) {
+        GERR("%s", GERRMSG(error));
+        g_error_free(error);
+        return mock->ret;
+    }
+
+    skel = org_nemomobile_ofono_modem_manager_skeleton_new();
+    mock_init_state(mock);
+    mock->skel = skel;
+    mock->loop = g_main_loop_new(NULL, FALSE);
+    mock->control_info = g_dbus_node_info_new_for_xml(mock_control_xml, NULL);
+    mock->ofono_info = g_dbus_node_info_new_for_xml(mock_ofono_xml, NULL);
+    g_signal_connect(skel, "handle-get-all",
+        G_CALLBACK(mock_handle_get_all), mock);
+    if (mock->version >= 2) {
+        g_signal_connect(skel, "handle-get-all2",
+            G_CALLBACK(mock_handle_get_all2), mock);
+    }
+    if (mock->version >= 3) {
+        g_signal_connect(skel, "handle-get-all3",
+            G_CALLBACK(mock_handle_get_all3), mock);
+    }
+    if (mock->version >= 4) {
+        g_signal_connect(skel, "handle-get-all4",
+            G_CALLBACK(mock_handle_get_all4), mock);
+        g_signal_connect(skel, "handle-set-mms-sim",
+            G_CALLBACK(mock_handle_set_mms_sim), mock);
+    }
+    if (mock->version >= 5) {
+        g_signal_connect(skel, "handle-get-all5",
+            G_CALLBACK(mock_handle_get_all5), mock);
+    }
+    g_signal_connect(skel, "handle-set-enabled-modems",
+        G_CALLBACK(mock_handle_set_enabled_modems), mock);
+    g_signal_connect(skel, "handle-set-default-data-sim",
+        G_CALLBACK(mock_handle_set_default_data_sim), mock);
+    g_signal_connect(skel, "handle-set-default-voice-sim",
+        G_CALLBACK(mock_handle_set_default_voice_sim), mock);
+
+    if (g_dbus_interface_skeleton_export(G_DBUS_INTERFACE_SKELETON(skel),
+        mock->bus, "/", &error) && (mock->control_id =
+        g_dbus_connection_register_object(mock->bus, MOCK_CONTROL_PATH,
+        mock->control_info->interfaces[0], &mock_control_vtable, mock,
+        NULL, &error)) != 0 && mock_register_ofono(mock, &error)) {
+        sigterm = g_unix_signal_add(SIGTERM, mock_signal, mock);
+        sigint = g_unix_signal_add(SIGINT, mock_signal, mock);
+        mock_own_name(mock);
+        g_main_loop_run(mock->loop);
+        g_source_remove(sigterm);
+        g_source_remove(sigint);
+        mock_unown_name(mock);
+    } else {
+        GERR("%s", GERRMSG(error));
+        g_error_free(error);
+    }
+    mock_unregister_ofono(mock);
+    if (mock->control_id) {
+        g_dbus_connection_unregister_object(mock->bus, mock->control_id);
+    }
+    g_dbus_interface_skeleton_unexport(G_DBUS_INTERFACE_SKELETON(skel));
+
+    if (mock->gen_id) {
+        g_source_remove(mock->gen_id);
+    }
+    if (mock->probe_id) {
+        g_source_remove(mock->probe_id);
+    }
+    mock_noise_stop(mock);
+    if (mock->replay_id) {
+        g_source_remove(mock->replay_id);
+        g_ptr_array_free(mock->replay, TRUE);
+    }
+    mock_return_control_call(mock, NULL);
+    g_object_unref(skel);
+    g_object_unref(mock->bus);
+    g_dbus_node_info_unref(mock->control_info);
+    g_dbus_node_info_unref(mock->ofono_info);
+    g_main_loop_unref(mock->loop);
+    mock_free_state(mock);
+    return mock->ret;
+}
+
+static
+gboolean
+mock_opt_verbose(
+    const gchar* name,
+    const gchar* value,
+    gpointer data,
+    GError** error)
+{
+    gutil_log_default.level = GLOG_LEVEL_VERBOSE;
+    return TRUE;
+}
+
+static
+gboolean
+mock_init(
+    Mock* mock,
+    int argc,
+    char* argv[])
+{
+    gboolean ok = FALSE;
+    GOptionEntry entries[] = {
+        { "verbose", 'v', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
+          mock_opt_verbose, "Enable verbose output", NULL },
+        { "slots", 's', 0, G_OPTION_ARG_INT,
+          &mock->slots, "Number of modem slots [2]", "N" },
+        { "version", 'V', 0, G_OPTION_ARG_INT,
+          &mock->version, "Interface version, 1 to 5 [5]", "N" },
+        { "latency", 'l', 0, G_OPTION_ARG_INT,
+          &mock->latency, "Reply latency in milliseconds [0]", "MS" },
+        { "rate", 'r', 0, G_OPTION_ARG_INT,
+          &mock->rate, "Signals per second, 0 = unlimited [0]", "N" },
+        { NULL }
+    };
+    GError* error = NULL;
+    GOptionContext* options = g_option_context_new(NULL);
+    g_option_context_add_main_entries(options, entries, NULL);
+    g_option_context_set_summary(options,
+        "Implements " OFONO_SERVICE " ModemManager interface.");
+    if (g_option_context_parse(options, &argc, &argv, &error)) {
+        if (argc == 1 && mock->slots > 0 && mock->latency >= 0 &&
+            mock->rate >= 0 && mock->version >= 1 && mock->version <= 5) {
+            ok = TRUE;
+        } else {
+            char* help = g_option_context_get_help(options, TRUE, NULL);
+            fprintf(stderr, "%s", help);
+            g_free(help);
+        }
+    } else {
+        GERR("%s", error->message);
+        g_error_free(error);
+    }
+    g_option_context_free(options);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    int ret = RET_ERR;
+    Mock mock;
+    memset(&mock, 0, sizeof(mock));
+    mock.slots = 2;
+    mock.version = 5;
+    gutil_log_timestamp = FALSE;
+    gutil_log_set_type(GLOG_TYPE_STDERR, "mm-mock");
+    gutil_log_default.level = GLOG_LEVEL_DEFAULT;
+    if (mock_init(&mock, argc, argv)) {
+        ret = mock_run(&mock);
+    }
+    return ret;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
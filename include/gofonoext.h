@@ -34,7 +34,9 @@
 #define GOFONOEXT_H
 
 #include "gofonoext_version.h"
+#include "gofonoext_exporter.h"
 #include "gofonoext_mm.h"
+#include "gofonoext_sim_settings.h"
 
 #endif /* GOFONOEXT_H */
 
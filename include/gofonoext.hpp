@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GOFONOEXT_HPP
+#define GOFONOEXT_HPP
+
+/*
+ * Header-only C++17 wrapper for OfonoExtModemManager. Since 1.0.12
+ *
+ * Handlers are bound without allocating anything. Member functions are
+ * passed as template arguments, plain functions by pointer, other
+ * callables (const ones too) by reference and must outlive the
+ * subscription. Any of them can take no arguments or the
+ * OfonoExtModemManager pointer.
+ *
+ *   gofonoext::ModemManager mm;
+ *   auto s1 = mm.connect<gofonoext::Event::DataImsi,
+ *       &Controller::onDataImsiChanged>(this);
+ *   auto s2 = mm.connect<gofonoext::Event::Valid>(onValid);
+ *
+ * The accessors return views into the manager's state, which remain
+ * valid until the next change notification.
+ */
+
+#include "gofonoext.h"
+
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace gofonoext {
+
+enum class Event {
+    Valid,
+    EnabledModems,
+    DataImsi,
+    DataModem,
+    VoiceImsi,
+    VoiceModem,
+    PresentSims,
+    SimCount,
+    ActiveSimCount,
+    MmsImsi,
+    MmsModem,
+    Ready,
+    SlotsWarm
+};
+
+namespace detail {
+
+template <Event E>
+struct EventTraits;
+
+#define GOFONOEXT_EVENT_TRAITS(event, name) \
+    template <> \
+    struct EventTraits<Event::event> { \
+        static gulong add(OfonoExtModemManager* mm, \
+            OfonoExtModemManagerHandler fn, void* data) noexcept { \
+            return ofonoext_mm_add_##name##_handler(mm, fn, data); \
+        } \
+    }
+
+GOFONOEXT_EVENT_TRAITS(Valid, valid_changed);
+GOFONOEXT_EVENT_TRAITS(EnabledModems, enabled_modems_changed);
+GOFONOEXT_EVENT_TRAITS(DataImsi, data_imsi_changed);
+GOFONOEXT_EVENT_TRAITS(DataModem, data_modem_changed);
+GOFONOEXT_EVENT_TRAITS(VoiceImsi, voice_imsi_changed);
+GOFONOEXT_EVENT_TRAITS(VoiceModem, voice_modem_changed);
+GOFONOEXT_EVENT_TRAITS(PresentSims, present_sims_changed);
+GOFONOEXT_EVENT_TRAITS(SimCount, sim_count_changed);
+GOFONOEXT_EVENT_TRAITS(ActiveSimCount, active_sim_count_changed);
+GOFONOEXT_EVENT_TRAITS(MmsImsi, mms_imsi_changed);
+GOFONOEXT_EVENT_TRAITS(MmsModem, mms_modem_changed);
+GOFONOEXT_EVENT_TRAITS(Ready, ready_changed);
+GOFONOEXT_EVENT_TRAITS(SlotsWarm, slots_warm);
+
+#undef GOFONOEXT_EVENT_TRAITS
+
+template <typename F>
+inline void
+invoke(
+    F&& fn,
+    OfonoExtModemManager* mm)
+{
+    if constexpr (std::is_invocable_v<F, OfonoExtModemManager*>) {
+        std::forward<F>(fn)(mm);
+    } else {
+        std::forward<F>(fn)();
+    }
+}
+
+/* Trampolines, their addresses are what gets passed to the C API */
+template <auto Method, typename T>
+struct MethodHandler {
+    static void call(OfonoExtModemManager* mm, void* data) {
+        T* obj = static_cast<T*>(data);
+
+        if constexpr (std::is_invocable_v<decltype(Method), T*,
+            OfonoExtModemManager*>) {
+            (obj->*Method)(mm);
+        } else {
+            (obj->*Method)();
+        }
+    }
+};
+
+/* F may be const, the constness is only cast away for the C API */
+template <typename F>
+struct CallableHandler {
+    static void call(OfonoExtModemManager* mm, void* data) {
+        invoke(*static_cast<F*>(data), mm);
+    }
+};
+
+/* The function pointer itself is the data */
+template <typename Fn>
+struct FunctionHandler {
+    static void call(OfonoExtModemManager* mm, void* data) {
+        invoke(reinterpret_cast<Fn>(data), mm);
+    }
+};
+
+inline std::string_view
+view(
+    const char* str) noexcept
+{
+    return str ? std::string_view(str) : std::string_view();
+}
+
+} /* namespace detail */
+
+/* Contiguous read-only range, a minimal std::span */
+template <typename T>
+class Span {
+public:
+    constexpr Span() noexcept : m_data(nullptr), m_size(0) {}
+    constexpr Span(const T* data, std::size_t size) noexcept :
+        m_data(data), m_size(data ? size : 0) {}
+
+    constexpr const T* data() const noexcept { return m_data; }
+    constexpr std::size_t size() const noexcept { return m_size; }
+    constexpr bool empty() const noexcept { return !m_size; }
+    constexpr const T* begin() const noexcept { return m_data; }
+    constexpr const T* end() const noexcept { return m_data + m_size; }
+    constexpr const T& operator[](std::size_t i) const noexcept
+        { return m_data[i]; }
+
+private:
+    const T* m_data;
+    std::size_t m_size;
+};
+
+/* NULL terminated string array viewed as a range of std::string_view */
+class StrvView {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = std::string_view;
+
+        constexpr iterator() noexcept : m_ptr(nullptr) {}
+        constexpr explicit iterator(const char* const* ptr) noexcept :
+            m_ptr((ptr && *ptr) ? ptr : nullptr) {}
+
+        std::string_view operator*() const noexcept
+            { return std::string_view(*m_ptr); }
+        iterator& operator++() noexcept
+            { m_ptr = *++m_ptr ? m_ptr : nullptr; return *this; }
+        iterator operator++(int) noexcept
+            { iterator it(*this); ++(*this); return it; }
+        constexpr bool operator==(const iterator& it) const noexcept
+            { return m_ptr == it.m_ptr; }
+        constexpr bool operator!=(const iterator& it) const noexcept
+            { return m_ptr != it.m_ptr; }
+
+    private:
+        const char* const* m_ptr;
+    };
+
+    constexpr StrvView() noexcept : m_strv(nullptr) {}
+    constexpr explicit StrvView(const char* const* strv) noexcept :
+        m_strv(strv) {}
+
+    iterator begin() const noexcept { return iterator(m_strv); }
+    iterator end() const noexcept { return iterator(); }
+    bool empty() const noexcept { return !m_strv || !m_strv[0]; }
+    std::size_t size() const noexcept {
+        std::size_t n = 0;
+        if (m_strv) while (m_strv[n]) n++;
+        return n;
+    }
+    std::string_view operator[](std::size_t i) const noexcept
+        { return std::string_view(m_strv[i]); }
+    const char* const* data() const noexcept { return m_strv; }
+
+private:
+    const char* const* m_strv;
+};
+
+/* Removes the handler when destroyed, holds a reference to the manager */
+class Subscription {
+public:
+    Subscription() noexcept : m_mm(nullptr), m_id(0) {}
+    Subscription(OfonoExtModemManager* mm, gulong id) noexcept :
+        m_mm(id ? ofonoext_mm_ref(mm) : nullptr), m_id(id) {}
+    Subscription(Subscription&& other) noexcept :
+        m_mm(std::exchange(other.m_mm, nullptr)),
+        m_id(std::exchange(other.m_id, 0)) {}
+    ~Subscription() { reset(); }
+
+    Subscription(const Subscription&) = delete;
+    Subscription& operator=(const Subscription&) = delete;
+
+    Subscription& operator=(Subscription&& other) noexcept {
+        if (this != &other) {
+            reset();
+            m_mm = std::exchange(other.m_mm, nullptr);
+            m_id = std::exchange(other.m_id, 0);
+        }
+        return *this;
+    }
+
+    void reset() noexcept {
+        if (m_id) {
+            ofonoext_mm_remove_handler(m_mm, m_id);
+            ofonoext_mm_unref(m_mm);
+            m_mm = nullptr;
+            m_id = 0;
+        }
+    }
+
+    gulong id() const noexcept { return m_id; }
+    explicit operator bool() const noexcept { return m_id != 0; }
+
+private:
+    OfonoExtModemManager* m_mm;
+    gulong m_id;
+};
+
+/* Owns a reference. A moved-from object may only be assigned or destroyed */
+class ModemManager {
+public:
+    ModemManager() : m_mm(ofonoext_mm_new()) {}
+    explicit ModemManager(OFONOEXT_MM_FLAGS flags) :
+        m_mm(ofonoext_mm_new_with_flags(flags)) {}
+    ModemManager(ModemManager&& other) noexcept :
+        m_mm(std::exchange(other.m_mm, nullptr)) {}
+    ~ModemManager() { ofonoext_mm_unref(m_mm); }
+
+    ModemManager(const ModemManager&) = delete;
+    ModemManager& operator=(const ModemManager&) = delete;
+
+    ModemManager& operator=(ModemManager&& other) noexcept {
+        if (this != &other) {
+            ofonoext_mm_unref(m_mm);
+            m_mm = std::exchange(other.m_mm, nullptr);
+        }
+        return *this;
+    }
+
+    /* Takes over the reference */
+    static ModemManager adopt(OfonoExtModemManager* mm) noexcept
+        { return ModemManager(mm); }
+
+    OfonoExtModemManager* get() const noexcept { return m_mm; }
+    OfonoExtModemManager* operator->() const noexcept { return m_mm; }
+
+    bool valid() const noexcept { return m_mm->valid; }
+    bool ready() const noexcept { return m_mm->ready; }
+    bool slotsWarm() const noexcept { return m_mm->slots_warm; }
+    guint modemCount() const noexcept { return m_mm->modem_count; }
+    guint simCount() const noexcept { return m_mm->sim_count; }
+    guint activeSimCount() const noexcept
+        { return m_mm->active_sim_count; }
+
+    StrvView available() const noexcept
+        { return StrvView(m_mm->available); }
+    StrvView enabled() const noexcept
+        { return StrvView(m_mm->enabled); }
+    StrvView imei() const noexcept
+        { return StrvView(m_mm->imei); }
+    Span<gboolean> presentSims() const noexcept
+        { return Span<gboolean>(m_mm->present_sims, m_mm->modem_count); }
+
+    std::string_view dataImsi() const noexcept
+        { return detail::view(m_mm->data_imsi); }
+    std::string_view voiceImsi() const noexcept
+        { return detail::view(m_mm->voice_imsi); }
+    std::string_view mmsImsi() const noexcept
+        { return detail::view(m_mm->mms_imsi); }
+
+    template <Event E, auto Method, typename T>
+    [[nodiscard]] Subscription connect(T* obj) const noexcept {
+        return Subscription(m_mm, detail::EventTraits<E>::add(m_mm,
+            detail::MethodHandler<Method, T>::call, obj));
+    }
+
+    template <Event E, typename R, typename... A>
+    [[nodiscard]] Subscription connect(R (*fn)(A...)) const noexcept {
+        return Subscription(m_mm, detail::EventTraits<E>::add(m_mm,
+            detail::FunctionHandler<R (*)(A...)>::call,
+            reinterpret_cast<void*>(fn)));
+    }
+
+    template <Event E, typename F>
+    [[nodiscard]] Subscription connect(F& fn) const noexcept {
+        static_assert(!std::is_function_v<F>,
+            "Functions are connected by pointer");
+        return Subscription(m_mm, detail::EventTraits<E>::add(m_mm,
+            detail::CallableHandler<F>::call,
+            const_cast<void*>(static_cast<const void*>(&fn))));
+    }
+
+    /* Temporaries would be gone by the time the handler is invoked */
+    template <Event E, typename F>
+    Subscription connect(F&& fn) const = delete;
+
+private:
+    explicit ModemManager(OfonoExtModemManager* mm) noexcept : m_mm(mm) {}
+
+    OfonoExtModemManager* m_mm;
+};
+
+static_assert(sizeof(ModemManager) == sizeof(OfonoExtModemManager*),
+    "ModemManager is just a pointer");
+
+} /* namespace gofonoext */
+
+#endif /* GOFONOEXT_HPP */
+
+/*
+ * Local Variables:
+ * mode: C++
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
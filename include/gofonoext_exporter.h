@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GOFONOEXT_EXPORTER_H
+#define GOFONOEXT_EXPORTER_H
+
+#include "gofonoext_mm.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Metrics exporter (since 1.0.12). Serves the counters and a summary of
+ * the state of the modem managers added to it in the Prometheus text
+ * format on a UNIX domain socket, an abstract one if the path starts
+ * with '@'. Each client gets a snapshot taken when it connects, wrapped
+ * into an HTTP response if the client has sent a GET request. Clients
+ * which don't speak HTTP get the plain text once they shut down their
+ * end of the connection or stay silent for a second. The exporter
+ * doesn't hold references to the managers, they drop out when they are
+ * finalized. It must be used by the thread running the main context
+ * the managers live in.
+ *
+ * Setting GOFONOEXT_METRICS_SOCKET=path before creating the first modem
+ * manager does the same for all the shared instances in the process.
+ * Without either, the exporter doesn't exist and the only cost is the
+ * counters kept by every instance.
+ */
+typedef struct ofonoext_exporter OfonoExtExporter;
+
+OfonoExtExporter*
+ofonoext_exporter_new(
+    const char* path,
+    GError** error);
+
+void
+ofonoext_exporter_free(
+    OfonoExtExporter* exporter);
+
+void
+ofonoext_exporter_add(
+    OfonoExtExporter* exporter,
+    OfonoExtModemManager* mm);
+
+void
+ofonoext_exporter_remove(
+    OfonoExtExporter* exporter,
+    OfonoExtModemManager* mm);
+
+/* Same text as served over the socket, g_free() it */
+char*
+ofonoext_exporter_snapshot(
+    OfonoExtExporter* exporter);
+
+G_END_DECLS
+
+#endif /* GOFONOEXT_EXPORTER_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
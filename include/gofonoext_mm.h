@@ -57,6 +57,7 @@ struct ofonoext_modem_manager {
     const char* mms_imsi;           /* Since 1.0.4 */
     OfonoModem* mms_modem;
     gboolean ready;                 /* Since 1.0.7 */
+    gboolean slots_warm;            /* Since 1.0.12 */
 };
 
 GType ofonoext_mm_get_type(void);
@@ -64,6 +65,19 @@ GType ofonoext_mm_get_type(void);
 #define OFONOEXT_MODEM_MANAGER(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), \
         OFONOEXT_TYPE_MODEM_MANAGER, OfonoExtModemManager))
 
+/* Since 1.0.12 */
+typedef enum ofonoext_mm_property {
+    OFONOEXT_MM_PROPERTY_ENABLED_MODEMS,
+    OFONOEXT_MM_PROPERTY_DATA_IMSI,
+    OFONOEXT_MM_PROPERTY_DATA_MODEM,
+    OFONOEXT_MM_PROPERTY_VOICE_IMSI,
+    OFONOEXT_MM_PROPERTY_VOICE_MODEM,
+    OFONOEXT_MM_PROPERTY_PRESENT_SIMS,
+    OFONOEXT_MM_PROPERTY_MMS_IMSI,
+    OFONOEXT_MM_PROPERTY_MMS_MODEM,
+    OFONOEXT_MM_PROPERTY_READY
+} OFONOEXT_MM_PROPERTY;
+
 typedef
 void
 (*OfonoExtModemManagerHandler)(
@@ -78,9 +92,105 @@ void
     const GError* error,
     void* data);
 
+/* Since 1.0.12 */
+typedef enum ofonoext_mm_wait {
+    OFONOEXT_MM_WAIT_VALID = 0x0000,
+    OFONOEXT_MM_WAIT_READY = 0x0001,
+    OFONOEXT_MM_WAIT_DATA_MODEM = 0x0002,
+    OFONOEXT_MM_WAIT_VOICE_MODEM = 0x0004,
+    OFONOEXT_MM_WAIT_MMS_MODEM = 0x0008,
+    OFONOEXT_MM_WAIT_DATA_IMSI = 0x0010,
+    OFONOEXT_MM_WAIT_VOICE_IMSI = 0x0020,
+    OFONOEXT_MM_WAIT_MMS_IMSI = 0x0040,
+    OFONOEXT_MM_WAIT_SIM_COUNT = 0x0080,        /* sim_count >= count */
+    OFONOEXT_MM_WAIT_ACTIVE_SIM_COUNT = 0x0100, /* active_sim_count >= count */
+    OFONOEXT_MM_WAIT_SLOTS_WARM = 0x0200
+} OFONOEXT_MM_WAIT;
+
+/* Since 1.0.12 */
+typedef enum ofonoext_mm_changed {
+    OFONOEXT_MM_CHANGED_NONE = 0x0000,
+    OFONOEXT_MM_CHANGED_VALID = 0x0001,
+    OFONOEXT_MM_CHANGED_ENABLED_MODEMS = 0x0002,
+    OFONOEXT_MM_CHANGED_DATA_IMSI = 0x0004,
+    OFONOEXT_MM_CHANGED_DATA_MODEM = 0x0008,
+    OFONOEXT_MM_CHANGED_VOICE_IMSI = 0x0010,
+    OFONOEXT_MM_CHANGED_VOICE_MODEM = 0x0020,
+    OFONOEXT_MM_CHANGED_MMS_IMSI = 0x0040,
+    OFONOEXT_MM_CHANGED_MMS_MODEM = 0x0080,
+    OFONOEXT_MM_CHANGED_PRESENT_SIMS = 0x0100,
+    OFONOEXT_MM_CHANGED_SIM_COUNT = 0x0200,
+    OFONOEXT_MM_CHANGED_ACTIVE_SIM_COUNT = 0x0400,
+    OFONOEXT_MM_CHANGED_READY = 0x0800,
+    OFONOEXT_MM_CHANGED_SLOTS_WARM = 0x1000,
+    OFONOEXT_MM_CHANGED_ALL = 0x1fff
+} OFONOEXT_MM_CHANGED;
+
+/* Since 1.0.12 */
+typedef enum ofonoext_mm_flags {
+    OFONOEXT_MM_FLAGS_NONE = 0x00,
+    OFONOEXT_MM_FLAG_WORKER_THREAD = 0x01,
+    OFONOEXT_MM_FLAG_PRIVATE_BUS = 0x02
+} OFONOEXT_MM_FLAGS;
+
+typedef
+void
+(*OfonoExtModemManagerWaitHandler)(
+    OfonoExtModemManager* mm,
+    gboolean ok,
+    void* data); /* Since 1.0.12 */
+
+typedef
+void
+(*OfonoExtModemManagerBatchHandler)(
+    OfonoExtModemManager* mm,
+    OFONOEXT_MM_CHANGED changed,
+    void* data); /* Since 1.0.12 */
+
 OfonoExtModemManager*
 ofonoext_mm_new(void);
 
+/*
+ * NULL arguments select the defaults (OFONO_BUS_TYPE, OFONO_SERVICE and
+ * the root path). Instances created with the same arguments are shared.
+ * Note that OfonoModem objects are still created by libgofono on its
+ * own connection to the default oFono service.
+ */
+OfonoExtModemManager*
+ofonoext_mm_new_full(
+    GDBusConnection* bus,
+    const char* service,
+    const char* path); /* Since 1.0.12 */
+
+/*
+ * With OFONOEXT_MM_FLAG_WORKER_THREAD the change signals are received
+ * and decoded by a thread owned by the manager. The decoded changes are
+ * passed to the default main context through a lock-free queue, and the
+ * main context is only woken up to apply them.
+ *
+ * With OFONOEXT_MM_FLAG_PRIVATE_BUS the manager opens its own connection
+ * to the bus instead of sharing the one returned by g_bus_get(), so its
+ * signals don't queue up behind unrelated traffic. OfonoModem objects
+ * still use the shared connection.
+ *
+ * Instances created with the same flags are shared.
+ */
+OfonoExtModemManager*
+ofonoext_mm_new_with_flags(
+    OFONOEXT_MM_FLAGS flags); /* Since 1.0.12 */
+
+/*
+ * Offline backend for testing consumers without D-Bus. The initial state
+ * and a timeline of changes are loaded from a keyfile, the changes are
+ * applied exactly as if they were coming from oFono and emit the same
+ * signals. Every call creates a new instance. Methods which would change
+ * the state on the oFono side fail with G_IO_ERROR_NOT_SUPPORTED.
+ */
+OfonoExtModemManager*
+ofonoext_mm_new_from_scenario(
+    const char* file,
+    GError** error); /* Since 1.0.12 */
+
 OfonoExtModemManager*
 ofonoext_mm_ref(
     OfonoExtModemManager* mm);
@@ -89,11 +199,128 @@ void
 ofonoext_mm_unref(
     OfonoExtModemManager* mm);
 
+/*
+ * Binary event recorder. Incoming events and emitted changes are written
+ * to a memory mapped ring buffer, the format is described in
+ * gofonoext_recorder.h. Zero size selects the default (256K). The same
+ * can be enabled by setting GOFONOEXT_RECORD=file[:size] environment
+ * variable before creating the first instance.
+ */
+gboolean
+ofonoext_mm_start_recording(
+    OfonoExtModemManager* mm,
+    const char* file,
+    gsize size,
+    GError** error); /* Since 1.0.12 */
+
+void
+ofonoext_mm_stop_recording(
+    OfonoExtModemManager* mm); /* Since 1.0.12 */
+
+/*
+ * Handler timing. While enabled, handlers added with ofonoext_mm_add_*
+ * are timed, and those which take longer than the budget (unless it's
+ * zero) get logged as slow. Handlers added while it was disabled are
+ * never timed. Statistics are accumulated per signal and function,
+ * surviving removal of the handler. ofonoext_mm_handler_stats()
+ * returns a snapshot sorted by the total time, slowest first, which the
+ * caller frees with g_free(). The same can be enabled for the default
+ * instance by setting GOFONOEXT_HANDLER_BUDGET=usec before creating it.
+ */
+typedef struct ofonoext_mm_handler_stats {
+    const char* signal;
+    OfonoExtModemManagerHandler fn;
+    guint count;                    /* Number of invocations */
+    guint slow;                     /* Invocations over the budget */
+    guint64 total_us;
+    guint64 max_us;
+} OfonoExtModemManagerHandlerStats; /* Since 1.0.12 */
+
+void
+ofonoext_mm_set_handler_timing(
+    OfonoExtModemManager* mm,
+    gboolean enable,
+    guint budget_us); /* Since 1.0.12 */
+
+OfonoExtModemManagerHandlerStats*
+ofonoext_mm_handler_stats(
+    OfonoExtModemManager* mm,
+    guint* count); /* Since 1.0.12 */
+
+void
+ofonoext_mm_reset_handler_stats(
+    OfonoExtModemManager* mm); /* Since 1.0.12 */
+
 gboolean
 ofonoext_mm_modem_enabled_at(
     OfonoExtModemManager* mm,
     gint index);
 
+/*
+ * With prefetch enabled, OfonoModem and OfonoSimMgr objects for all
+ * slots are created as soon as the manager becomes valid, and the
+ * "slots-warm" signal is emitted once all of them are valid. The
+ * objects are then available via ofonoext_mm_modem_at() and
+ * ofonoext_mm_simmgr_at(), the SIM IMSIs are fed to the IMSI index.
+ */
+void
+ofonoext_mm_set_prefetch(
+    OfonoExtModemManager* mm,
+    gboolean prefetch); /* Since 1.0.12 */
+
+OfonoModem*
+ofonoext_mm_modem_at(
+    OfonoExtModemManager* mm,
+    gint index); /* Since 1.0.12 */
+
+OfonoSimMgr*
+ofonoext_mm_simmgr_at(
+    OfonoExtModemManager* mm,
+    gint index); /* Since 1.0.12 */
+
+/*
+ * By default the manager listens to all ModemManager signals. In the
+ * on-demand mode, a D-Bus signal is only subscribed to while there are
+ * handlers registered (with ofonoext_mm_add_*_handler) for the fields
+ * it updates. Other fields may go stale, which can be checked with
+ * ofonoext_mm_property_subscribed(). Stale fields are refreshed when a
+ * handler is registered for them again. Recording turns it off.
+ */
+void
+ofonoext_mm_set_subscribe_on_demand(
+    OfonoExtModemManager* mm,
+    gboolean on_demand); /* Since 1.0.12 */
+
+gboolean
+ofonoext_mm_property_subscribed(
+    OfonoExtModemManager* mm,
+    OFONOEXT_MM_PROPERTY property); /* Since 1.0.12 */
+
+/*
+ * Slot lookups return -1 if nothing is found. The IMSI index is learnt
+ * from the default data, voice and MMS SIM selections (and forgotten
+ * when the SIM is removed), so it may not cover every slot.
+ */
+gint
+ofonoext_mm_slot_for_path(
+    OfonoExtModemManager* mm,
+    const char* path); /* Since 1.0.12 */
+
+gint
+ofonoext_mm_slot_for_imei(
+    OfonoExtModemManager* mm,
+    const char* imei); /* Since 1.0.12 */
+
+gint
+ofonoext_mm_slot_for_imsi(
+    OfonoExtModemManager* mm,
+    const char* imsi); /* Since 1.0.12 */
+
+const char*
+ofonoext_mm_imsi_at(
+    OfonoExtModemManager* mm,
+    gint index); /* Since 1.0.12 */
+
 void
 ofonoext_mm_set_mms_imsi(
     OfonoExtModemManager* mm,
@@ -106,6 +333,213 @@ ofonoext_mm_set_mms_imsi_full(
     OfonoExtModemManagerSetMmsSimHandler fn,
     void* arg);
 
+/*
+ * Waits until all the conditions in the mask are met (they all imply
+ * valid). The handler is invoked exactly once, never before
+ * ofonoext_mm_wait_async() returns, with ok set to FALSE if the timeout
+ * expires first. Zero timeout means no timeout. The handler is not
+ * invoked if the call is cancelled with ofonoext_call_cancel(). The
+ * timeout runs in the thread default main context of the caller.
+ * ofonoext_mm_wait_sync() iterates the default main context while it
+ * waits.
+ */
+OfonoExtCall*
+ofonoext_mm_wait_async(
+    OfonoExtModemManager* mm,
+    OFONOEXT_MM_WAIT mask,
+    guint count,
+    guint timeout_ms,
+    OfonoExtModemManagerWaitHandler fn,
+    void* data); /* Since 1.0.12 */
+
+gboolean
+ofonoext_mm_wait_sync(
+    OfonoExtModemManager* mm,
+    OFONOEXT_MM_WAIT mask,
+    guint count,
+    guint timeout_ms); /* Since 1.0.12 */
+
+/*
+ * Every change bumps the generation number of the manager and remembers
+ * it as the generation of the property that has changed. The generation
+ * is never zero after the first change. ofonoext_mm_changed_since()
+ * returns the current generation and sets the mask to the properties
+ * changed after the given one, e.g. the value returned by the previous
+ * call. Passing zero gives everything that has ever changed. When the
+ * manager becomes valid, every property it has fetched is considered
+ * changed along with valid, even though only valid-changed is emitted.
+ */
+guint64
+ofonoext_mm_generation(
+    OfonoExtModemManager* mm); /* Since 1.0.12 */
+
+guint64
+ofonoext_mm_changed_since(
+    OfonoExtModemManager* mm,
+    guint64 gen,
+    OFONOEXT_MM_CHANGED* mask); /* Since 1.0.12 */
+
+/*
+ * Change journal. Once enabled by giving it a non-zero size, the last
+ * size changes are kept in a ring, each with its sequence number (same
+ * as the generation) and the new value. Changing the size clears the
+ * journal. ofonoext_mm_events_since() copies up to max events following
+ * seq, oldest first, and returns how many it has copied. Passing the
+ * sequence number of the last event returned by the previous call pages
+ * through the journal. If any events following seq are no longer in
+ * the journal, lost is set to TRUE and the ones that are still there
+ * are copied. If some have never been in the journal (e.g. seq is older
+ * than the journal itself), lost is set to TRUE and nothing is copied.
+ */
+typedef struct ofonoext_mm_event {
+    guint64 seq;
+    gint64 time;                    /* g_get_monotonic_time() */
+    OFONOEXT_MM_CHANGED change;     /* Exactly one bit */
+    guint value;                    /* Flag, count or bitmask of slots */
+    const char* str;                /* Interned IMSI or modem path */
+} OfonoExtModemManagerEvent; /* Since 1.0.12 */
+
+void
+ofonoext_mm_set_journal_size(
+    OfonoExtModemManager* mm,
+    guint size); /* Since 1.0.12 */
+
+guint
+ofonoext_mm_events_since(
+    OfonoExtModemManager* mm,
+    guint64 seq,
+    OfonoExtModemManagerEvent* events,
+    guint max,
+    gboolean* lost); /* Since 1.0.12 */
+
+/*
+ * Counters accumulated over the lifetime of the instance. Calls include
+ * GetAll and the getters used for refreshing, cancelled calls are not
+ * counted as errors. Retries are GetAll calls repeated after a timeout,
+ * resets happen when the service disappears from the bus. Scenario
+ * instances only count the signals.
+ */
+typedef struct ofonoext_mm_counters {
+    guint64 calls;                  /* D-Bus method calls made */
+    guint64 call_errors;            /* Calls which have failed */
+    guint64 signals;                /* D-Bus signals received */
+    guint64 retries;
+    guint64 resets;
+} OfonoExtModemManagerCounters; /* Since 1.0.12 */
+
+void
+ofonoext_mm_get_counters(
+    OfonoExtModemManager* mm,
+    OfonoExtModemManagerCounters* counters); /* Since 1.0.12 */
+
+/*
+ * Integration with a foreign (e.g. epoll based) event loop. The file
+ * descriptor returned by ofonoext_mm_get_fd() becomes readable when the
+ * state has changed or when there's D-Bus traffic or an expired timer
+ * to process. When it's readable, call ofonoext_mm_dispatch() which runs
+ * the pending work of the default main context without blocking and
+ * returns the properties changed since the previous dispatch (all the
+ * ones that have ever changed the first time). Nothing else may be
+ * iterating the default main context at the same time. The descriptor
+ * is owned by the manager, -1 is returned on failure.
+ */
+int
+ofonoext_mm_get_fd(
+    OfonoExtModemManager* mm); /* Since 1.0.12 */
+
+OFONOEXT_MM_CHANGED
+ofonoext_mm_dispatch(
+    OfonoExtModemManager* mm); /* Since 1.0.12 */
+
+/*
+ * GIO style asynchronous calls. The callback is invoked in the thread
+ * default main context of the caller. ofonoext_mm_init_async() completes
+ * when the manager becomes valid, ofonoext_mm_refresh_async() after all
+ * the properties have been fetched again. The setters fail with
+ * G_IO_ERROR_NOT_INITIALIZED if the manager isn't valid yet.
+ */
+void
+ofonoext_mm_init_async(
+    OfonoExtModemManager* mm,
+    GCancellable* cancel,
+    GAsyncReadyCallback callback,
+    gpointer data); /* Since 1.0.12 */
+
+gboolean
+ofonoext_mm_init_finish(
+    OfonoExtModemManager* mm,
+    GAsyncResult* result,
+    GError** error); /* Since 1.0.12 */
+
+void
+ofonoext_mm_refresh_async(
+    OfonoExtModemManager* mm,
+    GCancellable* cancel,
+    GAsyncReadyCallback callback,
+    gpointer data); /* Since 1.0.12 */
+
+gboolean
+ofonoext_mm_refresh_finish(
+    OfonoExtModemManager* mm,
+    GAsyncResult* result,
+    GError** error); /* Since 1.0.12 */
+
+void
+ofonoext_mm_set_enabled_modems_async(
+    OfonoExtModemManager* mm,
+    const GStrV* modems,
+    GCancellable* cancel,
+    GAsyncReadyCallback callback,
+    gpointer data); /* Since 1.0.12 */
+
+gboolean
+ofonoext_mm_set_enabled_modems_finish(
+    OfonoExtModemManager* mm,
+    GAsyncResult* result,
+    GError** error); /* Since 1.0.12 */
+
+void
+ofonoext_mm_set_data_imsi_async(
+    OfonoExtModemManager* mm,
+    const char* imsi,
+    GCancellable* cancel,
+    GAsyncReadyCallback callback,
+    gpointer data); /* Since 1.0.12 */
+
+gboolean
+ofonoext_mm_set_data_imsi_finish(
+    OfonoExtModemManager* mm,
+    GAsyncResult* result,
+    GError** error); /* Since 1.0.12 */
+
+void
+ofonoext_mm_set_voice_imsi_async(
+    OfonoExtModemManager* mm,
+    const char* imsi,
+    GCancellable* cancel,
+    GAsyncReadyCallback callback,
+    gpointer data); /* Since 1.0.12 */
+
+gboolean
+ofonoext_mm_set_voice_imsi_finish(
+    OfonoExtModemManager* mm,
+    GAsyncResult* result,
+    GError** error); /* Since 1.0.12 */
+
+void
+ofonoext_mm_set_mms_imsi_async(
+    OfonoExtModemManager* mm,
+    const char* imsi,
+    GCancellable* cancel,
+    GAsyncReadyCallback callback,
+    gpointer data); /* Since 1.0.12 */
+
+char*
+ofonoext_mm_set_mms_imsi_finish(
+    OfonoExtModemManager* mm,
+    GAsyncResult* result,
+    GError** error); /* Since 1.0.12 */
+
 gulong
 ofonoext_mm_add_valid_changed_handler(
     OfonoExtModemManager* mm,
@@ -178,6 +612,27 @@ ofonoext_mm_add_ready_changed_handler(
     OfonoExtModemManagerHandler fn,
     void* data);
 
+gulong
+ofonoext_mm_add_slots_warm_handler(
+    OfonoExtModemManager* mm,
+    OfonoExtModemManagerHandler fn,
+    void* data); /* Since 1.0.12 */
+
+/*
+ * Batch handler is invoked with the set of changes (limited by the mask)
+ * which have occurred since its previous invocation. It's called at most
+ * once per interval, or just at idle if the interval is zero. Either way,
+ * the changes emitted back to back are merged into a single call. It's
+ * removed with ofonoext_mm_remove_handler() like any other handler.
+ */
+gulong
+ofonoext_mm_add_batch_handler(
+    OfonoExtModemManager* mm,
+    OFONOEXT_MM_CHANGED mask,
+    guint interval_ms,
+    OfonoExtModemManagerBatchHandler fn,
+    void* data); /* Since 1.0.12 */
+
 void
 ofonoext_mm_remove_handler(
     OfonoExtModemManager* mm,
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GOFONOEXT_RECORDER_H
+#define GOFONOEXT_RECORDER_H
+
+#include "gofonoext_types.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Binary event recorder file format (since 1.0.12)
+ *
+ * The file starts with OfonoExtRecorderHeader followed by the ring
+ * buffer of data_size bytes. Positions in the ring (head and tail) are
+ * byte counters which never wrap, the actual offset in the ring is
+ * the position modulo data_size. Records are 8-byte aligned and never
+ * cross the end of the ring. If the space left till the end of the ring
+ * is smaller than the record header, the reader skips to the beginning
+ * of the ring. Otherwise, that space is filled with a padding record.
+ *
+ * Valid records are between tail and head. The writer updates head
+ * after the record has been written, and moves tail forward before
+ * overwriting the oldest records. All numbers are in host byte order.
+ */
+
+#define OFONOEXT_RECORDER_MAGIC         (0x4d4d4f47) /* "GOMM" */
+#define OFONOEXT_RECORDER_FORMAT        (1)
+#define OFONOEXT_RECORDER_ALIGN         (8)
+
+typedef struct ofonoext_recorder_header {
+    guint32 magic;          /* OFONOEXT_RECORDER_MAGIC */
+    guint16 format;         /* OFONOEXT_RECORDER_FORMAT */
+    guint16 header_size;    /* sizeof(OfonoExtRecorderHeader) */
+    guint32 data_size;      /* Size of the ring, in bytes */
+    guint32 reserved;
+    guint64 head;           /* Where the next record will be written */
+    guint64 tail;           /* Oldest record */
+    guint64 count;          /* Number of records ever written */
+} OfonoExtRecorderHeader;
+
+typedef struct ofonoext_recorder_record {
+    guint16 size;           /* Total size including padding */
+    guint16 length;         /* Payload length */
+    guint8 type;            /* OFONOEXT_RECORD_TYPE */
+    guint8 code;            /* OFONOEXT_RECORD_INPUT or _OUTPUT */
+    guint16 reserved;
+    gint64 time;            /* Microseconds since the Epoch */
+    /* Payload follows */
+} OfonoExtRecorderRecord;
+
+typedef enum ofonoext_record_type {
+    OFONOEXT_RECORD_PADDING,
+    OFONOEXT_RECORD_INPUT,  /* Incoming event */
+    OFONOEXT_RECORD_OUTPUT  /* Emitted change */
+} OFONOEXT_RECORD_TYPE;
+
+/*
+ * Payload of the input records:
+ *
+ * strings - the string without the terminating NUL
+ * modems - NUL terminated strings one after another
+ * present SIMs - gint32 slot index followed by a single byte flag
+ * ready - a single byte flag
+ * name appeared - unique name of the owner
+ * state - gint32 interface version, followed by the input records
+ *         describing the current state (as if it has just changed)
+ * available modems, IMEI - same as modems
+ */
+typedef enum ofonoext_record_input {
+    OFONOEXT_RECORD_INPUT_ENABLED_MODEMS,
+    OFONOEXT_RECORD_INPUT_DATA_IMSI,
+    OFONOEXT_RECORD_INPUT_DATA_MODEM,
+    OFONOEXT_RECORD_INPUT_VOICE_IMSI,
+    OFONOEXT_RECORD_INPUT_VOICE_MODEM,
+    OFONOEXT_RECORD_INPUT_PRESENT_SIMS,
+    OFONOEXT_RECORD_INPUT_MMS_IMSI,
+    OFONOEXT_RECORD_INPUT_MMS_MODEM,
+    OFONOEXT_RECORD_INPUT_READY,
+    OFONOEXT_RECORD_INPUT_NAME_APPEARED,
+    OFONOEXT_RECORD_INPUT_NAME_VANISHED,
+    OFONOEXT_RECORD_INPUT_STATE,
+    OFONOEXT_RECORD_INPUT_AVAILABLE_MODEMS,
+    OFONOEXT_RECORD_INPUT_IMEI
+} OFONOEXT_RECORD_INPUT;
+
+/* Output records have no payload */
+typedef enum ofonoext_record_output {
+    OFONOEXT_RECORD_OUTPUT_VALID,
+    OFONOEXT_RECORD_OUTPUT_ENABLED_MODEMS,
+    OFONOEXT_RECORD_OUTPUT_DATA_IMSI,
+    OFONOEXT_RECORD_OUTPUT_DATA_MODEM,
+    OFONOEXT_RECORD_OUTPUT_VOICE_IMSI,
+    OFONOEXT_RECORD_OUTPUT_VOICE_MODEM,
+    OFONOEXT_RECORD_OUTPUT_MMS_IMSI,
+    OFONOEXT_RECORD_OUTPUT_MMS_MODEM,
+    OFONOEXT_RECORD_OUTPUT_PRESENT_SIMS,
+    OFONOEXT_RECORD_OUTPUT_SIM_COUNT,
+    OFONOEXT_RECORD_OUTPUT_ACTIVE_SIM_COUNT,
+    OFONOEXT_RECORD_OUTPUT_READY,
+    OFONOEXT_RECORD_OUTPUT_SLOTS_WARM
+} OFONOEXT_RECORD_OUTPUT;
+
+G_END_DECLS
+
+#endif /* GOFONOEXT_RECORDER_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
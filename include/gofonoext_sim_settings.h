@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GOFONOEXT_SIM_SETTINGS_H
+#define GOFONOEXT_SIM_SETTINGS_H
+
+#include "gofonoext_types.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Client side of org.nemomobile.ofono.SimSettings (since 1.0.12)
+ *
+ * There's one instance per modem path in the process. Properties are
+ * fetched once and then kept up to date by PropertyChanged signals.
+ * Values returned by the getters are owned by the cache and remain
+ * valid until the property changes.
+ */
+
+typedef struct ofonoext_sim_settings_priv OfonoExtSimSettingsPriv;
+
+struct ofonoext_sim_settings {
+    GObject object;
+    OfonoExtSimSettingsPriv* priv;
+    const char* path;
+    gboolean valid;
+};
+
+GType ofonoext_sim_settings_get_type(void);
+#define OFONOEXT_TYPE_SIM_SETTINGS (ofonoext_sim_settings_get_type())
+#define OFONOEXT_SIM_SETTINGS(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), \
+        OFONOEXT_TYPE_SIM_SETTINGS, OfonoExtSimSettings))
+
+typedef
+void
+(*OfonoExtSimSettingsHandler)(
+    OfonoExtSimSettings* ss,
+    void* data);
+
+typedef
+void
+(*OfonoExtSimSettingsPropertyHandler)(
+    OfonoExtSimSettings* ss,
+    const char* name,
+    GVariant* value,
+    void* data);
+
+OfonoExtSimSettings*
+ofonoext_sim_settings_new(
+    const char* path);
+
+OfonoExtSimSettings*
+ofonoext_sim_settings_ref(
+    OfonoExtSimSettings* ss);
+
+void
+ofonoext_sim_settings_unref(
+    OfonoExtSimSettings* ss);
+
+GVariant*
+ofonoext_sim_settings_get_property(
+    OfonoExtSimSettings* ss,
+    const char* name);
+
+const char*
+ofonoext_sim_settings_get_string(
+    OfonoExtSimSettings* ss,
+    const char* name);
+
+GStrV*
+ofonoext_sim_settings_get_names(
+    OfonoExtSimSettings* ss);
+
+void
+ofonoext_sim_settings_set_property(
+    OfonoExtSimSettings* ss,
+    const char* name,
+    GVariant* value);
+
+gulong
+ofonoext_sim_settings_add_valid_changed_handler(
+    OfonoExtSimSettings* ss,
+    OfonoExtSimSettingsHandler fn,
+    void* data);
+
+gulong
+ofonoext_sim_settings_add_property_changed_handler(
+    OfonoExtSimSettings* ss,
+    const char* name, /* NULL for all properties */
+    OfonoExtSimSettingsPropertyHandler fn,
+    void* data);
+
+void
+ofonoext_sim_settings_remove_handler(
+    OfonoExtSimSettings* ss,
+    gulong id);
+
+void
+ofonoext_sim_settings_remove_handlers(
+    OfonoExtSimSettings* ss,
+    gulong* ids,
+    unsigned int count);
+
+#define ofonoext_sim_settings_remove_all_handlers(ss, ids) \
+    ofonoext_sim_settings_remove_handlers(ss, ids, G_N_ELEMENTS(ids))
+
+G_END_DECLS
+
+#endif /* GOFONOEXT_SIM_SETTINGS_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
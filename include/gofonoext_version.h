@@ -39,7 +39,7 @@
 
 #define GOFONOEXT_VERSION_MAJOR   1
 #define GOFONOEXT_VERSION_MINOR   0
-#define GOFONOEXT_VERSION_RELEASE 11
+#define GOFONOEXT_VERSION_RELEASE 12
 
 #define GOFONOEXT_API_VERSION(major,minor,release) \
     (((major) << 24) | ((minor) << 16) | (release))
@@ -1,5 +1,5 @@
 Name: libgofonoext
-Version: 1.0.11
+Version: 1.0.12
 Release: 0
 Summary: Client library for Sailfish OS ofono extensions
 Group: Development/Libraries
@@ -31,7 +31,7 @@ This package contains the development library for %{name}.
 %setup -q
 
 %build
-make LIBDIR=%{_libdir} KEEP_SYMBOLS=1 release pkgconfig
+make LIBDIR=%{_libdir} KEEP_SYMBOLS=1 release release-opt pkgconfig
 
 %install
 rm -rf %{buildroot}
@@ -49,4 +49,6 @@ make LIBDIR=%{_libdir} DESTDIR=%{buildroot} install-dev
 %defattr(-,root,root,-)
 %{_libdir}/pkgconfig/*.pc
 %{_libdir}/%{name}.so
+%{_libdir}/%{name}.a
 %{_includedir}/gofonoext/*.h
+%{_includedir}/gofonoext/*.hpp
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gofonoext_arena_p.h"
+
+#include <string.h>
+
+/* All allocations are pointer aligned */
+#define ARENA_ALIGN(n) (((n) + sizeof(gpointer) - 1) & ~(sizeof(gpointer) - 1))
+#define ARENA_MIN_BLOCK (256)
+
+typedef struct ofonoext_arena_block OfonoExtArenaBlock;
+
+struct ofonoext_arena_block {
+    OfonoExtArenaBlock* next;
+    gsize size;
+    gsize used;
+    /* Data follow, aligned */
+};
+
+struct ofonoext_arena {
+    OfonoExtArenaBlock* blocks;
+    gsize used;
+};
+
+#define ARENA_BLOCK_HEADER ARENA_ALIGN(sizeof(OfonoExtArenaBlock))
+#define ARENA_HEADER ARENA_ALIGN(sizeof(OfonoExtArena))
+
+static
+OfonoExtArenaBlock*
+ofonoext_arena_block_init(
+    void* mem,
+    gsize size,
+    OfonoExtArenaBlock* next)
+{
+    OfonoExtArenaBlock* block = mem;
+
+    block->next = next;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+OfonoExtArena*
+ofonoext_arena_new(
+    gsize size)
+{
+    /* The arena itself and the first block are a single allocation */
+    const gsize block_size = ARENA_ALIGN(MAX(size, ARENA_MIN_BLOCK));
+    guint8* mem = g_malloc(ARENA_HEADER + ARENA_BLOCK_HEADER + block_size);
+    OfonoExtArena* arena = (OfonoExtArena*)mem;
+
+    arena->blocks = ofonoext_arena_block_init(mem + ARENA_HEADER,
+        block_size, NULL);
+    arena->used = 0;
+    return arena;
+}
+
+void
+ofonoext_arena_free(
+    OfonoExtArena* arena)
+{
+    if (arena) {
+        OfonoExtArenaBlock* block = arena->blocks;
+
+        /* The last block is a part of the arena allocation */
+        while (block->next) {
+            OfonoExtArenaBlock* next = block->next;
+
+            g_free(block);
+            block = next;
+        }
+        g_free(arena);
+    }
+}
+
+void*
+ofonoext_arena_alloc(
+    OfonoExtArena* arena,
+    gsize size)
+{
+    OfonoExtArenaBlock* block = arena->blocks;
+    void* ptr;
+
+    size = ARENA_ALIGN(size);
+    if (block->used + size > block->size) {
+        /* Grow geometrically to keep the number of blocks small */
+        const gsize block_size = MAX(size, block->size * 2);
+
+        block = ofonoext_arena_block_init(g_malloc(ARENA_BLOCK_HEADER +
+            block_size), block_size, block);
+        arena->blocks = block;
+    }
+    ptr = ((guint8*)block) + ARENA_BLOCK_HEADER + block->used;
+    block->used += size;
+    arena->used += size;
+    return ptr;
+}
+
+char*
+ofonoext_arena_strdup(
+    OfonoExtArena* arena,
+    const char* str)
+{
+    if (str) {
+        const gsize len = strlen(str) + 1;
+
+        return memcpy(ofonoext_arena_alloc(arena, len), str, len);
+    }
+    return NULL;
+}
+
+GStrV*
+ofonoext_arena_strdupv(
+    OfonoExtArena* arena,
+    const GStrV* sv)
+{
+    if (sv) {
+        const guint n = g_strv_length((GStrV*)sv);
+        GStrV* copy = ofonoext_arena_alloc(arena, sizeof(char*) * (n + 1));
+        guint i;
+
+        for (i = 0; i < n; i++) {
+            copy[i] = ofonoext_arena_strdup(arena, sv[i]);
+        }
+        copy[n] = NULL;
+        return copy;
+    }
+    return NULL;
+}
+
+gsize
+ofonoext_arena_str_size(
+    const char* str)
+{
+    return str ? ARENA_ALIGN(strlen(str) + 1) : 0;
+}
+
+gsize
+ofonoext_arena_strv_size(
+    const GStrV* sv)
+{
+    gsize size = 0;
+
+    if (sv) {
+        const GStrV* ptr;
+
+        for (ptr = sv; *ptr; ptr++) {
+            size += ofonoext_arena_str_size(*ptr) + sizeof(char*);
+        }
+        size += sizeof(char*);
+    }
+    return ARENA_ALIGN(size);
+}
+
+gsize
+ofonoext_arena_used(
+    OfonoExtArena* arena)
+{
+    return arena ? arena->used : 0;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GOFONOEXT_ARENA_PRIVATE_H
+#define GOFONOEXT_ARENA_PRIVATE_H
+
+#include "gofonoext_types.h"
+
+/*
+ * Bump allocator. Individual allocations are never freed, everything
+ * goes away at once with ofonoext_arena_free(). The first block has the
+ * requested size, more blocks are added if it runs out.
+ */
+typedef struct ofonoext_arena OfonoExtArena;
+
+OfonoExtArena*
+ofonoext_arena_new(
+    gsize size)
+    G_GNUC_INTERNAL;
+
+void
+ofonoext_arena_free(
+    OfonoExtArena* arena)
+    G_GNUC_INTERNAL;
+
+void*
+ofonoext_arena_alloc(
+    OfonoExtArena* arena,
+    gsize size)
+    G_GNUC_INTERNAL;
+
+char*
+ofonoext_arena_strdup(
+    OfonoExtArena* arena,
+    const char* str)
+    G_GNUC_INTERNAL;
+
+GStrV*
+ofonoext_arena_strdupv(
+    OfonoExtArena* arena,
+    const GStrV* sv)
+    G_GNUC_INTERNAL;
+
+gsize
+ofonoext_arena_str_size(
+    const char* str)
+    G_GNUC_INTERNAL;
+
+gsize
+ofonoext_arena_strv_size(
+    const GStrV* sv)
+    G_GNUC_INTERNAL;
+
+gsize
+ofonoext_arena_used(
+    OfonoExtArena* arena)
+    G_GNUC_INTERNAL;
+
+#endif /* GOFONOEXT_ARENA_PRIVATE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -36,9 +36,18 @@ void
 ofonoext_call_init(
     OfonoExtCall* call,
     GObject* owner)
+{
+    ofonoext_call_init_full(call, owner, NULL);
+}
+
+void
+ofonoext_call_init_full(
+    OfonoExtCall* call,
+    GObject* owner,
+    GCancellable* cancel)
 {
     call->owner = g_object_ref(owner);
-    call->cancel = g_cancellable_new();
+    call->cancel = cancel ? g_object_ref(cancel) : g_cancellable_new();
 }
 
 void
@@ -46,6 +46,13 @@ ofonoext_call_init(
     GObject* owner)
     G_GNUC_INTERNAL;
 
+void
+ofonoext_call_init_full(
+    OfonoExtCall* call,
+    GObject* owner,
+    GCancellable* cancel)
+    G_GNUC_INTERNAL;
+
 void
 ofonoext_call_destroy(
     OfonoExtCall* call)
@@ -0,0 +1,599 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gofonoext_exporter_p.h"
+#include "gofonoext_mm_p.h"
+#include "gofonoext_log.h"
+
+#include <gofono_modem.h>
+
+#include <gutil_strv.h>
+
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+
+#include <string.h>
+#include <unistd.h>
+
+#define EXPORTER_PREFIX "gofonoext_mm_"
+#define EXPORTER_REQUEST_MAX (1024)
+#define EXPORTER_REQUEST_TIMEOUT_MS (1000)
+
+struct ofonoext_exporter {
+    GSocketService* service;
+    char* file;                 /* NULL for an abstract socket */
+    GPtrArray* mms;             /* Weak references */
+};
+
+typedef struct ofonoext_exporter_client {
+    GSocketConnection* connection;
+    GCancellable* cancel;
+    guint timeout_id;
+    char* body;
+    char* response;
+    gsize received;
+    char request[EXPORTER_REQUEST_MAX + 1];
+} OfonoExtExporterClient;
+
+/* Everything is sampled as a 64-bit number */
+typedef struct ofonoext_exporter_sample {
+    OfonoExtModemManagerCounters counters;
+    guint64 changes;
+    guint64 valid;
+    guint64 ready;
+    guint64 modems;
+    guint64 enabled;
+    guint64 sims;
+    guint64 active_sims;
+} OfonoExtExporterSample;
+
+typedef struct ofonoext_exporter_metric {
+    const char* name;
+    const char* type;
+    const char* help;
+    glong offset;
+} OfonoExtExporterMetric;
+
+#define SAMPLE(field) G_STRUCT_OFFSET(OfonoExtExporterSample, field)
+
+static const OfonoExtExporterMetric ofonoext_exporter_metrics[] = {
+    { "dbus_calls_total", "counter",
+      "D-Bus method calls made", SAMPLE(counters.calls) },
+    { "dbus_call_errors_total", "counter",
+      "D-Bus method calls which have failed", SAMPLE(counters.call_errors) },
+    { "dbus_signals_total", "counter",
+      "D-Bus signals received", SAMPLE(counters.signals) },
+    { "retries_total", "counter",
+      "GetAll calls retried after a timeout", SAMPLE(counters.retries) },
+    { "resets_total", "counter",
+      "State resets caused by the service going away",
+      SAMPLE(counters.resets) },
+    { "changes_total", "counter",
+      "Change notifications emitted", SAMPLE(changes) },
+    { "valid", "gauge",
+      "Whether the state has been fetched from the service", SAMPLE(valid) },
+    { "ready", "gauge",
+      "Whether the service reports itself ready", SAMPLE(ready) },
+    { "modems", "gauge",
+      "Number of available modems", SAMPLE(modems) },
+    { "enabled_modems", "gauge",
+      "Number of enabled modems", SAMPLE(enabled) },
+    { "sims", "gauge",
+      "Number of present SIMs", SAMPLE(sims) },
+    { "active_sims", "gauge",
+      "Number of present SIMs in enabled modems", SAMPLE(active_sims) }
+};
+
+static OfonoExtExporter* ofonoext_exporter_env = NULL;
+
+/*==========================================================================*
+ * Text format
+ *==========================================================================*/
+
+static
+void
+ofonoext_exporter_append_label(
+    GString* out,
+    const char* name,
+    const char* value)
+{
+    const char* ptr;
+
+    if (out->len && out->str[out->len - 1] != '{') {
+        g_string_append_c(out, ',');
+    }
+    g_string_append(out, name);
+    g_string_append(out, "=\"");
+    for (ptr = value ? value : ""; *ptr; ptr++) {
+        switch (*ptr) {
+        case '\\':
+            g_string_append(out, "\\\\");
+            break;
+        case '"':
+            g_string_append(out, "\\\"");
+            break;
+        case '\n':
+            g_string_append(out, "\\n");
+            break;
+        default:
+            g_string_append_c(out, *ptr);
+            break;
+        }
+    }
+    g_string_append_c(out, '"');
+}
+
+/* Returns the label set without the closing brace */
+static
+char*
+ofonoext_exporter_labels(
+    OfonoExtModemManager* mm)
+{
+    GString* out = g_string_new("{");
+    char flags[16];
+
+    /* Instances with different flags are different time series */
+    g_snprintf(flags, sizeof(flags), "%u", (guint)ofonoext_mm_flags(mm));
+    ofonoext_exporter_append_label(out, "service", ofonoext_mm_service(mm));
+    ofonoext_exporter_append_label(out, "path", ofonoext_mm_path(mm));
+    ofonoext_exporter_append_label(out, "flags", flags);
+    return g_string_free(out, FALSE);
+}
+
+static
+void
+ofonoext_exporter_sample(
+    OfonoExtModemManager* mm,
+    OfonoExtExporterSample* sample)
+{
+    ofonoext_mm_get_counters(mm, &sample->counters);
+    sample->changes = ofonoext_mm_generation(mm);
+    sample->valid = mm->valid;
+    sample->ready = mm->ready;
+    sample->modems = mm->modem_count;
+    sample->enabled = gutil_strv_length(mm->enabled);
+    sample->sims = mm->sim_count;
+    sample->active_sims = mm->active_sim_count;
+}
+
+static
+const char*
+ofonoext_exporter_modem_path(
+    OfonoModem* modem)
+{
+    return modem ? modem->object.path : "";
+}
+
+static
+void
+ofonoext_exporter_format(
+    OfonoExtExporter* self,
+    GString* out)
+{
+    const guint n = self->mms->len;
+    OfonoExtExporterSample* samples = g_new(OfonoExtExporterSample, n);
+    char** labels = g_new(char*, n);
+    GString* info = g_string_new(NULL);
+    guint i, k;
+
+    for (i=0; i<n; i++) {
+        OfonoExtModemManager* mm = self->mms->pdata[i];
+
+        ofonoext_exporter_sample(mm, samples + i);
+        labels[i] = ofonoext_exporter_labels(mm);
+    }
+
+    for (k=0; k<G_N_ELEMENTS(ofonoext_exporter_metrics); k++) {
+        const OfonoExtExporterMetric* metric = ofonoext_exporter_metrics + k;
+
+        g_string_append_printf(out, "# HELP " EXPORTER_PREFIX "%s %s\n"
+            "# TYPE " EXPORTER_PREFIX "%s %s\n", metric->name, metric->help,
+            metric->name, metric->type);
+        for (i=0; i<n; i++) {
+            g_string_append_printf(out, EXPORTER_PREFIX "%s%s} %"
+                G_GUINT64_FORMAT "\n", metric->name, labels[i],
+                G_STRUCT_MEMBER(guint64, samples + i, metric->offset));
+        }
+    }
+
+    /* Modem paths only, IMSIs and IMEIs are not for the monitoring */
+    g_string_append(out, "# HELP " EXPORTER_PREFIX "info Default modems\n"
+        "# TYPE " EXPORTER_PREFIX "info gauge\n");
+    for (i=0; i<n; i++) {
+        OfonoExtModemManager* mm = self->mms->pdata[i];
+
+        g_string_assign(info, labels[i]);
+        ofonoext_exporter_append_label(info, "data_modem",
+            ofonoext_exporter_modem_path(mm->data_modem));
+        ofonoext_exporter_append_label(info, "voice_modem",
+            ofonoext_exporter_modem_path(mm->voice_modem));
+        ofonoext_exporter_append_label(info, "mms_modem",
+            ofonoext_exporter_modem_path(mm->mms_modem));
+        g_string_append_printf(out, EXPORTER_PREFIX "info%s} 1\n",
+            info->str);
+        g_free(labels[i]);
+    }
+    g_string_free(info, TRUE);
+    g_free(labels);
+    g_free(samples);
+}
+
+/*==========================================================================*
+ * Clients
+ *==========================================================================*/
+
+static
+void
+ofonoext_exporter_client_free(
+    OfonoExtExporterClient* client)
+{
+    if (client->timeout_id) {
+        g_source_remove(client->timeout_id);
+    }
+    /* Dropping the last reference closes the connection */
+    g_object_unref(client->connection);
+    g_object_unref(client->cancel);
+    g_free(client->body);
+    g_free(client->response);
+    g_slice_free(OfonoExtExporterClient, client);
+}
+
+static
+void
+ofonoext_exporter_client_written(
+    GObject* stream,
+    GAsyncResult* result,
+    gpointer data)
+{
+    GError* error = NULL;
+
+    if (!g_output_stream_write_all_finish(G_OUTPUT_STREAM(stream), result,
+        NULL, &error)) {
+        GDEBUG("%s", GERRMSG(error));
+        g_error_free(error);
+    }
+    ofonoext_exporter_client_free(data);
+}
+
+static
+void
+ofonoext_exporter_client_respond(
+    OfonoExtExporterClient* client)
+{
+    const char* response;
+
+    if (client->timeout_id) {
+        g_source_remove(client->timeout_id);
+        client->timeout_id = 0;
+    }
+    if (g_str_has_prefix(client->request, "GET ")) {
+        response = client->response = g_strdup_printf("HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %u\r\n"
+            "Connection: close\r\n\r\n%s",
+            (guint)strlen(client->body), client->body);
+    } else {
+        response = client->body;
+    }
+    g_output_stream_write_all_async(g_io_stream_get_output_stream
+        (G_IO_STREAM(client->connection)), response, strlen(response),
+        G_PRIORITY_DEFAULT, NULL, ofonoext_exporter_client_written, client);
+}
+
+static
+void
+ofonoext_exporter_client_read(
+    OfonoExtExporterClient* client);
+
+static
+void
+ofonoext_exporter_client_read_done(
+    GObject* stream,
+    GAsyncResult* result,
+    gpointer data)
+{
+    OfonoExtExporterClient* client = data;
+    GError* error = NULL;
+    const gssize n = g_input_stream_read_finish(G_INPUT_STREAM(stream),
+        result, &error);
+
+    if (n > 0) {
+        client->received += n;
+        client->request[client->received] = 0;
+        if (client->received < EXPORTER_REQUEST_MAX &&
+            !strstr(client->request, "\r\n\r\n") &&
+            !strstr(client->request, "\n\n")) {
+            /* The request is not complete yet */
+            ofonoext_exporter_client_read(client);
+            return;
+        }
+    } else if (error) {
+        /* Including the timeout */
+        GDEBUG("%s", GERRMSG(error));
+        g_error_free(error);
+    }
+    ofonoext_exporter_client_respond(client);
+}
+
+static
+void
+ofonoext_exporter_client_read(
+    OfonoExtExporterClient* client)
+{
+    g_input_stream_read_async(g_io_stream_get_input_stream
+        (G_IO_STREAM(client->connection)), client->request +
+        client->received, EXPORTER_REQUEST_MAX - client->received,
+        G_PRIORITY_DEFAULT, client->cancel,
+        ofonoext_exporter_client_read_done, client);
+}
+
+static
+gboolean
+ofonoext_exporter_client_timeout(
+    gpointer data)
+{
+    OfonoExtExporterClient* client = data;
+
+    client->timeout_id = 0;
+    g_cancellable_cancel(client->cancel);
+    return G_SOURCE_REMOVE;
+}
+
+static
+gboolean
+ofonoext_exporter_incoming(
+    GSocketService* service,
+    GSocketConnection* connection,
+    GObject* source,
+    gpointer data)
+{
+    OfonoExtExporterClient* client = g_slice_new0(OfonoExtExporterClient);
+
+    /* The snapshot is taken right away, the client doesn't need us later */
+    client->connection = g_object_ref(connection);
+    client->cancel = g_cancellable_new();
+    client->body = ofonoext_exporter_snapshot(data);
+    client->timeout_id = g_timeout_add(EXPORTER_REQUEST_TIMEOUT_MS,
+        ofonoext_exporter_client_timeout, client);
+    ofonoext_exporter_client_read(client);
+    return TRUE;
+}
+
+/*==========================================================================*
+ * Implementation
+ *==========================================================================*/
+
+static
+void
+ofonoext_exporter_mm_gone(
+    gpointer data,
+    GObject* mm)
+{
+    OfonoExtExporter* self = data;
+
+    g_ptr_array_remove_fast(self->mms, mm);
+}
+
+/* The socket file is left behind if the owner has crashed */
+static
+gboolean
+ofonoext_exporter_is_stale(
+    GSocketAddress* address)
+{
+    gboolean stale = FALSE;
+    GError* error = NULL;
+    GSocket* socket = g_socket_new(G_SOCKET_FAMILY_UNIX,
+        G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, NULL);
+
+    if (socket) {
+        if (!g_socket_connect(socket, address, NULL, &error)) {
+            stale = g_error_matches(error, G_IO_ERROR,
+                G_IO_ERROR_CONNECTION_REFUSED);
+            g_error_free(error);
+        }
+        g_object_unref(socket);
+    }
+    return stale;
+}
+
+static
+gboolean
+ofonoext_exporter_listen(
+    GSocketService* service,
+    GSocketAddress* address,
+    const char* file,
+    GError** error)
+{
+    GSocketListener* listener = G_SOCKET_LISTENER(service);
+    GError* err = NULL;
+
+    if (g_socket_listener_add_address(listener, address,
+        G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL,
+        &err)) {
+        return TRUE;
+    } else if (file && g_error_matches(err, G_IO_ERROR,
+        G_IO_ERROR_ADDRESS_IN_USE) && ofonoext_exporter_is_stale(address)) {
+        GDEBUG("Removing stale %s", file);
+        g_error_free(err);
+        unlink(file);
+        return g_socket_listener_add_address(listener, address,
+            G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL,
+            error);
+    } else {
+        g_propagate_error(error, err);
+        return FALSE;
+    }
+}
+
+/*==========================================================================*
+ * API
+ *==========================================================================*/
+
+OfonoExtExporter*
+ofonoext_exporter_new(
+    const char* path,
+    GError** error)
+{
+    OfonoExtExporter* self = NULL;
+
+    /* A lone '@' is not a name */
+    if (path && path[0] && (path[0] != '@' || path[1])) {
+        GSocketService* service = g_socket_service_new();
+        const char* file = (path[0] == '@') ? NULL : path;
+        GSocketAddress* address = file ?
+            g_unix_socket_address_new(file) :
+            g_unix_socket_address_new_with_type(path + 1, -1,
+                G_UNIX_SOCKET_ADDRESS_ABSTRACT);
+
+        if (ofonoext_exporter_listen(service, address, file, error)) {
+            GDEBUG("Exporting metrics at %s", path);
+            self = g_new0(OfonoExtExporter, 1);
+            self->service = service;
+            self->file = g_strdup(file);
+            self->mms = g_ptr_array_new();
+            g_signal_connect(service, "incoming",
+                G_CALLBACK(ofonoext_exporter_incoming), self);
+            g_socket_service_start(service);
+        } else {
+            g_object_unref(service);
+        }
+        g_object_unref(address);
+    } else {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+            "Invalid socket path");
+    }
+    return self;
+}
+
+void
+ofonoext_exporter_free(
+    OfonoExtExporter* self)
+{
+    if (G_LIKELY(self)) {
+        guint i;
+
+        for (i=0; i<self->mms->len; i++) {
+            g_object_weak_unref(G_OBJECT(self->mms->pdata[i]),
+                ofonoext_exporter_mm_gone, self);
+        }
+        g_ptr_array_free(self->mms, TRUE);
+
+        /* Clients being served have their own snapshots */
+        g_socket_service_stop(self->service);
+        g_socket_listener_close(G_SOCKET_LISTENER(self->service));
+        g_signal_handlers_disconnect_by_data(self->service, self);
+        g_object_unref(self->service);
+        if (self->file) {
+            unlink(self->file);
+            g_free(self->file);
+        }
+        g_free(self);
+    }
+}
+
+void
+ofonoext_exporter_add(
+    OfonoExtExporter* self,
+    OfonoExtModemManager* mm)
+{
+    if (G_LIKELY(self) && G_LIKELY(mm)) {
+        guint i;
+
+        for (i=0; i<self->mms->len; i++) {
+            if (self->mms->pdata[i] == mm) {
+                return;
+            }
+        }
+        g_object_weak_ref(G_OBJECT(mm), ofonoext_exporter_mm_gone, self);
+        g_ptr_array_add(self->mms, mm);
+    }
+}
+
+void
+ofonoext_exporter_remove(
+    OfonoExtExporter* self,
+    OfonoExtModemManager* mm)
+{
+    if (G_LIKELY(self) && G_LIKELY(mm) &&
+        g_ptr_array_remove_fast(self->mms, mm)) {
+        g_object_weak_unref(G_OBJECT(mm), ofonoext_exporter_mm_gone, self);
+    }
+}
+
+char*
+ofonoext_exporter_snapshot(
+    OfonoExtExporter* self)
+{
+    GString* out = g_string_sized_new(2048);
+
+    if (G_LIKELY(self)) {
+        ofonoext_exporter_format(self, out);
+    }
+    return g_string_free(out, FALSE);
+}
+
+/*==========================================================================*
+ * Internal API
+ *==========================================================================*/
+
+void
+ofonoext_exporter_add_from_env(
+    OfonoExtModemManager* mm)
+{
+    static gsize init = 0;
+
+    if (g_once_init_enter(&init)) {
+        const char* path = g_getenv(OFONOEXT_EXPORTER_ENV);
+
+        /* The exporter stays around until the process exits */
+        if (path && path[0]) {
+            GError* error = NULL;
+
+            ofonoext_exporter_env = ofonoext_exporter_new(path, &error);
+            if (!ofonoext_exporter_env) {
+                GERR("%s: %s", path, GERRMSG(error));
+                g_error_free(error);
+            }
+        }
+        g_once_init_leave(&init, 1);
+    }
+    if (ofonoext_exporter_env) {
+        ofonoext_exporter_add(ofonoext_exporter_env, mm);
+    }
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -32,16 +32,27 @@
 
 #define GLIB_DISABLE_DEPRECATION_WARNINGS
 
-#include "gofonoext_mm.h"
+#include "gofonoext_mm_p.h"
+#include "gofonoext_arena_p.h"
 #include "gofonoext_call_p.h"
+#include "gofonoext_exporter_p.h"
+#include "gofonoext_poll_p.h"
+#include "gofonoext_recorder_p.h"
+#include "gofonoext_ring_p.h"
+#include "gofonoext_scenario_p.h"
+#include "gofonoext_worker_p.h"
 #include "gofonoext_log.h"
 
 #include <gofono_modem.h>
 #include <gofono_names.h>
+#include <gofono_simmgr.h>
 
 #include <gutil_strv.h>
 #include <gutil_misc.h>
 
+#include <stdlib.h>
+#include <string.h>
+
 /* Generated headers */
 #include "org.nemomobile.ofono.ModemManager.h"
 
@@ -51,6 +62,25 @@ GLOG_MODULE_DEFINE("ofonoext");
 /* Retry delay */
 #define MM_RETRY_SEC (2)
 
+/* Slots without a SIM manager are warm as soon as the modem is */
+#define MM_SIMMGR_INTERFACE "org.ofono.SimManager"
+
+/* GOFONOEXT_RECORD=file[:size] turns on the recorder at startup */
+#define MM_RECORD_ENV "GOFONOEXT_RECORD"
+#define MM_RECORD_DEFAULT_SIZE (0x40000)
+
+/* GOFONOEXT_HANDLER_BUDGET=usec turns on handler timing at startup */
+#define MM_HANDLER_BUDGET_ENV "GOFONOEXT_HANDLER_BUDGET"
+
+/* IMSI is at most 15 digits */
+#define MM_IMSI_MAX_LEN (15)
+
+/* Repack the changed strings once this much memory has been replaced */
+#define MM_ARENA_MAX_GARBAGE (0x1000)
+
+/* D-Bus interface */
+#define MM_INTERFACE "org.nemomobile.ofono.ModemManager"
+
 /* Object definition */
 enum proxy_handler_id {
     PROXY_SIGNAL_ENABLED_MODEMS_CHANGED,
@@ -65,25 +95,98 @@ enum proxy_handler_id {
     PROXY_SIGNAL_COUNT
 };
 
-struct ofonoext_mm_priv {
-    GDBusConnection* bus;
-    OrgNemomobileOfonoModemManager* proxy;
-    gulong proxy_signal_id[PROXY_SIGNAL_COUNT];
-    guint ofono_watch_id;
-    guint retry_timer_id;
-    int version;
-    GCancellable* cancel;
-    GStrV* available;
-    GStrV* enabled;
-    char* data_imsi;
-    char* voice_imsi;
-    char* mms_imsi;
-    gboolean* present_sims;
-    GStrV* imei;
+G_STATIC_ASSERT((int)PROXY_SIGNAL_COUNT ==
+    (int)OFONOEXT_MM_PROPERTY_READY + 1);
+
+/* Instances are shared if these match */
+typedef struct ofonoext_mm_key {
+    GDBusConnection* bus;       /* NULL means OFONO_BUS_TYPE */
+    const char* service;
+    const char* path;
+    guint flags;
+} OfonoExtModemManagerKey;
+
+/* Per-slot objects created by the prefetch */
+enum slot_modem_handler_id {
+    SLOT_MODEM_VALID_CHANGED,
+    SLOT_MODEM_INTERFACES_CHANGED,
+    SLOT_MODEM_HANDLER_COUNT
 };
 
-typedef GObjectClass OfonoExtModemManagerClass;
-G_DEFINE_TYPE(OfonoExtModemManager, ofonoext_mm, G_TYPE_OBJECT)
+enum slot_simmgr_handler_id {
+    SLOT_SIMMGR_VALID_CHANGED,
+    SLOT_SIMMGR_IMSI_CHANGED,
+    SLOT_SIMMGR_PRESENT_CHANGED,
+    SLOT_SIMMGR_HANDLER_COUNT
+};
+
+typedef struct ofonoext_mm_slot {
+    OfonoExtModemManager* mm;
+    gint index;
+    OfonoModem* modem;
+    OfonoSimMgr* simmgr;
+    gulong modem_event_id[SLOT_MODEM_HANDLER_COUNT];
+    gulong simmgr_event_id[SLOT_SIMMGR_HANDLER_COUNT];
+} OfonoExtModemManagerSlot;
+
+/* OFONOEXT_MM_FLAG_WORKER_THREAD */
+#define MM_WORKER_QUEUE_SIZE (1024)
+
+typedef struct ofonoext_mm_delta {
+    enum proxy_handler_id id;
+    guint epoch;
+    char* str;
+    char** strv;
+    gint index;
+    gboolean flag;
+    /* Getter replies, in the same queue to keep them in order */
+    struct ofonoext_mm_refresh_data* refresh;
+    GVariant* args;
+    GError* error;
+} OfonoExtModemManagerDelta;
+
+typedef struct ofonoext_mm_worker {
+    OfonoExtWorker* thread;
+    OfonoExtRing* queue;        /* Worker thread => default context */
+    GSource* source;            /* Applies the changes */
+    gint wakeup;                /* The source is (about to be) ready */
+    gint quit;
+    GMutex mutex;               /* Protects blocked */
+    GCond drained;              /* Signalled when blocked is cleared */
+    gboolean blocked;           /* The worker is waiting for free slots */
+    guint signal_id[PROXY_SIGNAL_COUNT]; /* Only used by the worker */
+} OfonoExtModemManagerWorker;
+
+typedef struct ofonoext_mm_worker_source {
+    GSource source;
+    OfonoExtModemManager* mm;
+} OfonoExtModemManagerWorkerSource;
+
+typedef struct ofonoext_mm_worker_signal {
+    OfonoExtModemManagerWorker* worker;
+    enum proxy_handler_id id;
+    guint epoch;
+} OfonoExtModemManagerWorkerSignal;
+
+typedef struct ofonoext_mm_worker_call {
+    OfonoExtModemManagerWorker* worker;
+    GDBusConnection* bus;
+    char* service;
+    char* path;
+    enum proxy_handler_id id;
+    guint epoch;
+    gboolean subscribe;
+} OfonoExtModemManagerWorkerCall;
+
+typedef struct ofonoext_mm_worker_refresh {
+    OfonoExtModemManagerWorker* worker;
+    GDBusConnection* bus;
+    char* service;
+    char* path;
+    GCancellable* cancel;
+    struct ofonoext_mm_refresh_data* refresh;
+    guint epoch;
+} OfonoExtModemManagerWorkerRefresh;
 
 enum ofonoext_mm_signal {
     SIGNAL_VALID_CHANGED,
@@ -98,9 +201,110 @@ enum ofonoext_mm_signal {
     SIGNAL_SIM_COUNT_CHANGED,
     SIGNAL_ACTIVE_SIM_COUNT_CHANGED,
     SIGNAL_READY_CHANGED,
+    SIGNAL_SLOTS_WARM,
     SIGNAL_COUNT
 };
 
+/* OFONOEXT_MM_CHANGED bits follow the signal order */
+G_STATIC_ASSERT(OFONOEXT_MM_CHANGED_VALID == (1 << SIGNAL_VALID_CHANGED));
+G_STATIC_ASSERT(OFONOEXT_MM_CHANGED_SLOTS_WARM == (1 << SIGNAL_SLOTS_WARM));
+G_STATIC_ASSERT(OFONOEXT_MM_CHANGED_ALL == (1 << SIGNAL_COUNT) - 1);
+
+/*
+ * IMSI stored in place. The packed form has the digits in the lower bits
+ * and the length in the top byte (so that leading zeros still count) and
+ * is zero for anything that isn't a valid IMSI. Strings which don't fit
+ * into the buffer can't be valid IMSIs but are still kept, on the heap.
+ */
+typedef struct ofonoext_mm_imsi {
+    guint64 key;
+    const char* str;            /* Points to buf, big or NULL */
+    char* big;
+    char buf[MM_IMSI_MAX_LEN + 1];
+} OfonoExtModemManagerImsi;
+
+/* Merged notifications, see ofonoext_mm_add_batch_handler() */
+typedef struct ofonoext_mm_batch {
+    OfonoExtModemManager* mm;
+    OFONOEXT_MM_CHANGED mask;
+    OFONOEXT_MM_CHANGED pending;
+    guint interval_ms;
+    gint64 last;                /* Last delivery, monotonic time */
+    guint source_id;
+    OfonoExtModemManagerBatchHandler fn;
+    void* data;
+} OfonoExtModemManagerBatch;
+
+/* Timeline of ofonoext_mm_new_from_scenario() */
+typedef struct ofonoext_mm_scenario_event {
+    guint time;
+    enum proxy_handler_id id;
+    GVariant* args;
+} OfonoExtModemManagerScenarioEvent;
+
+typedef struct ofonoext_mm_scenario {
+    OfonoExtScenario* data;
+    OfonoExtModemManagerScenarioEvent* events;
+    guint pos;
+    gint64 start;
+    guint timer_id;
+} OfonoExtModemManagerScenario;
+
+struct ofonoext_mm_priv {
+    OfonoExtModemManagerKey key;
+    char* service;
+    char* path;
+    GWeakRef ref;               /* For ofonoext_mm_create() */
+    GDBusConnection* bus;
+    OrgNemomobileOfonoModemManager* proxy;
+    guint proxy_signal_id[PROXY_SIGNAL_COUNT]; /* D-Bus subscriptions */
+    gboolean on_demand;
+    guint stale;                /* Bitmask of proxy_handler_id */
+    guint missed;               /* Dropped by the worker before GetAll */
+    GCancellable* refresh;
+    guint ofono_watch_id;
+    guint retry_timer_id;
+    int version;
+    GCancellable* cancel;
+    OfonoExtArena* arena;       /* Owns all the state strings below */
+    OfonoExtArena* changes;     /* Owns the ones replaced since then */
+    gsize garbage;              /* Bytes replaced since the last repack */
+    GStrV* available;
+    GStrV* enabled;
+    OfonoExtModemManagerImsi data_imsi;
+    OfonoExtModemManagerImsi voice_imsi;
+    OfonoExtModemManagerImsi mms_imsi;
+    gboolean* present_sims;
+    GStrV* imei;
+    GHashTable* path_index;     /* path => slot + 1 */
+    GHashTable* imei_index;     /* IMEI => slot + 1 */
+    GHashTable* imsi_index;     /* IMSI => slot + 1 */
+    OfonoExtModemManagerImsi* slot_imsi; /* Keys of imsi_index */
+    guint imsi_learn_id;        /* Learns from the default SIM pairs */
+    gboolean prefetch;
+    OfonoExtModemManagerSlot* slots;
+    guint nslots;
+    OfonoExtRecorder* recorder;
+    guint64 generation;
+    guint64 changed_gen[SIGNAL_COUNT];
+    OfonoExtPoll* poll;
+    guint64 poll_gen;           /* Generation of the last dispatch */
+    OfonoExtModemManagerWorker* worker;
+    guint epoch;                /* Incremented by unsubscribe_all() */
+    OfonoExtModemManagerScenario* scenario;
+    gboolean timing;
+    guint handler_budget;       /* Microseconds, zero means no budget */
+    GHashTable* handler_stats;  /* Keys are the values */
+    GPtrArray* batches;         /* OfonoExtModemManagerBatch */
+    OfonoExtModemManagerEvent* journal;
+    guint journal_size;
+    guint64 journal_first;      /* Sequence number of the first event */
+    OfonoExtModemManagerCounters counters;
+};
+
+typedef GObjectClass OfonoExtModemManagerClass;
+G_DEFINE_TYPE(OfonoExtModemManager, ofonoext_mm, G_TYPE_OBJECT)
+
 #define SIGNAL_VALID_CHANGED_NAME               "valid-changed"
 #define SIGNAL_ENABLED_MODEMS_CHANGED_NAME      "enabled-modems-changed"
 #define SIGNAL_DATA_IMSI_CHANGED_NAME           "data-imsi-changed"
@@ -113,9 +317,110 @@ enum ofonoext_mm_signal {
 #define SIGNAL_MMS_IMSI_CHANGED_NAME            "mms-imsi-changed"
 #define SIGNAL_MMS_MODEM_CHANGED_NAME           "mms-modem-changed"
 #define SIGNAL_READY_CHANGED_NAME               "ready-changed"
+#define SIGNAL_SLOTS_WARM_NAME                  "slots-warm"
 
 static guint ofonoext_mm_signals[SIGNAL_COUNT] = { 0 };
 
+/* Never emitted, batch handlers are connected to it to get an id */
+#define SIGNAL_BATCH_NAME                       "batch"
+static guint ofonoext_mm_batch_signal = 0;
+
+/* Output records are tagged with the signal ids */
+G_STATIC_ASSERT((int)SIGNAL_VALID_CHANGED ==
+    (int)OFONOEXT_RECORD_OUTPUT_VALID);
+G_STATIC_ASSERT((int)SIGNAL_READY_CHANGED ==
+    (int)OFONOEXT_RECORD_OUTPUT_READY);
+G_STATIC_ASSERT((int)SIGNAL_SLOTS_WARM ==
+    (int)OFONOEXT_RECORD_OUTPUT_SLOTS_WARM);
+
+/*
+ * D-Bus signals, the methods fetching the same values and the signals
+ * which need them. The GetAll methods only cover the properties which
+ * have been there since the first version of the interface.
+ */
+#define MM_SIGNAL_BIT(name) (1 << SIGNAL_##name##_CHANGED)
+
+static const struct ofonoext_mm_proxy_signal {
+    const char* signal;
+    const char* signal_type;
+    const char* getter;
+    const char* getter_type;
+    int version;
+    guint demand;
+} ofonoext_mm_proxy_signals[PROXY_SIGNAL_COUNT] = {
+    {
+        "EnabledModemsChanged", "(ao)",
+        "GetEnabledModems", "(ao)", 1,
+        MM_SIGNAL_BIT(ENABLED_MODEMS) | MM_SIGNAL_BIT(ACTIVE_SIM_COUNT)
+    },{
+        "DefaultDataSimChanged", "(s)",
+        "GetDefaultDataSim", "(s)", 1,
+        MM_SIGNAL_BIT(DATA_IMSI)
+    },{
+        "DefaultDataModemChanged", "(s)",
+        "GetDefaultDataModem", "(s)", 1,
+        MM_SIGNAL_BIT(DATA_MODEM)
+    },{
+        "DefaultVoiceSimChanged", "(s)",
+        "GetDefaultVoiceSim", "(s)", 1,
+        MM_SIGNAL_BIT(VOICE_IMSI)
+    },{
+        "DefaultVoiceModemChanged", "(s)",
+        "GetDefaultVoiceModem", "(s)", 1,
+        MM_SIGNAL_BIT(VOICE_MODEM)
+    },{
+        "PresentSimsChanged", "(ib)",
+        "GetPresentSims", "(ab)", 2,
+        MM_SIGNAL_BIT(PRESENT_SIMS) | MM_SIGNAL_BIT(SIM_COUNT) |
+        MM_SIGNAL_BIT(ACTIVE_SIM_COUNT)
+    },{
+        "MmsSimChanged", "(s)",
+        "GetMmsSim", "(s)", 4,
+        MM_SIGNAL_BIT(MMS_IMSI)
+    },{
+        "MmsModemChanged", "(s)",
+        "GetMmsModem", "(s)", 4,
+        MM_SIGNAL_BIT(MMS_MODEM)
+    },{
+        "ReadyChanged", "(b)",
+        "GetReady", "(b)", 5,
+        MM_SIGNAL_BIT(READY)
+    }
+};
+
+/* Signals which may affect the wait conditions */
+static const struct ofonoext_mm_wait_event {
+    OFONOEXT_MM_WAIT flag;
+    enum ofonoext_mm_signal sig;
+} ofonoext_mm_wait_events[] = {
+    { OFONOEXT_MM_WAIT_VALID, SIGNAL_VALID_CHANGED },
+    { OFONOEXT_MM_WAIT_READY, SIGNAL_READY_CHANGED },
+    { OFONOEXT_MM_WAIT_DATA_MODEM, SIGNAL_DATA_MODEM_CHANGED },
+    { OFONOEXT_MM_WAIT_VOICE_MODEM, SIGNAL_VOICE_MODEM_CHANGED },
+    { OFONOEXT_MM_WAIT_MMS_MODEM, SIGNAL_MMS_MODEM_CHANGED },
+    { OFONOEXT_MM_WAIT_DATA_IMSI, SIGNAL_DATA_IMSI_CHANGED },
+    { OFONOEXT_MM_WAIT_VOICE_IMSI, SIGNAL_VOICE_IMSI_CHANGED },
+    { OFONOEXT_MM_WAIT_MMS_IMSI, SIGNAL_MMS_IMSI_CHANGED },
+    { OFONOEXT_MM_WAIT_SIM_COUNT, SIGNAL_SIM_COUNT_CHANGED },
+    { OFONOEXT_MM_WAIT_ACTIVE_SIM_COUNT, SIGNAL_ACTIVE_SIM_COUNT_CHANGED },
+    { OFONOEXT_MM_WAIT_SLOTS_WARM, SIGNAL_SLOTS_WARM }
+};
+
+#define MM_WAIT_EVENT_COUNT G_N_ELEMENTS(ofonoext_mm_wait_events)
+
+/* Forced refresh of everything, completes when all replies are in */
+typedef struct ofonoext_mm_refresh_all {
+    GTask* task;
+    int pending;
+    GError* error;
+} OfonoExtModemManagerRefreshAll;
+
+typedef struct ofonoext_mm_refresh_data {
+    OfonoExtModemManager* mm;
+    enum proxy_handler_id id;
+    OfonoExtModemManagerRefreshAll* all;
+} OfonoExtModemManagerRefreshData;
+
 #define OFONOEXT_SIGNAL_NEW(NAME) \
     ofonoext_mm_signals[SIGNAL_##NAME##_CHANGED] = \
         g_signal_new(SIGNAL_##NAME##_CHANGED_NAME, \
@@ -128,8 +433,32 @@ void
 ofonoext_mm_schedule_retry(
     OfonoExtModemManager* self);
 
-/* Weak reference to the single instance of OfonoExtModemManager */
-static OfonoExtModemManager* ofonoext_mm_instance = NULL;
+static
+gboolean
+ofonoext_mm_scenario_step(
+    gpointer data);
+
+static
+void
+ofonoext_mm_refresh_complete(
+    OfonoExtModemManagerRefreshData* refresh,
+    GVariant* args,
+    GError* error,
+    gboolean current);
+
+static
+void
+ofonoext_mm_get_all(
+    OfonoExtModemManager* self);
+
+/*
+ * OfonoExtModemManager instances by key. The table is protected by
+ * ofonoext_mm_mutex, the instances remove themselves from it on dispose.
+ * The default instance can also be picked up without taking the lock.
+ */
+static GHashTable* ofonoext_mm_table = NULL;
+static GMutex ofonoext_mm_mutex;
+static GWeakRef ofonoext_mm_default;
 
 /* Async call context */
 typedef struct ofonoext_mm_set_mms_sim_call {
@@ -138,19 +467,71 @@ typedef struct ofonoext_mm_set_mms_sim_call {
     void* arg;
 } OfonoExtModemManagerSetMmsSimCall;
 
+typedef struct ofonoext_mm_wait_call {
+    OfonoExtCall common;
+    OFONOEXT_MM_WAIT mask;
+    guint count;
+    OfonoExtModemManagerWaitHandler fn;
+    void* arg;
+    gulong event_id[MM_WAIT_EVENT_COUNT];
+    gulong cancel_id;
+    GMainContext* context;      /* Thread-default context of the caller */
+    GSource* timeout;
+    GSource* idle;
+    gboolean satisfied;
+    gboolean report_cancel;
+} OfonoExtModemManagerWaitCall;
+
+typedef struct ofonoext_mm_wait_sync {
+    gboolean done;
+    gboolean ok;
+} OfonoExtModemManagerWaitSync;
+
+/* Closure data of a timed handler */
+typedef struct ofonoext_mm_timed_handler {
+    OfonoExtModemManagerHandlerStats* stats;
+    void* data;
+} OfonoExtModemManagerTimedHandler;
+
 /*==========================================================================*
  * Implementation
  *==========================================================================*/
 
+static
+guint
+ofonoext_mm_key_hash(
+    gconstpointer data)
+{
+    const OfonoExtModemManagerKey* key = data;
+
+    return ((g_direct_hash(key->bus) * 31 + g_str_hash(key->service)) * 31 +
+        g_str_hash(key->path)) * 31 + key->flags;
+}
+
+static
+gboolean
+ofonoext_mm_key_equal(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const OfonoExtModemManagerKey* k1 = a;
+    const OfonoExtModemManagerKey* k2 = b;
+
+    return k1->bus == k2->bus && k1->flags == k2->flags &&
+        !strcmp(k1->service, k2->service) &&
+        !strcmp(k1->path, k2->path);
+}
+
 static
 void
-ofonoext_mm_destroyed(
-    gpointer arg,
-    GObject* object)
+ofonoext_mm_count_error(
+    OfonoExtModemManager* self,
+    const GError* error)
 {
-    GASSERT(object == (GObject*)ofonoext_mm_instance);
-    ofonoext_mm_instance = NULL;
-    GVERBOSE_("%p", object);
+    /* Cancellation is our own doing */
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        self->priv->counters.call_errors++;
+    }
 }
 
 static
@@ -166,6 +547,8 @@ ofonoext_mm_set_mms_sim_done(
     if (!org_nemomobile_ofono_modem_manager_call_set_mms_sim_finish(
         ORG_NEMOMOBILE_OFONO_MODEM_MANAGER(proxy), &path, result, &error)) {
         GERR("%s", GERRMSG(error));
+        ofonoext_mm_count_error(OFONOEXT_MODEM_MANAGER(call->common.owner),
+            error);
     }
     if (call->fn && !g_cancellable_is_cancelled(call->common.cancel)) {
         OfonoExtModemManager* mm = OFONOEXT_MODEM_MANAGER(call->common.owner);
@@ -179,891 +562,3987 @@ ofonoext_mm_set_mms_sim_done(
     g_free(path);
 }
 
+/*
+ * GLib only wakes up the thread which owns the context when a source
+ * is attached. Between ofonoext_mm_dispatch() calls nobody owns it, so
+ * the foreign loop has to be told to re-arm its timer. Thread safe.
+ */
 static
-void
-ofonoext_mm_set_valid(
+guint
+ofonoext_mm_attach(
     OfonoExtModemManager* self,
-    gboolean valid)
+    GSource* source,
+    GMainContext* context,
+    GSourceFunc fn,
+    gpointer data)
 {
-    if (self->valid != valid) {
-        self->valid = valid;
-        g_signal_emit(self, ofonoext_mm_signals[SIGNAL_VALID_CHANGED], 0);
+    OfonoExtModemManagerPriv* priv = self->priv;
+    guint id;
+
+    g_source_set_callback(source, fn, data, NULL);
+    id = g_source_attach(source, context);
+    if (priv->poll) {
+        ofonoext_poll_notify(priv->poll);
     }
+    return id;
 }
 
 static
-gboolean
-ofonoext_mm_is_timeout(
-    const GError* error)
+guint
+ofonoext_mm_add_idle(
+    OfonoExtModemManager* self,
+    GSourceFunc fn,
+    gpointer data)
 {
-    if (error) {
-        if (error->domain == G_IO_ERROR) {
-            switch (error->code) {
-            case G_IO_ERROR_TIMED_OUT:
-                return TRUE;
-            default:
-                return FALSE;
-            }
-        } else if (error->domain == G_DBUS_ERROR) {
-            switch (error->code) {
-            case G_DBUS_ERROR_TIMEOUT:
-            case G_DBUS_ERROR_TIMED_OUT:
-                return TRUE;
-            default:
-                return FALSE;
-            }
-        }
-    }
-    return FALSE;
+    GSource* source = g_idle_source_new();
+    const guint id = ofonoext_mm_attach(self, source, NULL, fn, data);
+
+    g_source_unref(source);
+    return id;
 }
 
 static
-void
-ofonoext_mm_cancel_retry(
-    OfonoExtModemManager* self)
+guint
+ofonoext_mm_add_timeout(
+    OfonoExtModemManager* self,
+    guint ms,
+    GSourceFunc fn,
+    gpointer data)
 {
-    OfonoExtModemManagerPriv* priv = self->priv;
-    if (priv->retry_timer_id) {
-        g_source_remove(priv->retry_timer_id);
-        priv->retry_timer_id = 0;
-        GDEBUG("Retry cancelled");
-    }
+    GSource* source = g_timeout_source_new(ms);
+    const guint id = ofonoext_mm_attach(self, source, NULL, fn, data);
+
+    g_source_unref(source);
+    return id;
 }
 
 static
-void
-ofonoext_mm_reset(
-    OfonoExtModemManager* self)
+gboolean
+ofonoext_mm_batch_deliver(
+    gpointer data)
 {
-    OfonoExtModemManagerPriv* priv = self->priv;
-    ofonoext_mm_cancel_retry(self);
-    if (priv->proxy) {
-        gutil_disconnect_handlers(priv->proxy, priv->proxy_signal_id,
-            G_N_ELEMENTS(priv->proxy_signal_id));
-        g_object_unref(priv->proxy);
-        priv->proxy = NULL;
-    }
-    if (self->available) {
-        g_strfreev(priv->available);
-        self->available = priv->available = NULL;
-    }
-    if (self->enabled) {
-        g_strfreev(priv->enabled);
-        self->enabled = priv->enabled = NULL;
-    }
-    if (self->data_imsi) {
-        g_free(priv->data_imsi);
-        self->data_imsi = priv->data_imsi = NULL;
-    }
-    if (self->voice_imsi) {
-        g_free(priv->voice_imsi);
-        self->voice_imsi = priv->voice_imsi = NULL;
-    }
-    if (self->mms_imsi) {
-        g_free(priv->mms_imsi);
-        self->mms_imsi = priv->mms_imsi = NULL;
-    }
-    if (self->data_modem) {
-        ofono_modem_unref(self->data_modem);
-        self->data_modem = NULL;
-    }
-    if (self->voice_modem) {
-        ofono_modem_unref(self->voice_modem);
-        self->voice_modem = NULL;
-    }
-    if (self->present_sims) {
-        g_free(priv->present_sims);
-        self->present_sims = priv->present_sims = NULL;
-    }
-    if (self->mms_modem) {
-        ofono_modem_unref(self->mms_modem);
-        self->mms_modem = NULL;
-    }
-    if (self->imei) {
-        g_strfreev(priv->imei);
-        self->imei = priv->imei = NULL;
-    }
+    OfonoExtModemManagerBatch* batch = data;
+    OfonoExtModemManager* self = batch->mm;
+    const OFONOEXT_MM_CHANGED changed = batch->pending;
+
+    batch->source_id = 0;
+    batch->pending = OFONOEXT_MM_CHANGED_NONE;
+    batch->last = g_get_monotonic_time();
+
+    /* The handler may remove itself, don't touch the batch afterwards */
+    ofonoext_mm_ref(self);
+    batch->fn(self, changed, batch->data);
+    ofonoext_mm_unref(self);
+    return G_SOURCE_REMOVE;
 }
 
 static
 void
-ofonoext_mm_update_sim_counts(
+ofonoext_mm_batch_notify(
     OfonoExtModemManager* self,
-    gboolean emit_signals)
+    enum ofonoext_mm_signal sig)
 {
+    GPtrArray* batches = self->priv->batches;
+    const OFONOEXT_MM_CHANGED bit = (1 << sig);
     guint i;
-    OfonoExtModemManagerPriv* priv = self->priv;
-    const guint old_sim_count = self->sim_count;
-    const guint old_active_sim_count = self->active_sim_count;
 
-    self->sim_count = 0;
-    self->active_sim_count = 0;
-    for (i=0; i<self->modem_count; i++) {
-        if (priv->present_sims[i]) {
-            self->sim_count++;
-            if (ofonoext_mm_modem_enabled_at(self, i)) {
-                self->active_sim_count++;
+    for (i=0; i<batches->len; i++) {
+        OfonoExtModemManagerBatch* batch = batches->pdata[i];
+
+        if (batch->mask & bit) {
+            batch->pending |= bit;
+            if (!batch->source_id) {
+                const gint64 due = batch->last +
+                    (gint64)batch->interval_ms * 1000;
+                const gint64 now = g_get_monotonic_time();
+
+                /* Everything emitted before the source fires is merged */
+                batch->source_id = (due > now) ?
+                    ofonoext_mm_add_timeout(self,
+                        (guint)((due - now + 999) / 1000),
+                        ofonoext_mm_batch_deliver, batch) :
+                    ofonoext_mm_add_idle(self, ofonoext_mm_batch_deliver,
+                        batch);
             }
         }
     }
+}
 
-    if (emit_signals) {
-        if (old_sim_count != self->sim_count) {
-            g_signal_emit(self, ofonoext_mm_signals[
-                SIGNAL_SIM_COUNT_CHANGED], 0);
-        }
-        if (old_active_sim_count != self->active_sim_count) {
-            g_signal_emit(self, ofonoext_mm_signals[
-                SIGNAL_ACTIVE_SIM_COUNT_CHANGED], 0);
+static
+OFONOEXT_MM_CHANGED
+ofonoext_mm_batch_mask(
+    OfonoExtModemManager* self)
+{
+    GPtrArray* batches = self->priv->batches;
+    OFONOEXT_MM_CHANGED mask = OFONOEXT_MM_CHANGED_NONE;
+
+    if (batches) {
+        guint i;
+
+        for (i=0; i<batches->len; i++) {
+            mask |= ((OfonoExtModemManagerBatch*)batches->pdata[i])->mask;
         }
     }
+    return mask;
 }
 
 static
 void
-ofonoext_mm_enabled_modems_changed(
-    OrgNemomobileOfonoModemManager* proxy,
-    char** modems,
-    gpointer data)
+ofonoext_mm_batch_nop(
+    OfonoExtModemManager* self,
+    void* data)
 {
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
-    OfonoExtModemManagerPriv* priv = self->priv;
-    g_strfreev(priv->enabled);
-    self->enabled = priv->enabled = g_strdupv(modems);
-    ofonoext_mm_update_sim_counts(self, TRUE);
-    g_signal_emit(self, ofonoext_mm_signals[SIGNAL_ENABLED_MODEMS_CHANGED], 0);
 }
 
+/* Closure notify, invoked when the handler is removed */
 static
 void
-ofonoext_mm_default_data_sim_changed(
-    OrgNemomobileOfonoModemManager* proxy,
-    const char* imsi,
-    gpointer data)
+ofonoext_mm_batch_free(
+    gpointer data,
+    GClosure* closure)
 {
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
-    OfonoExtModemManagerPriv* priv = self->priv;
-    g_free(priv->data_imsi);
-    self->data_imsi = priv->data_imsi = g_strdup(imsi);
-    g_signal_emit(self, ofonoext_mm_signals[
-        SIGNAL_DATA_IMSI_CHANGED], 0);
+    OfonoExtModemManagerBatch* batch = data;
+
+    if (batch->source_id) {
+        g_source_remove(batch->source_id);
+    }
+    g_ptr_array_remove_fast(batch->mm->priv->batches, batch);
+    g_slice_free(OfonoExtModemManagerBatch, batch);
 }
 
 static
-void
-ofonoext_mm_default_data_modem_changed(
-    OrgNemomobileOfonoModemManager* proxy,
-    const char* path,
-    gpointer data)
+const char*
+ofonoext_mm_journal_path(
+    OfonoModem* modem)
 {
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
-    ofono_modem_unref(self->data_modem);
-    self->data_modem = (path && path[0]) ? ofono_modem_new(path) : NULL;
-    g_signal_emit(self, ofonoext_mm_signals[
-        SIGNAL_DATA_MODEM_CHANGED], 0);
+    return modem ? g_intern_string(modem->object.path) : NULL;
 }
 
 static
-void
-ofonoext_mm_default_voice_sim_changed(
-    OrgNemomobileOfonoModemManager* proxy,
-    const char* imsi,
-    gpointer data)
+guint
+ofonoext_mm_journal_slots(
+    OfonoExtModemManager* self,
+    gboolean enabled)
 {
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
-    OfonoExtModemManagerPriv* priv = self->priv;
-    g_free(priv->voice_imsi);
-    self->voice_imsi = priv->voice_imsi = g_strdup(imsi);
-    g_signal_emit(self, ofonoext_mm_signals[
-        SIGNAL_VOICE_IMSI_CHANGED], 0);
+    const guint n = MIN(self->modem_count, 32);
+    guint i, mask = 0;
+
+    for (i=0; i<n; i++) {
+        if (enabled ? ofonoext_mm_modem_enabled_at(self, i) :
+            (self->present_sims && self->present_sims[i])) {
+            mask |= (1u << i);
+        }
+    }
+    return mask;
 }
 
 static
 void
-ofonoext_mm_default_voice_modem_changed(
-    OrgNemomobileOfonoModemManager* proxy,
-    const char* path,
-    gpointer data)
+ofonoext_mm_journal_add(
+    OfonoExtModemManager* self,
+    enum ofonoext_mm_signal sig)
 {
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
-    ofono_modem_unref(self->voice_modem);
-    self->voice_modem = (path && path[0]) ? ofono_modem_new(path) : NULL;
-    g_signal_emit(self, ofonoext_mm_signals[
-        SIGNAL_VOICE_MODEM_CHANGED], 0);
+    OfonoExtModemManagerPriv* priv = self->priv;
+    OfonoExtModemManagerEvent* event = priv->journal +
+        (priv->generation - priv->journal_first) % priv->journal_size;
+
+    /* Strings are interned, the set of IMSIs and paths is small */
+    memset(event, 0, sizeof(*event));
+    event->seq = priv->generation;
+    event->time = g_get_monotonic_time();
+    event->change = (1 << sig);
+    switch (sig) {
+    case SIGNAL_VALID_CHANGED:
+        event->value = self->valid;
+        break;
+    case SIGNAL_ENABLED_MODEMS_CHANGED:
+        event->value = ofonoext_mm_journal_slots(self, TRUE);
+        break;
+    case SIGNAL_DATA_IMSI_CHANGED:
+        event->str = g_intern_string(self->data_imsi);
+        break;
+    case SIGNAL_DATA_MODEM_CHANGED:
+        event->str = ofonoext_mm_journal_path(self->data_modem);
+        break;
+    case SIGNAL_VOICE_IMSI_CHANGED:
+        event->str = g_intern_string(self->voice_imsi);
+        break;
+    case SIGNAL_VOICE_MODEM_CHANGED:
+        event->str = ofonoext_mm_journal_path(self->voice_modem);
+        break;
+    case SIGNAL_MMS_IMSI_CHANGED:
+        event->str = g_intern_string(self->mms_imsi);
+        break;
+    case SIGNAL_MMS_MODEM_CHANGED:
+        event->str = ofonoext_mm_journal_path(self->mms_modem);
+        break;
+    case SIGNAL_PRESENT_SIMS_CHANGED:
+        event->value = ofonoext_mm_journal_slots(self, FALSE);
+        break;
+    case SIGNAL_SIM_COUNT_CHANGED:
+        event->value = self->sim_count;
+        break;
+    case SIGNAL_ACTIVE_SIM_COUNT_CHANGED:
+        event->value = self->active_sim_count;
+        break;
+    case SIGNAL_READY_CHANGED:
+        event->value = self->ready;
+        break;
+    case SIGNAL_SLOTS_WARM:
+        event->value = self->slots_warm;
+        break;
+    case SIGNAL_COUNT:
+        break;
+    }
 }
 
 static
 void
-ofonoext_mm_present_sims_changed(
-    OrgNemomobileOfonoModemManager* proxy,
-    int index,
-    gboolean present,
-    gpointer data)
+ofonoext_mm_emit(
+    OfonoExtModemManager* self,
+    enum ofonoext_mm_signal sig)
 {
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
     OfonoExtModemManagerPriv* priv = self->priv;
-    GASSERT(index >= 0 && index < self->modem_count);
-    if (index >= 0 && index < self->modem_count) {
-        priv->present_sims[index] = (present != FALSE);
-        g_signal_emit(self, ofonoext_mm_signals[
-            SIGNAL_PRESENT_SIMS_CHANGED], 0);
-        ofonoext_mm_update_sim_counts(self, TRUE);
+    OfonoExtRecorder* recorder = priv->recorder;
+
+    /* Handlers see the new generation */
+    priv->changed_gen[sig] = ++priv->generation;
+    if (priv->journal) {
+        ofonoext_mm_journal_add(self, sig);
+    }
+    if (priv->poll) {
+        ofonoext_poll_notify(priv->poll);
     }
+    if (G_UNLIKELY(recorder)) {
+        ofonoext_recorder_write(recorder, OFONOEXT_RECORD_OUTPUT, sig,
+            NULL, 0);
+    }
+    if (priv->batches && priv->batches->len) {
+        ofonoext_mm_batch_notify(self, sig);
+    }
+    g_signal_emit(self, ofonoext_mm_signals[sig], 0);
 }
 
 static
 void
-ofonoext_mm_mms_sim_changed(
-    OrgNemomobileOfonoModemManager* proxy,
-    const char* imsi,
-    gpointer data)
+ofonoext_mm_record(
+    OfonoExtModemManager* self,
+    OFONOEXT_RECORD_INPUT code,
+    const void* data,
+    gsize len)
 {
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
-    OfonoExtModemManagerPriv* priv = self->priv;
-    g_free(priv->mms_imsi);
-    self->mms_imsi = priv->mms_imsi = g_strdup(imsi);
-    g_signal_emit(self, ofonoext_mm_signals[SIGNAL_MMS_IMSI_CHANGED], 0);
+    OfonoExtRecorder* recorder = self->priv->recorder;
+
+    if (G_UNLIKELY(recorder)) {
+        ofonoext_recorder_write(recorder, OFONOEXT_RECORD_INPUT, code,
+            data, len);
+    }
 }
 
 static
 void
-ofonoext_mm_mms_modem_changed(
-    OrgNemomobileOfonoModemManager* proxy,
-    const char* path,
-    gpointer data)
+ofonoext_mm_record_string(
+    OfonoExtModemManager* self,
+    OFONOEXT_RECORD_INPUT code,
+    const char* str)
 {
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
-    ofono_modem_unref(self->mms_modem);
-    self->mms_modem = (path && path[0]) ? ofono_modem_new(path) : NULL;
-    g_signal_emit(self, ofonoext_mm_signals[SIGNAL_MMS_MODEM_CHANGED], 0);
+    if (G_UNLIKELY(self->priv->recorder)) {
+        ofonoext_mm_record(self, code, str, str ? strlen(str) : 0);
+    }
 }
 
 static
 void
-ofonoext_mm_ready_changed(
-    OrgNemomobileOfonoModemManager* proxy,
-    gboolean ready,
-    gpointer data)
+ofonoext_mm_record_strv(
+    OfonoExtModemManager* self,
+    OFONOEXT_RECORD_INPUT code,
+    const GStrV* strv)
 {
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
-    self->ready = ready;
-    g_signal_emit(self, ofonoext_mm_signals[SIGNAL_READY_CHANGED], 0);
+    OfonoExtRecorder* recorder = self->priv->recorder;
+
+    if (G_UNLIKELY(recorder)) {
+        ofonoext_recorder_write_strv(recorder, OFONOEXT_RECORD_INPUT, code,
+            strv);
+    }
 }
 
 static
 void
-ofonoext_mm_init_done(
+ofonoext_mm_record_present_sim(
     OfonoExtModemManager* self,
-    GStrV* available,
-    GStrV* enabled,
-    char* data_imsi,
-    char* voice_imsi,
-    const char* data_path,
-    const char* voice_path,
-    GVariant* present_sims,
-    GStrV* imei,
-    char* mms_imsi,
-    const char* mms_path,
-    gboolean ready)
+    int index,
+    gboolean present)
 {
-    OfonoExtModemManagerPriv* priv = self->priv;
-    OfonoModem* voice_modem;
-    OfonoModem* data_modem;
-    OfonoModem* mms_modem;
-
-    g_strfreev(priv->available);
-    g_strfreev(priv->enabled);
-    g_strfreev(priv->imei);
-    g_free(priv->data_imsi);
-    g_free(priv->voice_imsi);
-    g_free(priv->mms_imsi);
-
-    self->available = priv->available = available;
-    self->enabled = priv->enabled = enabled;
-    self->imei = priv->imei = imei;
-    self->data_imsi = priv->data_imsi = data_imsi;
-    self->voice_imsi = priv->voice_imsi = voice_imsi;
-    self->mms_imsi = priv->mms_imsi = mms_imsi;
-    self->modem_count = gutil_strv_length(available);
-    self->ready = ready;
-
-    /* The modem could be the same, so unref the current one after selecting
-     * the new one, to avoid unnecessary deallocations */
-    voice_modem = self->voice_modem;
-    self->voice_modem = (voice_path && voice_path[0]) ?
-        ofono_modem_new(voice_path) : NULL;
-
-    data_modem = self->data_modem;
-    self->data_modem = (data_path && data_path[0]) ?
-        ofono_modem_new(data_path) : NULL;
-
-    mms_modem = self->mms_modem;
-    self->mms_modem = (mms_path && mms_path[0]) ?
-        ofono_modem_new(mms_path) : NULL;
+    if (G_UNLIKELY(self->priv->recorder)) {
+        const gint32 i = index;
+        guint8 buf[sizeof(i) + 1];
 
-    ofono_modem_unref(voice_modem);
-    ofono_modem_unref(data_modem);
-    ofono_modem_unref(mms_modem);
+        memcpy(buf, &i, sizeof(i));
+        buf[sizeof(i)] = (present != FALSE);
+        ofonoext_mm_record(self, OFONOEXT_RECORD_INPUT_PRESENT_SIMS,
+            buf, sizeof(buf));
+    }
+}
 
-    if (present_sims) {
-        guint i;
-        GASSERT(self->modem_count == g_variant_n_children(present_sims));
-        g_free(priv->present_sims);
-        priv->present_sims = g_new0(gboolean, self->modem_count);
-        self->present_sims = priv->present_sims;
-        for (i=0; i<self->modem_count; i++) {
-            GVariant* v = g_variant_get_child_value(present_sims, i);
-            priv->present_sims[i] = g_variant_get_boolean(v);
-            g_variant_unref(v);
-        }
-    }
-
-    /* Subscribe for notifications */
-    priv->proxy_signal_id[PROXY_SIGNAL_ENABLED_MODEMS_CHANGED] =
-        g_signal_connect(priv->proxy, "enabled-modems-changed",
-            G_CALLBACK(ofonoext_mm_enabled_modems_changed), self);
-    priv->proxy_signal_id[PROXY_SIGNAL_DATA_IMSI_CHANGED] =
-        g_signal_connect(priv->proxy, "default-data-sim-changed",
-            G_CALLBACK(ofonoext_mm_default_data_sim_changed), self);
-    priv->proxy_signal_id[PROXY_SIGNAL_DATA_MODEM_CHANGED] =
-        g_signal_connect(priv->proxy, "default-data-modem-changed",
-            G_CALLBACK(ofonoext_mm_default_data_modem_changed), self);
-    priv->proxy_signal_id[PROXY_SIGNAL_VOICE_IMSI_CHANGED] =
-        g_signal_connect(priv->proxy, "default-voice-sim-changed",
-            G_CALLBACK(ofonoext_mm_default_voice_sim_changed), self);
-    priv->proxy_signal_id[PROXY_SIGNAL_VOICE_MODEM_CHANGED] =
-        g_signal_connect(priv->proxy, "default-voice-modem-changed",
-            G_CALLBACK(ofonoext_mm_default_voice_modem_changed), self);
-    priv->proxy_signal_id[PROXY_SIGNAL_PRESENT_SIMS_CHANGED] =
-        g_signal_connect(priv->proxy, "present-sims-changed",
-            G_CALLBACK(ofonoext_mm_present_sims_changed), self);
-    priv->proxy_signal_id[PROXY_SIGNAL_MMS_IMSI_CHANGED] =
-        g_signal_connect(priv->proxy, "mms-sim-changed",
-            G_CALLBACK(ofonoext_mm_mms_sim_changed), self);
-    priv->proxy_signal_id[PROXY_SIGNAL_MMS_MODEM_CHANGED] =
-        g_signal_connect(priv->proxy, "mms-modem-changed",
-            G_CALLBACK(ofonoext_mm_mms_modem_changed), self);
-    priv->proxy_signal_id[PROXY_SIGNAL_READY_CHANGED] =
-        g_signal_connect(priv->proxy, "ready-changed",
-            G_CALLBACK(ofonoext_mm_ready_changed), self);
+static
+void
+ofonoext_mm_record_ready(
+    OfonoExtModemManager* self,
+    gboolean ready)
+{
+    if (G_UNLIKELY(self->priv->recorder)) {
+        const guint8 b = (ready != FALSE);
 
-    ofonoext_mm_update_sim_counts(self, FALSE);
-    ofonoext_mm_set_valid(self, TRUE);
+        ofonoext_mm_record(self, OFONOEXT_RECORD_INPUT_READY, &b, 1);
+    }
 }
 
 static
 void
-ofonoext_mm_get_all_finish(
-    GObject* proxy,
-    GAsyncResult* result,
-    gpointer data,
-    gboolean (*finish_call)(
-        OrgNemomobileOfonoModemManager* proxy,
-        gint* version,
-        gchar*** available,
-        gchar*** enabled,
-        gchar** data_imsi,
-        gchar** voice_imsi,
-        gchar** data_modem,
-        gchar** voice_modem,
-        GVariant** present_sims,
-        gchar*** imei,
-        gchar** mms_imsi,
-        gchar** mms_modem,
-        gboolean* ready,
-        GAsyncResult* res,
-        GError **error))
+ofonoext_mm_record_state(
+    OfonoExtModemManager* self)
 {
-    GError* error = NULL;
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
     OfonoExtModemManagerPriv* priv = self->priv;
-    int version = 0;
-    char** available = NULL;
-    char** enabled = NULL;
-    char* data_imsi = NULL;
-    char* voice_imsi = NULL;
-    char* mms_imsi = NULL;
-    char* data_path = NULL;
-    char* voice_path = NULL;
-    char* mms_path = NULL;
-    GVariant* present_sims = NULL;
-    char** imei = NULL;
-    gboolean ready = TRUE;
 
-    GASSERT(!self->valid);
-    GASSERT(priv->cancel);
-    g_object_unref(priv->cancel);
-    priv->cancel = NULL;
-    if (finish_call(ORG_NEMOMOBILE_OFONO_MODEM_MANAGER(proxy), &version,
-        &available, &enabled, &data_imsi, &voice_imsi, &data_path,
-        &voice_path, &present_sims, &imei, &mms_imsi, &mms_path, &ready,
-        result, &error)) {
-        /* This call is only made for interface versions 2 and later */
-        GASSERT(version > 1);
-        /* ofonoext_mm_init_done takes ownership of all the pointers except
-         * data_path, voice_path, mms_path and present_sims */
-        ofonoext_mm_init_done(self, available, enabled, data_imsi, voice_imsi,
-            data_path, voice_path, present_sims, imei, mms_imsi, mms_path,
-            ready);
-    } else {
-        g_strfreev(available);
-        g_strfreev(enabled);
-        g_free(data_imsi);
-        g_free(voice_imsi);
-        g_strfreev(imei);
-#if GUTIL_LOG_ERR
-        if (error->code == G_IO_ERROR_CANCELLED) {
-            GDEBUG("%s", GERRMSG(error));
-        } else {
-            GERR("%s", GERRMSG(error));
-        }
-#endif
-        /* Retry the call */
-        if (ofonoext_mm_is_timeout(error)) {
-            ofonoext_mm_schedule_retry(self);
+    if (G_UNLIKELY(priv->recorder)) {
+        const gint32 version = priv->version;
+        guint i;
+
+        ofonoext_mm_record(self, OFONOEXT_RECORD_INPUT_STATE,
+            &version, sizeof(version));
+        ofonoext_mm_record_strv(self, OFONOEXT_RECORD_INPUT_AVAILABLE_MODEMS,
+            priv->available);
+        ofonoext_mm_record_strv(self, OFONOEXT_RECORD_INPUT_ENABLED_MODEMS,
+            priv->enabled);
+        ofonoext_mm_record_strv(self, OFONOEXT_RECORD_INPUT_IMEI,
+            priv->imei);
+        ofonoext_mm_record_string(self, OFONOEXT_RECORD_INPUT_DATA_IMSI,
+            self->data_imsi);
+        ofonoext_mm_record_string(self, OFONOEXT_RECORD_INPUT_DATA_MODEM,
+            self->data_modem ? ofono_modem_path(self->data_modem) : NULL);
+        ofonoext_mm_record_string(self, OFONOEXT_RECORD_INPUT_VOICE_IMSI,
+            self->voice_imsi);
+        ofonoext_mm_record_string(self, OFONOEXT_RECORD_INPUT_VOICE_MODEM,
+            self->voice_modem ? ofono_modem_path(self->voice_modem) : NULL);
+        ofonoext_mm_record_string(self, OFONOEXT_RECORD_INPUT_MMS_IMSI,
+            self->mms_imsi);
+        ofonoext_mm_record_string(self, OFONOEXT_RECORD_INPUT_MMS_MODEM,
+            self->mms_modem ? ofono_modem_path(self->mms_modem) : NULL);
+        if (priv->present_sims) {
+            for (i=0; i<self->modem_count; i++) {
+                ofonoext_mm_record_present_sim(self, i,
+                    priv->present_sims[i]);
+            }
         }
+        ofonoext_mm_record_ready(self, self->ready);
     }
-    g_free(data_path);
-    g_free(voice_path);
-    g_free(mms_path);
-    ofonoext_mm_unref(self);
-    if (present_sims) g_variant_unref(present_sims);
-    if (error) g_error_free(error);
 }
 
 static
 void
-ofonoext_mm_get_all5_done(
-    GObject* proxy,
-    GAsyncResult* res,
-    gpointer data)
+ofonoext_mm_set_valid(
+    OfonoExtModemManager* self,
+    gboolean valid)
 {
-    ofonoext_mm_get_all_finish(proxy, res, data,
-        org_nemomobile_ofono_modem_manager_call_get_all5_finish);
+    if (self->valid != valid) {
+        self->valid = valid;
+        ofonoext_mm_emit(self, SIGNAL_VALID_CHANGED);
+    }
 }
 
 static
 gboolean
-ofonoext_mm_get_all4_finish(
-    OrgNemomobileOfonoModemManager* proxy,
-    gint* version,
-    gchar*** available,
-    gchar*** enabled,
-    gchar** data_imsi,
-    gchar** voice_imsi,
-    gchar** data_path,
-    gchar** voice_path,
-    GVariant** present_sims,
-    gchar*** imei,
-    gchar** mms_imsi,
-    gchar** mms_path,
-    gboolean* ready,
-    GAsyncResult* res,
-    GError **error)
+ofonoext_mm_is_timeout(
+    const GError* error)
 {
-    *ready = TRUE;
-    return org_nemomobile_ofono_modem_manager_call_get_all4_finish(proxy,
-        version, available, enabled, data_imsi, voice_imsi, data_path,
-        voice_path, present_sims, imei, mms_imsi, mms_path, res, error);
+    if (error) {
+        if (error->domain == G_IO_ERROR) {
+            switch (error->code) {
+            case G_IO_ERROR_TIMED_OUT:
+                return TRUE;
+            default:
+                return FALSE;
+            }
+        } else if (error->domain == G_DBUS_ERROR) {
+            switch (error->code) {
+            case G_DBUS_ERROR_TIMEOUT:
+            case G_DBUS_ERROR_TIMED_OUT:
+                return TRUE;
+            default:
+                return FALSE;
+            }
+        }
+    }
+    return FALSE;
 }
 
 static
 void
-ofonoext_mm_get_all4_done(
-    GObject* proxy,
-    GAsyncResult* res,
-    gpointer data)
+ofonoext_mm_cancel_retry(
+    OfonoExtModemManager* self)
 {
-    ofonoext_mm_get_all_finish(proxy, res, data, ofonoext_mm_get_all4_finish);
+    OfonoExtModemManagerPriv* priv = self->priv;
+    if (priv->retry_timer_id) {
+        g_source_remove(priv->retry_timer_id);
+        priv->retry_timer_id = 0;
+        GDEBUG("Retry cancelled");
+    }
 }
 
 static
-gboolean
-ofonoext_mm_get_all3_finish(
-    OrgNemomobileOfonoModemManager* proxy,
-    gint* version,
-    gchar*** available,
-    gchar*** enabled,
-    gchar** data_imsi,
-    gchar** voice_imsi,
-    gchar** data_path,
-    gchar** voice_path,
-    GVariant** present_sims,
-    gchar*** imei,
-    gchar** mms_imsi,
-    gchar** mms_path,
-    gboolean* ready,
-    GAsyncResult* res,
-    GError **error)
+guint64
+ofonoext_mm_imsi_pack(
+    const char* str)
 {
-    *mms_imsi = NULL;
-    *mms_path = NULL;
-    *ready = TRUE;
-    return org_nemomobile_ofono_modem_manager_call_get_all3_finish(proxy,
-        version, available, enabled, data_imsi, voice_imsi, data_path,
-        voice_path, present_sims, imei, res, error);
+    guint64 key = 0;
+
+    if (str) {
+        guint len;
+
+        for (len = 0; str[len]; len++) {
+            if (len == MM_IMSI_MAX_LEN || !g_ascii_isdigit(str[len])) {
+                return 0;
+            }
+            key = key * 10 + (str[len] - '0');
+        }
+        if (len) {
+            key |= ((guint64)len) << 56;
+        }
+    }
+    return key;
 }
 
+/* Initializes a temporary lookup key, doesn't copy the string */
 static
 void
-ofonoext_mm_get_all3_done(
-    GObject* proxy,
-    GAsyncResult* res,
-    gpointer data)
+ofonoext_mm_imsi_wrap(
+    OfonoExtModemManagerImsi* imsi,
+    const char* str)
 {
-    ofonoext_mm_get_all_finish(proxy, res, data, ofonoext_mm_get_all3_finish);
+    imsi->key = ofonoext_mm_imsi_pack(str);
+    imsi->str = str;
+    imsi->big = NULL;
+}
+
+static
+const char*
+ofonoext_mm_imsi_set(
+    OfonoExtModemManagerImsi* imsi,
+    const char* str)
+{
+    g_free(imsi->big);
+    imsi->big = NULL;
+    imsi->key = ofonoext_mm_imsi_pack(str);
+    if (!str) {
+        imsi->str = NULL;
+    } else {
+        const gsize len = strlen(str);
+
+        /* Valid IMSIs always fit, this doesn't allocate */
+        if (len < sizeof(imsi->buf)) {
+            memcpy(imsi->buf, str, len + 1);
+            imsi->str = imsi->buf;
+        } else {
+            imsi->str = imsi->big = g_strdup(str);
+        }
+    }
+    return imsi->str;
+}
+
+static
+void
+ofonoext_mm_imsi_clear(
+    OfonoExtModemManagerImsi* imsi)
+{
+    ofonoext_mm_imsi_set(imsi, NULL);
 }
 
 static
 gboolean
-ofonoext_mm_get_all2_finish(
-    OrgNemomobileOfonoModemManager* proxy,
-    gint* version,
-    gchar*** available,
-    gchar*** enabled,
-    gchar** data_imsi,
-    gchar** voice_imsi,
-    gchar** data_path,
-    gchar** voice_path,
-    GVariant** present_sims,
-    gchar*** imei,
-    gchar** mms_imsi,
-    gchar** mms_path,
-    gboolean* ready,
-    GAsyncResult* res,
-    GError **error)
+ofonoext_mm_imsi_equal(
+    gconstpointer a,
+    gconstpointer b)
 {
-    *imei = NULL;
-    *mms_imsi = NULL;
-    *mms_path = NULL;
-    *ready = TRUE;
-    return org_nemomobile_ofono_modem_manager_call_get_all2_finish(proxy,
-        version, available, enabled, data_imsi, voice_imsi, data_path,
-        voice_path, present_sims, res, error);
+    const OfonoExtModemManagerImsi* imsi1 = a;
+    const OfonoExtModemManagerImsi* imsi2 = b;
+
+    return (imsi1->key || imsi2->key) ? (imsi1->key == imsi2->key) :
+        !g_strcmp0(imsi1->str, imsi2->str);
+}
+
+static
+gboolean
+ofonoext_mm_imsi_equal_str(
+    const OfonoExtModemManagerImsi* imsi,
+    const char* str)
+{
+    OfonoExtModemManagerImsi tmp;
+
+    ofonoext_mm_imsi_wrap(&tmp, str);
+    return ofonoext_mm_imsi_equal(imsi, &tmp);
+}
+
+static
+guint
+ofonoext_mm_imsi_hash(
+    gconstpointer data)
+{
+    const OfonoExtModemManagerImsi* imsi = data;
+
+    return imsi->key ? g_int64_hash(&imsi->key) : g_str_hash(imsi->str);
+}
+
+static
+gint
+ofonoext_mm_index_lookup(
+    GHashTable* index,
+    const char* key)
+{
+    return key ? (GPOINTER_TO_INT(g_hash_table_lookup(index, key)) - 1) : -1;
 }
 
 static
 void
-ofonoext_mm_get_all2_done(
-    GObject* proxy,
-    GAsyncResult* res,
-    gpointer data)
+ofonoext_mm_index_strv(
+    GHashTable* index,
+    const GStrV* sv)
 {
-    ofonoext_mm_get_all_finish(proxy, res, data, ofonoext_mm_get_all2_finish);
+    g_hash_table_remove_all(index);
+    if (sv) {
+        gint i;
+
+        /* Keys are owned by the strv, the first occurrence wins */
+        for (i = 0; sv[i]; i++) {
+            if (!g_hash_table_contains(index, sv[i])) {
+                g_hash_table_insert(index, sv[i], GINT_TO_POINTER(i + 1));
+            }
+        }
+    }
+}
+
+static
+gint
+ofonoext_mm_imsi_lookup(
+    OfonoExtModemManager* self,
+    const char* str)
+{
+    if (str) {
+        OfonoExtModemManagerImsi key;
+
+        ofonoext_mm_imsi_wrap(&key, str);
+        return GPOINTER_TO_INT(g_hash_table_lookup(self->priv->imsi_index,
+            &key)) - 1;
+    }
+    return -1;
 }
 
 static
 void
-ofonoext_mm_get_allx(
-    OfonoExtModemManager* self)
+ofonoext_mm_imsi_forget(
+    OfonoExtModemManager* self,
+    gint slot)
 {
     OfonoExtModemManagerPriv* priv = self->priv;
+    OfonoExtModemManagerImsi* imsi = priv->slot_imsi + slot;
 
-    GASSERT(!self->valid);
-    GASSERT(!priv->cancel);
-    GASSERT(priv->version > 1);
-   
-    priv->cancel = g_cancellable_new();
-    ofonoext_mm_ref(self);
-    switch (priv->version) {
-    case 2:
-        /* Request version 2 settings */
-        org_nemomobile_ofono_modem_manager_call_get_all2(priv->proxy,
-            priv->cancel, ofonoext_mm_get_all2_done, self);
-        break;
-    case 3:
-        /* Request version 3 settings */
-        org_nemomobile_ofono_modem_manager_call_get_all3(priv->proxy,
-            priv->cancel, ofonoext_mm_get_all3_done, self);
-        break;
-    case 4:
-        /* Request version 4 settings */
-        org_nemomobile_ofono_modem_manager_call_get_all4(priv->proxy,
-            priv->cancel, ofonoext_mm_get_all4_done, self);
-        break;
-    case 5:
-    default:
-        /* Request version 5 settings */
-        org_nemomobile_ofono_modem_manager_call_get_all5(priv->proxy,
-            priv->cancel, ofonoext_mm_get_all5_done, self);
-        break;
+    if (imsi->str) {
+        g_hash_table_remove(priv->imsi_index, imsi);
+        ofonoext_mm_imsi_clear(imsi);
     }
 }
 
+/*
+ * Only the SIM manager knows for sure which IMSI is in which slot, so
+ * only what it says may replace the existing entries. The default SIM
+ * pairs can only fill the gaps.
+ */
 static
 void
-ofonoext_mm_get_all_done(
-    GObject* proxy,
-    GAsyncResult* result,
-    gpointer data)
+ofonoext_mm_imsi_learn(
+    OfonoExtModemManager* self,
+    const char* imsi,
+    gint slot,
+    gboolean confirmed)
 {
-    GError* error = NULL;
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
     OfonoExtModemManagerPriv* priv = self->priv;
-    int version = 0;
-    char** available = NULL;
-    char** enabled = NULL;
-    char* data_imsi = NULL;
-    char* voice_imsi = NULL;
-    char* data_path = NULL;
-    char* voice_path = NULL;
 
-    GASSERT(!self->valid);
-    GASSERT(priv->cancel);
-    g_object_unref(priv->cancel);
-    priv->cancel = NULL;
-    if (org_nemomobile_ofono_modem_manager_call_get_all_finish(
-        ORG_NEMOMOBILE_OFONO_MODEM_MANAGER(proxy), &version, &available,
-        &enabled, &data_imsi, &voice_imsi, &data_path, &voice_path,
-        result, &error)) {
-        GDEBUG("Interface version %d", version);
-        priv->version = version;
-        if (version == 1) {
-            /* ofonoext_mm_init_done takes the ownership of the arguments
-             * except for data_path and voice_path */
-            ofonoext_mm_init_done(self, available, enabled, data_imsi,
-                voice_imsi, data_path, voice_path, NULL, NULL, NULL, NULL,
-                TRUE);
-        } else {
-            g_strfreev(available);
-            g_strfreev(enabled);
-            g_free(data_imsi);
-            g_free(voice_imsi);
-            ofonoext_mm_get_allx(self);
-        }
-    } else {
-        g_strfreev(available);
-        g_strfreev(enabled);
-        g_free(data_imsi);
-        g_free(voice_imsi);
-#if GUTIL_LOG_ERR
-        if (error->code == G_IO_ERROR_CANCELLED) {
-            GDEBUG("%s", GERRMSG(error));
-        } else {
-            GERR("%s", GERRMSG(error));
-        }
-#endif
-        /* Retry the call */
-        if (ofonoext_mm_is_timeout(error)) {
-            ofonoext_mm_schedule_retry(self);
+    if (priv->slot_imsi && imsi && imsi[0] &&
+        slot >= 0 && slot < (gint)self->modem_count &&
+        (!priv->present_sims || priv->present_sims[slot]) &&
+        !ofonoext_mm_imsi_equal_str(priv->slot_imsi + slot, imsi)) {
+        const gint prev = ofonoext_mm_imsi_lookup(self, imsi);
+
+        if (confirmed) {
+            /* Each IMSI is in one slot, each slot has one IMSI */
+            if (prev >= 0) {
+                ofonoext_mm_imsi_forget(self, prev);
+            }
+            ofonoext_mm_imsi_forget(self, slot);
+        } else if (prev >= 0 || priv->slot_imsi[slot].str) {
+            GDEBUG("Not learning %s in slot %d", imsi, slot);
+            return;
         }
+        ofonoext_mm_imsi_set(priv->slot_imsi + slot, imsi);
+        g_hash_table_insert(priv->imsi_index, priv->slot_imsi + slot,
+            GINT_TO_POINTER(slot + 1));
     }
-    g_free(data_path);
-    g_free(voice_path);
-    ofonoext_mm_unref(self);
-    if (error) g_error_free(error);
+}
+
+static
+void
+ofonoext_mm_imsi_learn_modem(
+    OfonoExtModemManager* self,
+    const char* imsi,
+    OfonoModem* modem)
+{
+    if (modem) {
+        ofonoext_mm_imsi_learn(self, imsi, ofonoext_mm_index_lookup(
+            self->priv->path_index, ofono_modem_path(modem)), FALSE);
+    }
+}
+
+static
+void
+ofonoext_mm_imsi_learn_pairs(
+    OfonoExtModemManager* self)
+{
+    ofonoext_mm_imsi_learn_modem(self, self->data_imsi, self->data_modem);
+    ofonoext_mm_imsi_learn_modem(self, self->voice_imsi, self->voice_modem);
+    ofonoext_mm_imsi_learn_modem(self, self->mms_imsi, self->mms_modem);
 }
 
 static
 gboolean
-ofonoext_mm_retry_cb(
+ofonoext_mm_imsi_learn_idle(
     gpointer data)
 {
     OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
-    OfonoExtModemManagerPriv* priv = self->priv;
-
-    GASSERT(!self->valid);
-    GASSERT(!priv->cancel);
-    GASSERT(priv->retry_timer_id);
-    priv->retry_timer_id = 0;
 
-    /* Bump the reference count for the duration of the D-Bus call */
-    ofonoext_mm_ref(self);
-    if (priv->version) {
-        ofonoext_mm_get_allx(self);
-    } else {
-        priv->cancel = g_cancellable_new();
-        org_nemomobile_ofono_modem_manager_call_get_all(priv->proxy,
-            priv->cancel, ofonoext_mm_get_all_done, self);
-    }
+    self->priv->imsi_learn_id = 0;
+    ofonoext_mm_imsi_learn_pairs(self);
     return G_SOURCE_REMOVE;
 }
 
 static
 void
-ofonoext_mm_schedule_retry(
+ofonoext_mm_update_imsi_index(
     OfonoExtModemManager* self)
 {
     OfonoExtModemManagerPriv* priv = self->priv;
 
-    GASSERT(!priv->cancel);
-    GASSERT(!self->valid);
-    if (!priv->retry_timer_id) {
-        priv->retry_timer_id = g_timeout_add_seconds(MM_RETRY_SEC,
-            ofonoext_mm_retry_cb, self);
+    /*
+     * IMSI and modem change signals come separately, so a pair may be
+     * briefly inconsistent. Give the other half a chance to arrive.
+     */
+    if (priv->slot_imsi && !priv->imsi_learn_id) {
+        priv->imsi_learn_id = ofonoext_mm_add_idle(self,
+            ofonoext_mm_imsi_learn_idle, self);
     }
 }
 
 static
 void
-ofonoext_mm_proxy_created(
-    GObject* proxy,
-    GAsyncResult* result,
-    gpointer data)
+ofonoext_mm_clear_indexes(
+    OfonoExtModemManager* self)
 {
-    GError* error = NULL;
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
     OfonoExtModemManagerPriv* priv = self->priv;
 
-    GASSERT(priv->cancel);
-    GASSERT(!self->valid);
-    GASSERT(!priv->proxy);
-    g_object_unref(priv->cancel);
-    priv->cancel = NULL;
-    priv->proxy =
-        org_nemomobile_ofono_modem_manager_proxy_new_finish(result, &error);
-    
-    if (priv->proxy) {
-        /* Request current settings */
-        priv->cancel = g_cancellable_new();
-        org_nemomobile_ofono_modem_manager_call_get_all(priv->proxy,
-            priv->cancel, ofonoext_mm_get_all_done, self);
-    } else {
-#if GUTIL_LOG_ERR
-        if (error->code == G_IO_ERROR_CANCELLED) {
-            GDEBUG("%s", GERRMSG(error));
-        } else {
-            GERR("%s", GERRMSG(error));
+    g_hash_table_remove_all(priv->path_index);
+    g_hash_table_remove_all(priv->imei_index);
+    g_hash_table_remove_all(priv->imsi_index);
+    if (priv->imsi_learn_id) {
+        g_source_remove(priv->imsi_learn_id);
+        priv->imsi_learn_id = 0;
+    }
+    if (priv->slot_imsi) {
+        guint i;
+
+        for (i=0; i<self->modem_count; i++) {
+            ofonoext_mm_imsi_clear(priv->slot_imsi + i);
         }
-#endif
-        ofonoext_mm_reset(self);
-        ofonoext_mm_unref(self);
+        g_free(priv->slot_imsi);
+        priv->slot_imsi = NULL;
     }
-    if (error) g_error_free(error);
 }
 
 static
 void
-ofonoext_mm_name_appeared(
-    GDBusConnection* bus,
-    const gchar* name,
-    const gchar* owner,
-    gpointer arg)
+ofonoext_mm_build_indexes(
+    OfonoExtModemManager* self)
 {
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(arg);
     OfonoExtModemManagerPriv* priv = self->priv;
-    GDEBUG("Name '%s' is owned by %s", name, owner);
 
-    /* Start the initialization sequence */
-    GASSERT(!priv->cancel);
-    priv->cancel = g_cancellable_new();
-    org_nemomobile_ofono_modem_manager_proxy_new(bus,
-        G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES, OFONO_SERVICE, "/",
-        priv->cancel, ofonoext_mm_proxy_created, ofonoext_mm_ref(self));
+    ofonoext_mm_clear_indexes(self);
+    ofonoext_mm_index_strv(priv->path_index, priv->available);
+    ofonoext_mm_index_strv(priv->imei_index, priv->imei);
+    priv->slot_imsi = g_new0(OfonoExtModemManagerImsi, self->modem_count);
+
+    /* GetAll reply is a consistent snapshot */
+    ofonoext_mm_imsi_learn_pairs(self);
+}
+
+static
+gboolean
+ofonoext_mm_slot_is_warm(
+    const OfonoExtModemManagerSlot* slot)
+{
+    return slot->modem->object.valid &&
+        (slot->simmgr->intf.object.valid ||
+         !ofono_modem_has_interface(slot->modem, MM_SIMMGR_INTERFACE));
+}
+
+static
+void
+ofonoext_mm_check_warm(
+    OfonoExtModemManager* self)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    if (priv->slots && self->valid && !self->slots_warm) {
+        guint i;
+
+        for (i=0; i<priv->nslots; i++) {
+            if (!ofonoext_mm_slot_is_warm(priv->slots + i)) {
+                return;
+            }
+        }
+        GDEBUG("All %u slot(s) are warm", priv->nslots);
+        self->slots_warm = TRUE;
+        ofonoext_mm_emit(self, SIGNAL_SLOTS_WARM);
+    }
+}
+
+static
+void
+ofonoext_mm_slot_learn_imsi(
+    OfonoExtModemManagerSlot* slot)
+{
+    OfonoSimMgr* simmgr = slot->simmgr;
+
+    if (simmgr->intf.object.valid && simmgr->present) {
+        ofonoext_mm_imsi_learn(slot->mm, simmgr->imsi, slot->index, TRUE);
+    }
+}
+
+static
+void
+ofonoext_mm_slot_modem_changed(
+    OfonoModem* modem,
+    void* arg)
+{
+    OfonoExtModemManagerSlot* slot = arg;
+
+    ofonoext_mm_check_warm(slot->mm);
+}
+
+static
+void
+ofonoext_mm_slot_simmgr_changed(
+    OfonoSimMgr* simmgr,
+    void* arg)
+{
+    OfonoExtModemManagerSlot* slot = arg;
+
+    ofonoext_mm_slot_learn_imsi(slot);
+    ofonoext_mm_check_warm(slot->mm);
+}
+
+static
+void
+ofonoext_mm_prefetch_stop(
+    OfonoExtModemManager* self)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    if (priv->slots) {
+        guint i;
+
+        for (i=0; i<priv->nslots; i++) {
+            OfonoExtModemManagerSlot* slot = priv->slots + i;
+
+            ofono_modem_remove_handlers(slot->modem,
+                slot->modem_event_id, G_N_ELEMENTS(slot->modem_event_id));
+            ofono_simmgr_remove_handlers(slot->simmgr,
+                slot->simmgr_event_id, G_N_ELEMENTS(slot->simmgr_event_id));
+            ofono_modem_unref(slot->modem);
+            ofono_simmgr_unref(slot->simmgr);
+        }
+        g_free(priv->slots);
+        priv->slots = NULL;
+        priv->nslots = 0;
+    }
+    self->slots_warm = FALSE;
+}
+
+static
+void
+ofonoext_mm_prefetch_start(
+    OfonoExtModemManager* self)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+    guint i;
+
+    /*
+     * All the objects start fetching their properties at the same time,
+     * instead of the caller waiting for them one by one. The objects are
+     * shared with everyone else in the process who asks for them.
+     */
+    ofonoext_mm_prefetch_stop(self);
+    priv->nslots = self->modem_count;
+    priv->slots = g_new0(OfonoExtModemManagerSlot, priv->nslots);
+    for (i=0; i<priv->nslots; i++) {
+        OfonoExtModemManagerSlot* slot = priv->slots + i;
+        const char* path = priv->available[i];
+
+        slot->mm = self;
+        slot->index = i;
+        slot->modem = ofono_modem_new(path);
+        slot->simmgr = ofono_simmgr_new(path);
+        slot->modem_event_id[SLOT_MODEM_VALID_CHANGED] =
+            ofono_modem_add_valid_changed_handler(slot->modem,
+                ofonoext_mm_slot_modem_changed, slot);
+        slot->modem_event_id[SLOT_MODEM_INTERFACES_CHANGED] =
+            ofono_modem_add_interfaces_changed_handler(slot->modem,
+                ofonoext_mm_slot_modem_changed, slot);
+        slot->simmgr_event_id[SLOT_SIMMGR_VALID_CHANGED] =
+            ofono_simmgr_add_valid_changed_handler(slot->simmgr,
+                ofonoext_mm_slot_simmgr_changed, slot);
+        slot->simmgr_event_id[SLOT_SIMMGR_IMSI_CHANGED] =
+            ofono_simmgr_add_imsi_changed_handler(slot->simmgr,
+                ofonoext_mm_slot_simmgr_changed, slot);
+        slot->simmgr_event_id[SLOT_SIMMGR_PRESENT_CHANGED] =
+            ofono_simmgr_add_present_changed_handler(slot->simmgr,
+                ofonoext_mm_slot_simmgr_changed, slot);
+        ofonoext_mm_slot_learn_imsi(slot);
+    }
+}
+
+static
+guint
+ofonoext_mm_stats_hash(
+    gconstpointer key)
+{
+    const OfonoExtModemManagerHandlerStats* stats = key;
+
+    return g_direct_hash(stats->signal) ^ g_direct_hash(stats->fn);
+}
+
+static
+gboolean
+ofonoext_mm_stats_equal(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const OfonoExtModemManagerHandlerStats* s1 = a;
+    const OfonoExtModemManagerHandlerStats* s2 = b;
+
+    return s1->signal == s2->signal && s1->fn == s2->fn;
+}
+
+static
+int
+ofonoext_mm_stats_compare(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const OfonoExtModemManagerHandlerStats* s1 = a;
+    const OfonoExtModemManagerHandlerStats* s2 = b;
+
+    return (s1->total_us > s2->total_us) ? -1 :
+        (s1->total_us < s2->total_us) ? 1 : 0;
+}
+
+static
+void
+ofonoext_mm_timed_handler_free(
+    gpointer data,
+    GClosure* closure)
+{
+    g_slice_free(OfonoExtModemManagerTimedHandler, data);
+}
+
+/* Invoked instead of the handler */
+static
+void
+ofonoext_mm_timed_handler(
+    OfonoExtModemManager* self,
+    OfonoExtModemManagerTimedHandler* handler)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+    OfonoExtModemManagerHandlerStats* stats = handler->stats;
+
+    if (priv->timing) {
+        const gint64 start = g_get_monotonic_time();
+        guint64 t;
+
+        stats->fn(self, handler->data);
+        t = g_get_monotonic_time() - start;
+        stats->count++;
+        stats->total_us += t;
+        if (stats->max_us < t) {
+            stats->max_us = t;
+        }
+        if (priv->handler_budget && t > priv->handler_budget) {
+            stats->slow++;
+            GWARN("Slow %s handler %p(%p) took %u us, budget %u us",
+                stats->signal, stats->fn, handler->data, (guint)t,
+                priv->handler_budget);
+        }
+    } else {
+        stats->fn(self, handler->data);
+    }
+}
+
+static
+GClosure*
+ofonoext_mm_timed_closure(
+    OfonoExtModemManager* self,
+    enum ofonoext_mm_signal sig,
+    OfonoExtModemManagerHandler fn,
+    void* data)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+    OfonoExtModemManagerHandlerStats key;
+    OfonoExtModemManagerHandlerStats* stats;
+    OfonoExtModemManagerTimedHandler* handler;
+
+    /* Records are shared by the handlers with the same function */
+    memset(&key, 0, sizeof(key));
+    key.signal = g_signal_name(ofonoext_mm_signals[sig]);
+    key.fn = fn;
+    if (!priv->handler_stats) {
+        priv->handler_stats = g_hash_table_new_full(ofonoext_mm_stats_hash,
+            ofonoext_mm_stats_equal, g_free, NULL);
+    }
+    stats = g_hash_table_lookup(priv->handler_stats, &key);
+    if (!stats) {
+        stats = g_new(OfonoExtModemManagerHandlerStats, 1);
+        *stats = key;
+        g_hash_table_add(priv->handler_stats, stats);
+    }
+
+    /* The records outlive the closures */
+    handler = g_slice_new(OfonoExtModemManagerTimedHandler);
+    handler->stats = stats;
+    handler->data = data;
+    return g_cclosure_new(G_CALLBACK(ofonoext_mm_timed_handler), handler,
+        ofonoext_mm_timed_handler_free);
+}
+
+static
+gulong
+ofonoext_mm_connect(
+    OfonoExtModemManager* self,
+    enum ofonoext_mm_signal sig,
+    OfonoExtModemManagerHandler fn,
+    void* data,
+    gboolean timed)
+{
+    const gulong id = g_signal_connect_closure_by_id(self,
+        ofonoext_mm_signals[sig], 0, timed ?
+        ofonoext_mm_timed_closure(self, sig, fn, data) :
+        g_cclosure_new(G_CALLBACK(fn), data, NULL), FALSE);
+
+    if (self->priv->on_demand) {
+        ofonoext_mm_update_subscriptions(self);
+    }
+    return id;
+}
+
+static
+gulong
+ofonoext_mm_add_handler(
+    OfonoExtModemManager* self,
+    enum ofonoext_mm_signal sig,
+    OfonoExtModemManagerHandler fn,
+    void* data)
+{
+    if (G_LIKELY(self) && G_LIKELY(fn)) {
+        return ofonoext_mm_connect(self, sig, fn, data, self->priv->timing);
+    }
+    return 0;
+}
+
+static
+gboolean
+ofonoext_mm_wait_satisfied(
+    OfonoExtModemManager* self,
+    OFONOEXT_MM_WAIT mask,
+    guint count)
+{
+    /* All conditions imply valid */
+    return self->valid &&
+        (!(mask & OFONOEXT_MM_WAIT_READY) || self->ready) &&
+        (!(mask & OFONOEXT_MM_WAIT_DATA_MODEM) || self->data_modem) &&
+        (!(mask & OFONOEXT_MM_WAIT_VOICE_MODEM) || self->voice_modem) &&
+        (!(mask & OFONOEXT_MM_WAIT_MMS_MODEM) || self->mms_modem) &&
+        (!(mask & OFONOEXT_MM_WAIT_DATA_IMSI) ||
+            (self->data_imsi && self->data_imsi[0])) &&
+        (!(mask & OFONOEXT_MM_WAIT_VOICE_IMSI) ||
+            (self->voice_imsi && self->voice_imsi[0])) &&
+        (!(mask & OFONOEXT_MM_WAIT_MMS_IMSI) ||
+            (self->mms_imsi && self->mms_imsi[0])) &&
+        (!(mask & OFONOEXT_MM_WAIT_SIM_COUNT) ||
+            self->sim_count >= count) &&
+        (!(mask & OFONOEXT_MM_WAIT_ACTIVE_SIM_COUNT) ||
+            self->active_sim_count >= count) &&
+        (!(mask & OFONOEXT_MM_WAIT_SLOTS_WARM) || self->slots_warm);
+}
+
+static
+void
+ofonoext_mm_wait_clear_source(
+    GSource** source)
+{
+    if (*source) {
+        g_source_destroy(*source);
+        g_source_unref(*source);
+        *source = NULL;
+    }
+}
+
+static
+void
+ofonoext_mm_wait_finish(
+    OfonoExtModemManagerWaitCall* call)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(call->common.owner);
+
+    /* Called exactly once, never from the "cancelled" handler */
+    ofonoext_mm_remove_all_handlers(self, call->event_id);
+    g_cancellable_disconnect(call->common.cancel, call->cancel_id);
+    ofonoext_mm_wait_clear_source(&call->timeout);
+    ofonoext_mm_wait_clear_source(&call->idle);
+    if (call->fn && (call->report_cancel ||
+        !g_cancellable_is_cancelled(call->common.cancel))) {
+        call->fn(self, call->satisfied, call->arg);
+    }
+    g_main_context_unref(call->context);
+    ofonoext_call_destroy(&call->common);
+    g_free(call);
+}
+
+static
+gboolean
+ofonoext_mm_wait_idle(
+    gpointer data)
+{
+    OfonoExtModemManagerWaitCall* call = data;
+
+    /* The context holds its own reference during dispatch */
+    g_source_unref(call->idle);
+    call->idle = NULL;
+    ofonoext_mm_wait_finish(call);
+    return G_SOURCE_REMOVE;
+}
+
+static
+gboolean
+ofonoext_mm_wait_timeout(
+    gpointer data)
+{
+    OfonoExtModemManagerWaitCall* call = data;
+
+    g_source_unref(call->timeout);
+    call->timeout = NULL;
+    ofonoext_mm_wait_finish(call);
+    return G_SOURCE_REMOVE;
+}
+
+/* Attaches the source to the context the wait was started on */
+static
+GSource*
+ofonoext_mm_wait_add_source(
+    OfonoExtModemManagerWaitCall* call,
+    GSource* source,
+    GSourceFunc fn)
+{
+    ofonoext_mm_attach(OFONOEXT_MODEM_MANAGER(call->common.owner), source,
+        call->context, fn, call);
+    return source;
+}
+
+static
+void
+ofonoext_mm_wait_cancelled(
+    GCancellable* cancel,
+    gpointer data)
+{
+    OfonoExtModemManagerWaitCall* call = data;
+
+    /* Can't disconnect from here, finish the call on a fresh stack */
+    if (!call->idle) {
+        call->idle = ofonoext_mm_wait_add_source(call, g_idle_source_new(),
+            ofonoext_mm_wait_idle);
+    }
+}
+
+static
+void
+ofonoext_mm_wait_sync_done(
+    OfonoExtModemManager* self,
+    gboolean ok,
+    void* data)
+{
+    OfonoExtModemManagerWaitSync* sync = data;
+
+    sync->ok = ok;
+    sync->done = TRUE;
+}
+
+static
+void
+ofonoext_mm_wait_check(
+    OfonoExtModemManager* self,
+    void* data)
+{
+    OfonoExtModemManagerWaitCall* call = data;
+
+    if (!call->satisfied &&
+        ofonoext_mm_wait_satisfied(self, call->mask, call->count)) {
+        call->satisfied = TRUE;
+        ofonoext_mm_wait_finish(call);
+    }
+}
+
+static
+OfonoExtModemManagerWaitCall*
+ofonoext_mm_wait_start(
+    OfonoExtModemManager* self,
+    OFONOEXT_MM_WAIT mask,
+    guint count,
+    guint timeout_ms,
+    GCancellable* cancel,
+    OfonoExtModemManagerWaitHandler fn,
+    void* arg)
+{
+    OfonoExtModemManagerWaitCall* call =
+        g_new0(OfonoExtModemManagerWaitCall, 1);
+
+    /* The handler is invoked on cancel if the cancellable is external */
+    ofonoext_call_init_full(&call->common, G_OBJECT(self), cancel);
+    call->report_cancel = (cancel != NULL);
+    call->mask = mask;
+    call->count = count;
+    call->fn = fn;
+    call->arg = arg;
+    /* GTask callbacks are invoked there too */
+    call->context = g_main_context_ref_thread_default();
+    call->cancel_id = g_cancellable_connect(call->common.cancel,
+        G_CALLBACK(ofonoext_mm_wait_cancelled), call, NULL);
+    if (ofonoext_mm_wait_satisfied(self, mask, count)) {
+        /* The handler is never invoked before this function returns */
+        call->satisfied = TRUE;
+        if (!call->idle) {
+            call->idle = ofonoext_mm_wait_add_source(call,
+                g_idle_source_new(), ofonoext_mm_wait_idle);
+        }
+    } else {
+        guint i;
+
+        /* Only listen to what's relevant, plus the validity */
+        for (i=0; i<MM_WAIT_EVENT_COUNT; i++) {
+            const struct ofonoext_mm_wait_event* e =
+                ofonoext_mm_wait_events + i;
+
+            if (e->sig == SIGNAL_VALID_CHANGED || (mask & e->flag)) {
+                /* Internal handlers are never timed */
+                call->event_id[i] = ofonoext_mm_connect(self, e->sig,
+                    ofonoext_mm_wait_check, call, FALSE);
+            }
+        }
+        if (timeout_ms) {
+            call->timeout = ofonoext_mm_wait_add_source(call,
+                g_timeout_source_new(timeout_ms), ofonoext_mm_wait_timeout);
+        }
+    }
+    return call;
+}
+
+static
+void
+ofonoext_mm_task_wait_done(
+    OfonoExtModemManager* self,
+    gboolean ok,
+    void* data)
+{
+    GTask* task = G_TASK(data);
+
+    if (!g_task_return_error_if_cancelled(task)) {
+        if (ok) {
+            g_task_return_boolean(task, TRUE);
+        } else {
+            g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                "No valid state");
+        }
+    }
+    g_object_unref(task);
+}
+
+static
+void
+ofonoext_mm_task_call_done(
+    GObject* proxy,
+    GAsyncResult* result,
+    gpointer data)
+{
+    GTask* task = G_TASK(data);
+    GError* error = NULL;
+    GVariant* ret = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), result,
+        &error);
+
+    if (ret) {
+        if (g_variant_is_of_type(ret, G_VARIANT_TYPE("(s)"))) {
+            char* str = NULL;
+
+            g_variant_get(ret, "(s)", &str);
+            g_task_return_pointer(task, str, g_free);
+        } else {
+            g_task_return_boolean(task, TRUE);
+        }
+        g_variant_unref(ret);
+    } else {
+        ofonoext_mm_count_error(OFONOEXT_MODEM_MANAGER
+            (g_task_get_source_object(task)), error);
+        g_task_return_error(task, error);
+    }
+    g_object_unref(task);
+}
+
+static
+void
+ofonoext_mm_task_call(
+    OfonoExtModemManager* self,
+    const char* method,
+    GVariant* args,
+    GCancellable* cancel,
+    GAsyncReadyCallback callback,
+    gpointer data,
+    gpointer source_tag)
+{
+    if (G_LIKELY(self)) {
+        GTask* task = g_task_new(self, cancel, callback, data);
+
+        g_task_set_source_tag(task, source_tag);
+        if (self->valid && self->priv->proxy) {
+            self->priv->counters.calls++;
+            g_dbus_proxy_call(G_DBUS_PROXY(self->priv->proxy), method, args,
+                G_DBUS_CALL_FLAGS_NONE, -1, cancel,
+                ofonoext_mm_task_call_done, task);
+        } else {
+            if (args) {
+                g_variant_unref(g_variant_ref_sink(args));
+            }
+            if (self->valid) {
+                /* There's nobody to ask in the offline mode */
+                g_task_return_new_error(task, G_IO_ERROR,
+                    G_IO_ERROR_NOT_SUPPORTED, "Not supported by scenario");
+            } else {
+                g_task_return_new_error(task, G_IO_ERROR,
+                    G_IO_ERROR_NOT_INITIALIZED, "Modem manager is not valid");
+            }
+            g_object_unref(task);
+        }
+    } else {
+        if (args) {
+            g_variant_unref(g_variant_ref_sink(args));
+        }
+        g_task_report_new_error(NULL, callback, data, source_tag,
+            G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Invalid argument");
+    }
+}
+
+static
+gboolean
+ofonoext_mm_task_finish(
+    OfonoExtModemManager* self,
+    GAsyncResult* result,
+    GError** error)
+{
+    /* Results of g_task_report_new_error() have no source object */
+    if (g_task_is_valid(result, self)) {
+        return g_task_propagate_boolean(G_TASK(result), error);
+    }
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+        "Invalid argument");
+    return FALSE;
+}
+
+static
+void
+ofonoext_mm_delta_free(
+    gpointer data)
+{
+    OfonoExtModemManagerDelta* delta = data;
+
+    g_free(delta->str);
+    g_strfreev(delta->strv);
+    if (delta->args) {
+        g_variant_unref(delta->args);
+    }
+    if (delta->error) {
+        g_error_free(delta->error);
+    }
+    g_slice_free(OfonoExtModemManagerDelta, delta);
+}
+
+/* Worker thread */
+static
+OfonoExtModemManagerDelta*
+ofonoext_mm_delta_new(
+    enum proxy_handler_id id,
+    GVariant* args)
+{
+    const struct ofonoext_mm_proxy_signal* sig =
+        ofonoext_mm_proxy_signals + id;
+    OfonoExtModemManagerDelta* delta;
+
+    if (!g_variant_is_of_type(args, G_VARIANT_TYPE(sig->signal_type))) {
+        GERR("Unexpected %s type %s", sig->signal,
+            g_variant_get_type_string(args));
+        return NULL;
+    }
+
+    delta = g_slice_new0(OfonoExtModemManagerDelta);
+    delta->id = id;
+    switch (id) {
+    case PROXY_SIGNAL_ENABLED_MODEMS_CHANGED:
+        g_variant_get(args, "(^ao)", &delta->strv);
+        break;
+    case PROXY_SIGNAL_PRESENT_SIMS_CHANGED:
+        g_variant_get(args, "(ib)", &delta->index, &delta->flag);
+        break;
+    case PROXY_SIGNAL_READY_CHANGED:
+        g_variant_get(args, "(b)", &delta->flag);
+        break;
+    default:
+        g_variant_get(args, "(s)", &delta->str);
+        break;
+    }
+    return delta;
+}
+
+/* Worker thread */
+static
+void
+ofonoext_mm_worker_push(
+    OfonoExtModemManagerWorker* worker,
+    OfonoExtModemManagerDelta* delta)
+{
+    if (!ofonoext_ring_push(worker->queue, delta)) {
+        gboolean pushed;
+
+        /*
+         * The default context is falling behind. Block until it has
+         * drained the queue. Taking the mutex orders our push after
+         * its pops, so the wakeup can't be missed.
+         */
+        g_mutex_lock(&worker->mutex);
+        while (!(pushed = ofonoext_ring_push(worker->queue, delta)) &&
+            !g_atomic_int_get(&worker->quit)) {
+            worker->blocked = TRUE;
+            g_cond_wait(&worker->drained, &worker->mutex);
+        }
+        g_mutex_unlock(&worker->mutex);
+        if (!pushed) {
+            /* Getter replies keep the manager alive, can't get here */
+            GASSERT(!delta->refresh);
+            ofonoext_mm_delta_free(delta);
+            return;
+        }
+    }
+    /* Don't touch the source if it's going to be dispatched anyway */
+    if (g_atomic_int_compare_and_exchange(&worker->wakeup, FALSE, TRUE)) {
+        g_source_set_ready_time(worker->source, 0);
+    }
+}
+
+/* Worker thread */
+static
+void
+ofonoext_mm_worker_signal(
+    GDBusConnection* bus,
+    const char* sender,
+    const char* path,
+    const char* iface,
+    const char* name,
+    GVariant* args,
+    gpointer data)
+{
+    OfonoExtModemManagerWorkerSignal* sig = data;
+    OfonoExtModemManagerWorker* worker = sig->worker;
+    OfonoExtModemManagerDelta* delta = ofonoext_mm_delta_new(sig->id, args);
+
+    if (delta) {
+        delta->epoch = sig->epoch;
+        ofonoext_mm_worker_push(worker, delta);
+    }
+}
+
+/* Worker thread */
+static
+gboolean
+ofonoext_mm_worker_call(
+    gpointer data)
+{
+    OfonoExtModemManagerWorkerCall* call = data;
+    OfonoExtModemManagerWorker* worker = call->worker;
+    guint* id = worker->signal_id + call->id;
+
+    if (*id) {
+        g_dbus_connection_signal_unsubscribe(call->bus, *id);
+        *id = 0;
+    }
+    if (call->subscribe) {
+        OfonoExtModemManagerWorkerSignal* sig =
+            g_new(OfonoExtModemManagerWorkerSignal, 1);
+
+        /* Callbacks are invoked in the worker thread */
+        sig->worker = worker;
+        sig->id = call->id;
+        sig->epoch = call->epoch;
+        *id = g_dbus_connection_signal_subscribe(call->bus, call->service,
+            MM_INTERFACE, ofonoext_mm_proxy_signals[call->id].signal,
+            call->path, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+            ofonoext_mm_worker_signal, sig, g_free);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+ofonoext_mm_worker_call_free(
+    gpointer data)
+{
+    OfonoExtModemManagerWorkerCall* call = data;
+
+    g_object_unref(call->bus);
+    g_free(call->service);
+    g_free(call->path);
+    g_slice_free(OfonoExtModemManagerWorkerCall, call);
+}
+
+static
+void
+ofonoext_mm_worker_post(
+    OfonoExtModemManager* self,
+    GDBusConnection* bus,
+    enum proxy_handler_id id,
+    gboolean subscribe)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+    OfonoExtModemManagerWorkerCall* call =
+        g_slice_new(OfonoExtModemManagerWorkerCall);
+
+    call->worker = priv->worker;
+    call->bus = g_object_ref(bus);
+    call->service = g_strdup(priv->service);
+    call->path = g_strdup(priv->path);
+    call->id = id;
+    call->epoch = priv->epoch;
+    call->subscribe = subscribe;
+    ofonoext_worker_post(priv->worker->thread, ofonoext_mm_worker_call,
+        call, ofonoext_mm_worker_call_free);
+}
+
+/* Worker thread */
+static
+void
+ofonoext_mm_worker_refresh_done(
+    GObject* bus,
+    GAsyncResult* result,
+    gpointer data)
+{
+    OfonoExtModemManagerWorkerRefresh* call = data;
+    OfonoExtModemManagerDelta* delta = g_slice_new0(OfonoExtModemManagerDelta);
+
+    /* The reply is queued behind the signals received before it */
+    delta->id = call->refresh->id;
+    delta->epoch = call->epoch;
+    delta->refresh = call->refresh;
+    delta->args = g_dbus_connection_call_finish(G_DBUS_CONNECTION(bus),
+        result, &delta->error);
+    ofonoext_mm_worker_push(call->worker, delta);
+
+    g_object_unref(call->bus);
+    if (call->cancel) {
+        g_object_unref(call->cancel);
+    }
+    g_free(call->service);
+    g_free(call->path);
+    g_slice_free(OfonoExtModemManagerWorkerRefresh, call);
+}
+
+/* Worker thread */
+static
+gboolean
+ofonoext_mm_worker_refresh(
+    gpointer data)
+{
+    OfonoExtModemManagerWorkerRefresh* call = data;
+
+    /* Subscriptions posted earlier are already in place */
+    g_dbus_connection_call(call->bus, call->service, call->path,
+        MM_INTERFACE, ofonoext_mm_proxy_signals[call->refresh->id].getter,
+        NULL, NULL, G_DBUS_CALL_FLAGS_NONE, -1, call->cancel,
+        ofonoext_mm_worker_refresh_done, call);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+ofonoext_mm_worker_post_refresh(
+    OfonoExtModemManager* self,
+    OfonoExtModemManagerRefreshData* refresh,
+    GCancellable* cancel)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+    OfonoExtModemManagerWorkerRefresh* call =
+        g_slice_new(OfonoExtModemManagerWorkerRefresh);
+
+    call->worker = priv->worker;
+    call->bus = g_object_ref(g_dbus_proxy_get_connection
+        (G_DBUS_PROXY(priv->proxy)));
+    call->service = g_strdup(priv->service);
+    call->path = g_strdup(priv->path);
+    call->cancel = cancel ? g_object_ref(cancel) : NULL;
+    call->refresh = refresh;
+    call->epoch = priv->epoch;
+    ofonoext_worker_post(priv->worker->thread, ofonoext_mm_worker_refresh,
+        call, NULL);
+}
+
+/* Default context */
+static
+gboolean
+ofonoext_mm_worker_synced(
+    gpointer data)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    GASSERT(priv->cancel);
+    if (priv->proxy && !g_cancellable_is_cancelled(priv->cancel)) {
+        /* Takes over the reference */
+        ofonoext_mm_get_all(self);
+    } else {
+        g_object_unref(priv->cancel);
+        priv->cancel = NULL;
+        ofonoext_mm_unref(self);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+/* Worker thread */
+static
+gboolean
+ofonoext_mm_worker_sync(
+    gpointer data)
+{
+    /* Everything posted before this has been done */
+    ofonoext_mm_add_idle(OFONOEXT_MODEM_MANAGER(data),
+        ofonoext_mm_worker_synced, data);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+ofonoext_mm_unsubscribe(
+    OfonoExtModemManager* self,
+    GDBusConnection* bus,
+    enum proxy_handler_id id)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    if (priv->worker) {
+        ofonoext_mm_worker_post(self, bus, id, FALSE);
+    } else {
+        g_dbus_connection_signal_unsubscribe(bus, priv->proxy_signal_id[id]);
+    }
+    priv->proxy_signal_id[id] = 0;
+}
+
+static
+void
+ofonoext_mm_unsubscribe_all(
+    OfonoExtModemManager* self)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+    GDBusConnection* bus = g_dbus_proxy_get_connection
+        (G_DBUS_PROXY(priv->proxy));
+    int i;
+
+    /* Changes still queued by the worker thread are stale */
+    priv->epoch++;
+    for (i=0; i<PROXY_SIGNAL_COUNT; i++) {
+        if (priv->proxy_signal_id[i]) {
+            ofonoext_mm_unsubscribe(self, bus, i);
+        }
+    }
+}
+
+static
+void
+ofonoext_mm_reset(
+    OfonoExtModemManager* self)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+    ofonoext_mm_cancel_retry(self);
+    ofonoext_mm_prefetch_stop(self);
+    if (priv->refresh) {
+        g_cancellable_cancel(priv->refresh);
+        g_object_unref(priv->refresh);
+        priv->refresh = NULL;
+    }
+    priv->stale = 0;
+    priv->missed = 0;
+    if (priv->proxy) {
+        ofonoext_mm_unsubscribe_all(self);
+        g_object_unref(priv->proxy);
+        priv->proxy = NULL;
+    }
+    ofonoext_mm_clear_indexes(self);
+
+    /* All the strings go away at once */
+    ofonoext_arena_free(priv->arena);
+    ofonoext_arena_free(priv->changes);
+    priv->arena = NULL;
+    priv->changes = NULL;
+    priv->garbage = 0;
+    self->available = priv->available = NULL;
+    self->enabled = priv->enabled = NULL;
+    self->imei = priv->imei = NULL;
+    self->data_imsi = ofonoext_mm_imsi_set(&priv->data_imsi, NULL);
+    self->voice_imsi = ofonoext_mm_imsi_set(&priv->voice_imsi, NULL);
+    self->mms_imsi = ofonoext_mm_imsi_set(&priv->mms_imsi, NULL);
+    self->present_sims = priv->present_sims = NULL;
+    if (self->data_modem) {
+        ofono_modem_unref(self->data_modem);
+        self->data_modem = NULL;
+    }
+    if (self->voice_modem) {
+        ofono_modem_unref(self->voice_modem);
+        self->voice_modem = NULL;
+    }
+    if (self->mms_modem) {
+        ofono_modem_unref(self->mms_modem);
+        self->mms_modem = NULL;
+    }
+}
+
+/*
+ * Copies the state into a new arena and returns the previous one, which
+ * the caller frees when it's done with the old pointers.
+ */
+static
+OfonoExtArena*
+ofonoext_mm_pack(
+    OfonoExtModemManager* self,
+    const GStrV* available,
+    const GStrV* enabled,
+    const GStrV* imei,
+    const gboolean* present_sims)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+    OfonoExtArena* prev = priv->arena;
+    const gsize present_size = sizeof(gboolean) * self->modem_count;
+    const gsize size = ofonoext_arena_strv_size(available) +
+        ofonoext_arena_strv_size(enabled) +
+        ofonoext_arena_strv_size(imei) + present_size;
+    OfonoExtArena* arena;
+
+    ofonoext_arena_free(priv->changes);
+    priv->changes = NULL;
+    priv->garbage = 0;
+    priv->arena = arena = ofonoext_arena_new(size);
+    self->available = priv->available =
+        ofonoext_arena_strdupv(arena, available);
+    self->enabled = priv->enabled = ofonoext_arena_strdupv(arena, enabled);
+    self->imei = priv->imei = ofonoext_arena_strdupv(arena, imei);
+    if (present_sims) {
+        priv->present_sims = ofonoext_arena_alloc(arena, present_size);
+        memcpy(priv->present_sims, present_sims, present_size);
+    } else {
+        priv->present_sims = NULL;
+    }
+    self->present_sims = priv->present_sims;
+    return prev;
+}
+
+/*
+ * The snapshot arena is left alone until the next resync, so that
+ * available, imei and present_sims don't move. Only the replaced values
+ * go to the second arena, which gets repacked once it's mostly garbage.
+ */
+static
+GStrV*
+ofonoext_mm_replace_strv(
+    OfonoExtModemManager* self,
+    const GStrV* old,
+    const GStrV* sv)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    GASSERT(priv->arena);
+    if (priv->changes) {
+        priv->garbage += ofonoext_arena_strv_size(old);
+    } else {
+        priv->changes = ofonoext_arena_new(ofonoext_arena_strv_size(sv) *
+            2);
+    }
+    return ofonoext_arena_strdupv(priv->changes, sv);
+}
+
+static
+void
+ofonoext_mm_compact(
+    OfonoExtModemManager* self)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    if (priv->garbage > MM_ARENA_MAX_GARBAGE &&
+        priv->garbage > ofonoext_arena_used(priv->changes) / 2) {
+        OfonoExtArena* prev = priv->changes;
+        const gsize size = ofonoext_arena_strv_size(priv->enabled);
+
+        /* Enabled modems is the only thing replaced between resyncs */
+        GVERBOSE("Repacked %u bytes", (guint)ofonoext_arena_used(prev));
+        priv->changes = ofonoext_arena_new(size * 2);
+        priv->garbage = 0;
+        self->enabled = priv->enabled =
+            ofonoext_arena_strdupv(priv->changes, priv->enabled);
+        ofonoext_arena_free(prev);
+    }
+}
+
+static
+void
+ofonoext_mm_update_sim_counts(
+    OfonoExtModemManager* self,
+    gboolean emit_signals)
+{
+    guint i;
+    OfonoExtModemManagerPriv* priv = self->priv;
+    const guint old_sim_count = self->sim_count;
+    const guint old_active_sim_count = self->active_sim_count;
+
+    self->sim_count = 0;
+    self->active_sim_count = 0;
+    for (i=0; i<self->modem_count; i++) {
+        if (priv->present_sims && priv->present_sims[i]) {
+            self->sim_count++;
+            if (ofonoext_mm_modem_enabled_at(self, i)) {
+                self->active_sim_count++;
+            }
+        }
+    }
+
+    if (emit_signals) {
+        if (old_sim_count != self->sim_count) {
+            ofonoext_mm_emit(self, SIGNAL_SIM_COUNT_CHANGED);
+        }
+        if (old_active_sim_count != self->active_sim_count) {
+            ofonoext_mm_emit(self, SIGNAL_ACTIVE_SIM_COUNT_CHANGED);
+        }
+    }
+}
+
+static
+void
+ofonoext_mm_enabled_modems_changed(
+    OrgNemomobileOfonoModemManager* proxy,
+    char** modems,
+    gpointer data)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    OfonoExtModemManagerPriv* priv = self->priv;
+    ofonoext_mm_record_strv(self, OFONOEXT_RECORD_INPUT_ENABLED_MODEMS,
+        modems);
+    self->enabled = priv->enabled = ofonoext_mm_replace_strv(self,
+        priv->enabled, modems);
+    ofonoext_mm_compact(self);
+    ofonoext_mm_update_sim_counts(self, TRUE);
+    ofonoext_mm_emit(self, SIGNAL_ENABLED_MODEMS_CHANGED);
+}
+
+static
+void
+ofonoext_mm_default_data_sim_changed(
+    OrgNemomobileOfonoModemManager* proxy,
+    const char* imsi,
+    gpointer data)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    OfonoExtModemManagerPriv* priv = self->priv;
+    ofonoext_mm_record_string(self, OFONOEXT_RECORD_INPUT_DATA_IMSI, imsi);
+    self->data_imsi = ofonoext_mm_imsi_set(&priv->data_imsi, imsi);
+    ofonoext_mm_update_imsi_index(self);
+    ofonoext_mm_emit(self, SIGNAL_DATA_IMSI_CHANGED);
+}
+
+static
+void
+ofonoext_mm_default_data_modem_changed(
+    OrgNemomobileOfonoModemManager* proxy,
+    const char* path,
+    gpointer data)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    ofonoext_mm_record_string(self, OFONOEXT_RECORD_INPUT_DATA_MODEM, path);
+    ofono_modem_unref(self->data_modem);
+    self->data_modem = (path && path[0]) ? ofono_modem_new(path) : NULL;
+    ofonoext_mm_update_imsi_index(self);
+    ofonoext_mm_emit(self, SIGNAL_DATA_MODEM_CHANGED);
+}
+
+static
+void
+ofonoext_mm_default_voice_sim_changed(
+    OrgNemomobileOfonoModemManager* proxy,
+    const char* imsi,
+    gpointer data)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    OfonoExtModemManagerPriv* priv = self->priv;
+    ofonoext_mm_record_string(self, OFONOEXT_RECORD_INPUT_VOICE_IMSI, imsi);
+    self->voice_imsi = ofonoext_mm_imsi_set(&priv->voice_imsi, imsi);
+    ofonoext_mm_update_imsi_index(self);
+    ofonoext_mm_emit(self, SIGNAL_VOICE_IMSI_CHANGED);
+}
+
+static
+void
+ofonoext_mm_default_voice_modem_changed(
+    OrgNemomobileOfonoModemManager* proxy,
+    const char* path,
+    gpointer data)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    ofonoext_mm_record_string(self, OFONOEXT_RECORD_INPUT_VOICE_MODEM, path);
+    ofono_modem_unref(self->voice_modem);
+    self->voice_modem = (path && path[0]) ? ofono_modem_new(path) : NULL;
+    ofonoext_mm_update_imsi_index(self);
+    ofonoext_mm_emit(self, SIGNAL_VOICE_MODEM_CHANGED);
+}
+
+static
+void
+ofonoext_mm_present_sims_changed(
+    OrgNemomobileOfonoModemManager* proxy,
+    int index,
+    gboolean present,
+    gpointer data)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    OfonoExtModemManagerPriv* priv = self->priv;
+    ofonoext_mm_record_present_sim(self, index, present);
+    GASSERT(index >= 0 && index < self->modem_count);
+    if (index >= 0 && index < self->modem_count) {
+        priv->present_sims[index] = (present != FALSE);
+        if (present) {
+            ofonoext_mm_update_imsi_index(self);
+        } else {
+            ofonoext_mm_imsi_forget(self, index);
+        }
+        ofonoext_mm_emit(self, SIGNAL_PRESENT_SIMS_CHANGED);
+        ofonoext_mm_update_sim_counts(self, TRUE);
+    }
+}
+
+static
+void
+ofonoext_mm_mms_sim_changed(
+    OrgNemomobileOfonoModemManager* proxy,
+    const char* imsi,
+    gpointer data)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    OfonoExtModemManagerPriv* priv = self->priv;
+    ofonoext_mm_record_string(self, OFONOEXT_RECORD_INPUT_MMS_IMSI, imsi);
+    self->mms_imsi = ofonoext_mm_imsi_set(&priv->mms_imsi, imsi);
+    ofonoext_mm_update_imsi_index(self);
+    ofonoext_mm_emit(self, SIGNAL_MMS_IMSI_CHANGED);
+}
+
+static
+void
+ofonoext_mm_mms_modem_changed(
+    OrgNemomobileOfonoModemManager* proxy,
+    const char* path,
+    gpointer data)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    ofonoext_mm_record_string(self, OFONOEXT_RECORD_INPUT_MMS_MODEM, path);
+    ofono_modem_unref(self->mms_modem);
+    self->mms_modem = (path && path[0]) ? ofono_modem_new(path) : NULL;
+    ofonoext_mm_update_imsi_index(self);
+    ofonoext_mm_emit(self, SIGNAL_MMS_MODEM_CHANGED);
+}
+
+static
+void
+ofonoext_mm_ready_changed(
+    OrgNemomobileOfonoModemManager* proxy,
+    gboolean ready,
+    gpointer data)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    ofonoext_mm_record_ready(self, ready);
+    self->ready = ready;
+    ofonoext_mm_emit(self, SIGNAL_READY_CHANGED);
+}
+
+static
+const char*
+ofonoext_mm_modem_path(
+    OfonoModem* modem)
+{
+    return modem ? modem->object.path : "";
+}
+
+static
+void
+ofonoext_mm_apply_str(
+    OfonoExtModemManager* self,
+    enum proxy_handler_id id,
+    const char* str,
+    gboolean refresh)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+    OrgNemomobileOfonoModemManager* proxy = priv->proxy;
+
+    switch (id) {
+    case PROXY_SIGNAL_DATA_IMSI_CHANGED:
+        if (!refresh || !ofonoext_mm_imsi_equal_str(&priv->data_imsi, str)) {
+            ofonoext_mm_default_data_sim_changed(proxy, str, self);
+        }
+        break;
+    case PROXY_SIGNAL_DATA_MODEM_CHANGED:
+        if (!refresh ||
+            strcmp(str, ofonoext_mm_modem_path(self->data_modem))) {
+            ofonoext_mm_default_data_modem_changed(proxy, str, self);
+        }
+        break;
+    case PROXY_SIGNAL_VOICE_IMSI_CHANGED:
+        if (!refresh || !ofonoext_mm_imsi_equal_str(&priv->voice_imsi, str)) {
+            ofonoext_mm_default_voice_sim_changed(proxy, str, self);
+        }
+        break;
+    case PROXY_SIGNAL_VOICE_MODEM_CHANGED:
+        if (!refresh ||
+            strcmp(str, ofonoext_mm_modem_path(self->voice_modem))) {
+            ofonoext_mm_default_voice_modem_changed(proxy, str, self);
+        }
+        break;
+    case PROXY_SIGNAL_MMS_IMSI_CHANGED:
+        if (!refresh || !ofonoext_mm_imsi_equal_str(&priv->mms_imsi, str)) {
+            ofonoext_mm_mms_sim_changed(proxy, str, self);
+        }
+        break;
+    case PROXY_SIGNAL_MMS_MODEM_CHANGED:
+        if (!refresh ||
+            strcmp(str, ofonoext_mm_modem_path(self->mms_modem))) {
+            ofonoext_mm_mms_modem_changed(proxy, str, self);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static
+void
+ofonoext_mm_apply(
+    OfonoExtModemManager* self,
+    enum proxy_handler_id id,
+    GVariant* args,
+    gboolean refresh)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+    OrgNemomobileOfonoModemManager* proxy = priv->proxy;
+    const struct ofonoext_mm_proxy_signal* sig =
+        ofonoext_mm_proxy_signals + id;
+    const char* type = refresh ? sig->getter_type : sig->signal_type;
+    const char* str = NULL;
+
+    if (!g_variant_is_of_type(args, G_VARIANT_TYPE(type))) {
+        GERR("Unexpected %s type %s", refresh ? sig->getter : sig->signal,
+            g_variant_get_type_string(args));
+        return;
+    }
+
+    /* A refresh only emits signals for the values that have changed */
+    switch (id) {
+    case PROXY_SIGNAL_ENABLED_MODEMS_CHANGED:
+        {
+            char** modems = NULL;
+
+            g_variant_get(args, "(^ao)", &modems);
+            if (!refresh || !gutil_strv_equal(modems, priv->enabled)) {
+                ofonoext_mm_enabled_modems_changed(proxy, modems, self);
+            }
+            g_strfreev(modems);
+        }
+        return;
+    case PROXY_SIGNAL_PRESENT_SIMS_CHANGED:
+        if (refresh) {
+            GVariant* present_sims = g_variant_get_child_value(args, 0);
+            const guint n = MIN(g_variant_n_children(present_sims),
+                self->modem_count);
+            guint i;
+
+            for (i=0; i<n; i++) {
+                GVariant* v = g_variant_get_child_value(present_sims, i);
+                const gboolean present = g_variant_get_boolean(v);
+
+                g_variant_unref(v);
+                if (present != priv->present_sims[i]) {
+                    ofonoext_mm_present_sims_changed(proxy, i, present, self);
+                }
+            }
+            g_variant_unref(present_sims);
+        } else {
+            gint index;
+            gboolean present;
+
+            g_variant_get(args, "(ib)", &index, &present);
+            ofonoext_mm_present_sims_changed(proxy, index, present, self);
+        }
+        return;
+    case PROXY_SIGNAL_READY_CHANGED:
+        {
+            gboolean ready;
+
+            g_variant_get(args, "(b)", &ready);
+            if (!refresh || ready != self->ready) {
+                ofonoext_mm_ready_changed(proxy, ready, self);
+            }
+        }
+        return;
+    default:
+        g_variant_get(args, "(&s)", &str);
+        ofonoext_mm_apply_str(self, id, str, refresh);
+        break;
+    }
+}
+
+static
+void
+ofonoext_mm_apply_delta(
+    OfonoExtModemManager* self,
+    const OfonoExtModemManagerDelta* delta)
+{
+    OrgNemomobileOfonoModemManager* proxy = self->priv->proxy;
+
+    switch (delta->id) {
+    case PROXY_SIGNAL_ENABLED_MODEMS_CHANGED:
+        ofonoext_mm_enabled_modems_changed(proxy, delta->strv, self);
+        break;
+    case PROXY_SIGNAL_PRESENT_SIMS_CHANGED:
+        ofonoext_mm_present_sims_changed(proxy, delta->index, delta->flag,
+            self);
+        break;
+    case PROXY_SIGNAL_READY_CHANGED:
+        ofonoext_mm_ready_changed(proxy, delta->flag, self);
+        break;
+    default:
+        ofonoext_mm_apply_str(self, delta->id, delta->str, FALSE);
+        break;
+    }
+}
+
+/* Default context */
+static
+gboolean
+ofonoext_mm_worker_dispatch(
+    GSource* source,
+    GSourceFunc callback,
+    gpointer data)
+{
+    OfonoExtModemManager* self =
+        ((OfonoExtModemManagerWorkerSource*)source)->mm;
+    OfonoExtModemManagerPriv* priv = self->priv;
+    OfonoExtModemManagerWorker* worker = priv->worker;
+    OfonoExtModemManagerDelta* delta;
+
+    /* Anything pushed from now on will wake us up again */
+    g_source_set_ready_time(source, -1);
+    g_atomic_int_set(&worker->wakeup, FALSE);
+
+    /* Handlers may drop the last reference */
+    ofonoext_mm_ref(self);
+    while ((delta = ofonoext_ring_pop(worker->queue)) != NULL) {
+        if (delta->refresh) {
+            /* Replies from before the last reset are dropped */
+            ofonoext_mm_refresh_complete(delta->refresh, delta->args,
+                delta->error, delta->epoch == priv->epoch);
+            delta->error = NULL;
+        } else {
+            priv->counters.signals++;
+            if (delta->epoch == priv->epoch) {
+                if (self->valid) {
+                    ofonoext_mm_apply_delta(self, delta);
+                } else {
+                    /* May be newer than the GetAll reply */
+                    priv->missed |= (1 << delta->id);
+                }
+            }
+        }
+        ofonoext_mm_delta_free(delta);
+    }
+    /* Once per dispatch, not per delta */
+    g_mutex_lock(&worker->mutex);
+    if (worker->blocked) {
+        worker->blocked = FALSE;
+        g_cond_signal(&worker->drained);
+    }
+    g_mutex_unlock(&worker->mutex);
+    ofonoext_mm_unref(self);
+    return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs ofonoext_mm_worker_source_funcs = {
+    NULL, NULL, ofonoext_mm_worker_dispatch, NULL
+};
+
+static
+OfonoExtModemManagerWorker*
+ofonoext_mm_worker_new(
+    OfonoExtModemManager* self)
+{
+    OfonoExtModemManagerWorker* worker = g_new0(OfonoExtModemManagerWorker,
+        1);
+    GSource* source = g_source_new(&ofonoext_mm_worker_source_funcs,
+        sizeof(OfonoExtModemManagerWorkerSource));
+
+    ((OfonoExtModemManagerWorkerSource*)source)->mm = self;
+    g_source_attach(source, NULL);
+    worker->source = source;
+    worker->queue = ofonoext_ring_new(MM_WORKER_QUEUE_SIZE);
+    g_mutex_init(&worker->mutex);
+    g_cond_init(&worker->drained);
+    worker->thread = ofonoext_worker_new("ofonoext-mm");
+    return worker;
+}
+
+static
+void
+ofonoext_mm_worker_free(
+    OfonoExtModemManagerWorker* worker)
+{
+    if (worker) {
+        /* Releases the worker if it's blocked in ofonoext_mm_worker_push */
+        g_mutex_lock(&worker->mutex);
+        g_atomic_int_set(&worker->quit, TRUE);
+        g_cond_signal(&worker->drained);
+        g_mutex_unlock(&worker->mutex);
+        /* Waits for the pending unsubscribe calls */
+        ofonoext_worker_free(worker->thread);
+        g_source_destroy(worker->source);
+        g_source_unref(worker->source);
+        ofonoext_ring_free(worker->queue, ofonoext_mm_delta_free);
+        g_cond_clear(&worker->drained);
+        g_mutex_clear(&worker->mutex);
+        g_free(worker);
+    }
+}
+
+static
+void
+ofonoext_mm_dbus_signal(
+    GDBusConnection* bus,
+    const char* sender,
+    const char* path,
+    const char* iface,
+    const char* name,
+    GVariant* args,
+    gpointer data)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    int i;
+
+    self->priv->counters.signals++;
+
+    /* Whatever arrives before the GetAll reply is included into it */
+    if (!self->valid) {
+        return;
+    }
+    for (i=0; i<PROXY_SIGNAL_COUNT; i++) {
+        if (!strcmp(name, ofonoext_mm_proxy_signals[i].signal)) {
+            ofonoext_mm_apply(self, i, args, FALSE);
+            break;
+        }
+    }
+}
+
+/* Takes ownership of the error but not of the arguments */
+static
+void
+ofonoext_mm_refresh_complete(
+    OfonoExtModemManagerRefreshData* refresh,
+    GVariant* args,
+    GError* error,
+    gboolean current)
+{
+    OfonoExtModemManagerRefreshAll* all = refresh->all;
+    OfonoExtModemManager* self = refresh->mm;
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    if (args) {
+        if (current) {
+            /* The value is only current if nobody has unsubscribed since */
+            if (priv->proxy_signal_id[refresh->id]) {
+                priv->stale &= ~(1 << refresh->id);
+                ofonoext_mm_apply(self, refresh->id, args, TRUE);
+            } else if (all) {
+                ofonoext_mm_apply(self, refresh->id, args, TRUE);
+            }
+        }
+    } else {
+#if GUTIL_LOG_ERR
+        if (error->code == G_IO_ERROR_CANCELLED) {
+            GDEBUG("%s", GERRMSG(error));
+        } else {
+            GERR("%s", GERRMSG(error));
+        }
+#endif
+        ofonoext_mm_count_error(self, error);
+        if (all && !all->error) {
+            all->error = error;
+        } else {
+            g_error_free(error);
+        }
+    }
+    if (all && !--all->pending) {
+        if (all->error) {
+            g_task_return_error(all->task, all->error);
+        } else {
+            g_task_return_boolean(all->task, TRUE);
+        }
+        g_object_unref(all->task);
+        g_slice_free(OfonoExtModemManagerRefreshAll, all);
+    }
+    ofonoext_mm_unref(self);
+    g_slice_free(OfonoExtModemManagerRefreshData, refresh);
+}
+
+static
+void
+ofonoext_mm_refresh_done(
+    GObject* proxy,
+    GAsyncResult* result,
+    gpointer data)
+{
+    OfonoExtModemManagerRefreshData* refresh = data;
+    GError* error = NULL;
+    GVariant* args = g_dbus_proxy_call_finish(G_DBUS_PROXY(proxy), result,
+        &error);
+
+    /* Ignore the replies from a proxy which is already gone */
+    ofonoext_mm_refresh_complete(refresh, args, error,
+        proxy == (GObject*)refresh->mm->priv->proxy);
+    if (args) {
+        g_variant_unref(args);
+    }
+}
+
+static
+gboolean
+ofonoext_mm_refresh_full(
+    OfonoExtModemManager* self,
+    enum proxy_handler_id id,
+    GCancellable* cancel,
+    OfonoExtModemManagerRefreshAll* all)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+    const struct ofonoext_mm_proxy_signal* sig =
+        ofonoext_mm_proxy_signals + id;
+
+    if (priv->version >= sig->version) {
+        OfonoExtModemManagerRefreshData* refresh =
+            g_slice_new(OfonoExtModemManagerRefreshData);
+
+        GDEBUG("Refreshing %s", sig->getter);
+        if (!cancel) {
+            if (!priv->refresh) {
+                priv->refresh = g_cancellable_new();
+            }
+            cancel = priv->refresh;
+        }
+        refresh->mm = ofonoext_mm_ref(self);
+        refresh->id = id;
+        refresh->all = all;
+        priv->counters.calls++;
+        if (priv->worker) {
+            /* Keeps the reply in order with the signals */
+            ofonoext_mm_worker_post_refresh(self, refresh, cancel);
+        } else {
+            g_dbus_proxy_call(G_DBUS_PROXY(priv->proxy), sig->getter, NULL,
+                G_DBUS_CALL_FLAGS_NONE, -1, cancel,
+                ofonoext_mm_refresh_done, refresh);
+        }
+        return TRUE;
+    } else {
+        /* The server doesn't have this property, nothing to refresh */
+        priv->stale &= ~(1 << id);
+        return FALSE;
+    }
+}
+
+static
+void
+ofonoext_mm_refresh(
+    OfonoExtModemManager* self,
+    enum proxy_handler_id id)
+{
+    ofonoext_mm_refresh_full(self, id, NULL, NULL);
+}
+
+static
+gboolean
+ofonoext_mm_signal_wanted(
+    OfonoExtModemManager* self,
+    enum proxy_handler_id id)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    if (priv->on_demand && !priv->recorder) {
+        const guint demand = ofonoext_mm_proxy_signals[id].demand;
+        int i;
+
+        /* Signal bits and OFONOEXT_MM_CHANGED bits are the same */
+        if (demand & ofonoext_mm_batch_mask(self)) {
+            return TRUE;
+        }
+        for (i=0; i<SIGNAL_COUNT; i++) {
+            if ((demand & (1 << i)) && g_signal_has_handler_pending(self,
+                ofonoext_mm_signals[i], 0, TRUE)) {
+                return TRUE;
+            }
+        }
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static
+void
+ofonoext_mm_subscribe(
+    OfonoExtModemManager* self,
+    GDBusConnection* bus,
+    enum proxy_handler_id id)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    if (priv->worker) {
+        /* The real subscription id is only known to the worker thread */
+        ofonoext_mm_worker_post(self, bus, id, TRUE);
+        priv->proxy_signal_id[id] = id + 1;
+    } else {
+        priv->proxy_signal_id[id] = g_dbus_connection_signal_subscribe(bus,
+            priv->service, MM_INTERFACE, ofonoext_mm_proxy_signals[id].signal,
+            priv->path, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+            ofonoext_mm_dbus_signal, self, NULL);
+    }
+}
+
+static
+void
+ofonoext_mm_update_subscriptions(
+    OfonoExtModemManager* self)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    /*
+     * Subscriptions exist as long as the proxy does. They are made before
+     * GetAll is sent, so that nothing emitted after the GetAll reply can
+     * slip through. Until the manager is valid there's nothing to refresh,
+     * GetAll will fetch everything anyway.
+     */
+    if (priv->proxy) {
+        GDBusConnection* bus = g_dbus_proxy_get_connection
+            (G_DBUS_PROXY(priv->proxy));
+        int i;
+
+        for (i=0; i<PROXY_SIGNAL_COUNT; i++) {
+            const gboolean wanted = ofonoext_mm_signal_wanted(self, i);
+
+            if (wanted && !priv->proxy_signal_id[i]) {
+                GDEBUG("Subscribing to %s", ofonoext_mm_proxy_signals[i].
+                    signal);
+                ofonoext_mm_subscribe(self, bus, i);
+                if (self->valid && (priv->stale & (1 << i))) {
+                    ofonoext_mm_refresh(self, i);
+                }
+            } else if (!wanted && priv->proxy_signal_id[i]) {
+                GDEBUG("Unsubscribing from %s", ofonoext_mm_proxy_signals[i].
+                    signal);
+                ofonoext_mm_unsubscribe(self, bus, i);
+                priv->stale |= (1 << i);
+            }
+        }
+    }
+}
+
+static
+void
+ofonoext_mm_init_done(
+    OfonoExtModemManager* self,
+    GStrV* available,
+    GStrV* enabled,
+    char* data_imsi,
+    char* voice_imsi,
+    const char* data_path,
+    const char* voice_path,
+    GVariant* present_sims,
+    GStrV* imei,
+    char* mms_imsi,
+    const char* mms_path,
+    gboolean ready)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+    OfonoModem* voice_modem;
+    OfonoModem* data_modem;
+    OfonoModem* mms_modem;
+    gboolean* present = NULL;
+    int k;
+
+    /* Keys point to the strings which are about to be freed */
+    ofonoext_mm_clear_indexes(self);
+    self->modem_count = gutil_strv_length(available);
+    self->ready = ready;
+    if (present_sims) {
+        const guint n = g_variant_n_children(present_sims);
+        guint i;
+
+        GASSERT(self->modem_count == n);
+        present = g_newa(gboolean, self->modem_count);
+        for (i=0; i<self->modem_count; i++) {
+            if (i < n) {
+                GVariant* v = g_variant_get_child_value(present_sims, i);
+                present[i] = g_variant_get_boolean(v);
+                g_variant_unref(v);
+            } else {
+                present[i] = FALSE;
+            }
+        }
+    }
+
+    /* The whole snapshot is a single allocation */
+    ofonoext_arena_free(ofonoext_mm_pack(self, available, enabled, imei,
+        present));
+    self->data_imsi = ofonoext_mm_imsi_set(&priv->data_imsi, data_imsi);
+    self->voice_imsi = ofonoext_mm_imsi_set(&priv->voice_imsi, voice_imsi);
+    self->mms_imsi = ofonoext_mm_imsi_set(&priv->mms_imsi, mms_imsi);
+    g_strfreev(available);
+    g_strfreev(enabled);
+    g_strfreev(imei);
+    g_free(data_imsi);
+    g_free(voice_imsi);
+    g_free(mms_imsi);
+
+    /* The modem could be the same, so unref the current one after selecting
+     * the new one, to avoid unnecessary deallocations */
+    voice_modem = self->voice_modem;
+    self->voice_modem = (voice_path && voice_path[0]) ?
+        ofono_modem_new(voice_path) : NULL;
+
+    data_modem = self->data_modem;
+    self->data_modem = (data_path && data_path[0]) ?
+        ofono_modem_new(data_path) : NULL;
+
+    mms_modem = self->mms_modem;
+    self->mms_modem = (mms_path && mms_path[0]) ?
+        ofono_modem_new(mms_path) : NULL;
+
+    ofono_modem_unref(voice_modem);
+    ofono_modem_unref(data_modem);
+    ofono_modem_unref(mms_modem);
+
+    ofonoext_mm_update_sim_counts(self, FALSE);
+    ofonoext_mm_build_indexes(self);
+    if (priv->prefetch) {
+        ofonoext_mm_prefetch_start(self);
+    }
+    ofonoext_mm_record_state(self);
+
+    /* GetAll has only fetched what's being tracked from now on */
+    priv->stale = 0;
+    for (k=0; k<PROXY_SIGNAL_COUNT; k++) {
+        if (!priv->proxy_signal_id[k]) {
+            priv->stale |= (1 << k);
+        }
+    }
+
+    /* And the worker may have dropped something newer than GetAll */
+    priv->stale |= priv->missed;
+
+    /*
+     * Only valid-changed is emitted but all the other properties (except
+     * for slots-warm) have been replaced too, and share its generation.
+     */
+    GASSERT(!self->valid);
+    for (k=0; k<SIGNAL_COUNT; k++) {
+        if (k != SIGNAL_SLOTS_WARM) {
+            priv->changed_gen[k] = priv->generation + 1;
+        }
+    }
+    ofonoext_mm_set_valid(self, TRUE);
+
+    /* Subscribe for whatever has become wanted since GetAll */
+    ofonoext_mm_update_subscriptions(self);
+    for (k=0; k<PROXY_SIGNAL_COUNT && priv->missed; k++) {
+        if ((priv->missed & (1 << k)) && priv->proxy_signal_id[k] &&
+            (priv->stale & (1 << k))) {
+            ofonoext_mm_refresh(self, k);
+        }
+    }
+    priv->missed = 0;
+    ofonoext_mm_check_warm(self);
+}
+
+static
+void
+ofonoext_mm_get_all_finish(
+    GObject* proxy,
+    GAsyncResult* result,
+    gpointer data,
+    gboolean (*finish_call)(
+        OrgNemomobileOfonoModemManager* proxy,
+        gint* version,
+        gchar*** available,
+        gchar*** enabled,
+        gchar** data_imsi,
+        gchar** voice_imsi,
+        gchar** data_modem,
+        gchar** voice_modem,
+        GVariant** present_sims,
+        gchar*** imei,
+        gchar** mms_imsi,
+        gchar** mms_modem,
+        gboolean* ready,
+        GAsyncResult* res,
+        GError **error))
+{
+    GError* error = NULL;
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    OfonoExtModemManagerPriv* priv = self->priv;
+    int version = 0;
+    char** available = NULL;
+    char** enabled = NULL;
+    char* data_imsi = NULL;
+    char* voice_imsi = NULL;
+    char* mms_imsi = NULL;
+    char* data_path = NULL;
+    char* voice_path = NULL;
+    char* mms_path = NULL;
+    GVariant* present_sims = NULL;
+    char** imei = NULL;
+    gboolean ready = TRUE;
+
+    GASSERT(!self->valid);
+    GASSERT(priv->cancel);
+    g_object_unref(priv->cancel);
+    priv->cancel = NULL;
+    if (finish_call(ORG_NEMOMOBILE_OFONO_MODEM_MANAGER(proxy), &version,
+        &available, &enabled, &data_imsi, &voice_imsi, &data_path,
+        &voice_path, &present_sims, &imei, &mms_imsi, &mms_path, &ready,
+        result, &error)) {
+        /* This call is only made for interface versions 2 and later */
+        GASSERT(version > 1);
+        /* ofonoext_mm_init_done takes ownership of all the pointers except
+         * data_path, voice_path, mms_path and present_sims */
+        ofonoext_mm_init_done(self, available, enabled, data_imsi, voice_imsi,
+            data_path, voice_path, present_sims, imei, mms_imsi, mms_path,
+            ready);
+    } else {
+        g_strfreev(available);
+        g_strfreev(enabled);
+        g_free(data_imsi);
+        g_free(voice_imsi);
+        g_strfreev(imei);
+#if GUTIL_LOG_ERR
+        if (error->code == G_IO_ERROR_CANCELLED) {
+            GDEBUG("%s", GERRMSG(error));
+        } else {
+            GERR("%s", GERRMSG(error));
+        }
+#endif
+        ofonoext_mm_count_error(self, error);
+
+        /* Retry the call */
+        if (ofonoext_mm_is_timeout(error)) {
+            ofonoext_mm_schedule_retry(self);
+        }
+    }
+    g_free(data_path);
+    g_free(voice_path);
+    g_free(mms_path);
+    ofonoext_mm_unref(self);
+    if (present_sims) g_variant_unref(present_sims);
+    if (error) g_error_free(error);
+}
+
+static
+void
+ofonoext_mm_get_all5_done(
+    GObject* proxy,
+    GAsyncResult* res,
+    gpointer data)
+{
+    ofonoext_mm_get_all_finish(proxy, res, data,
+        org_nemomobile_ofono_modem_manager_call_get_all5_finish);
+}
+
+static
+gboolean
+ofonoext_mm_get_all4_finish(
+    OrgNemomobileOfonoModemManager* proxy,
+    gint* version,
+    gchar*** available,
+    gchar*** enabled,
+    gchar** data_imsi,
+    gchar** voice_imsi,
+    gchar** data_path,
+    gchar** voice_path,
+    GVariant** present_sims,
+    gchar*** imei,
+    gchar** mms_imsi,
+    gchar** mms_path,
+    gboolean* ready,
+    GAsyncResult* res,
+    GError **error)
+{
+    *ready = TRUE;
+    return org_nemomobile_ofono_modem_manager_call_get_all4_finish(proxy,
+        version, available, enabled, data_imsi, voice_imsi, data_path,
+        voice_path, present_sims, imei, mms_imsi, mms_path, res, error);
+}
+
+static
+void
+ofonoext_mm_get_all4_done(
+    GObject* proxy,
+    GAsyncResult* res,
+    gpointer data)
+{
+    ofonoext_mm_get_all_finish(proxy, res, data, ofonoext_mm_get_all4_finish);
+}
+
+static
+gboolean
+ofonoext_mm_get_all3_finish(
+    OrgNemomobileOfonoModemManager* proxy,
+    gint* version,
+    gchar*** available,
+    gchar*** enabled,
+    gchar** data_imsi,
+    gchar** voice_imsi,
+    gchar** data_path,
+    gchar** voice_path,
+    GVariant** present_sims,
+    gchar*** imei,
+    gchar** mms_imsi,
+    gchar** mms_path,
+    gboolean* ready,
+    GAsyncResult* res,
+    GError **error)
+{
+    *mms_imsi = NULL;
+    *mms_path = NULL;
+    *ready = TRUE;
+    return org_nemomobile_ofono_modem_manager_call_get_all3_finish(proxy,
+        version, available, enabled, data_imsi, voice_imsi, data_path,
+        voice_path, present_sims, imei, res, error);
+}
+
+static
+void
+ofonoext_mm_get_all3_done(
+    GObject* proxy,
+    GAsyncResult* res,
+    gpointer data)
+{
+    ofonoext_mm_get_all_finish(proxy, res, data, ofonoext_mm_get_all3_finish);
+}
+
+static
+gboolean
+ofonoext_mm_get_all2_finish(
+    OrgNemomobileOfonoModemManager* proxy,
+    gint* version,
+    gchar*** available,
+    gchar*** enabled,
+    gchar** data_imsi,
+    gchar** voice_imsi,
+    gchar** data_path,
+    gchar** voice_path,
+    GVariant** present_sims,
+    gchar*** imei,
+    gchar** mms_imsi,
+    gchar** mms_path,
+    gboolean* ready,
+    GAsyncResult* res,
+    GError **error)
+{
+    *imei = NULL;
+    *mms_imsi = NULL;
+    *mms_path = NULL;
+    *ready = TRUE;
+    return org_nemomobile_ofono_modem_manager_call_get_all2_finish(proxy,
+        version, available, enabled, data_imsi, voice_imsi, data_path,
+        voice_path, present_sims, res, error);
+}
+
+static
+void
+ofonoext_mm_get_all2_done(
+    GObject* proxy,
+    GAsyncResult* res,
+    gpointer data)
+{
+    ofonoext_mm_get_all_finish(proxy, res, data, ofonoext_mm_get_all2_finish);
+}
+
+static
+void
+ofonoext_mm_get_allx(
+    OfonoExtModemManager* self)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    GASSERT(!self->valid);
+    GASSERT(!priv->cancel);
+    GASSERT(priv->version > 1);
+   
+    priv->cancel = g_cancellable_new();
+    priv->counters.calls++;
+    ofonoext_mm_ref(self);
+    switch (priv->version) {
+    case 2:
+        /* Request version 2 settings */
+        org_nemomobile_ofono_modem_manager_call_get_all2(priv->proxy,
+            priv->cancel, ofonoext_mm_get_all2_done, self);
+        break;
+    case 3:
+        /* Request version 3 settings */
+        org_nemomobile_ofono_modem_manager_call_get_all3(priv->proxy,
+            priv->cancel, ofonoext_mm_get_all3_done, self);
+        break;
+    case 4:
+        /* Request version 4 settings */
+        org_nemomobile_ofono_modem_manager_call_get_all4(priv->proxy,
+            priv->cancel, ofonoext_mm_get_all4_done, self);
+        break;
+    case 5:
+    default:
+        /* Request version 5 settings */
+        org_nemomobile_ofono_modem_manager_call_get_all5(priv->proxy,
+            priv->cancel, ofonoext_mm_get_all5_done, self);
+        break;
+    }
+}
+
+static
+void
+ofonoext_mm_get_all_done(
+    GObject* proxy,
+    GAsyncResult* result,
+    gpointer data)
+{
+    GError* error = NULL;
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    OfonoExtModemManagerPriv* priv = self->priv;
+    int version = 0;
+    char** available = NULL;
+    char** enabled = NULL;
+    char* data_imsi = NULL;
+    char* voice_imsi = NULL;
+    char* data_path = NULL;
+    char* voice_path = NULL;
+
+    GASSERT(!self->valid);
+    GASSERT(priv->cancel);
+    g_object_unref(priv->cancel);
+    priv->cancel = NULL;
+    if (org_nemomobile_ofono_modem_manager_call_get_all_finish(
+        ORG_NEMOMOBILE_OFONO_MODEM_MANAGER(proxy), &version, &available,
+        &enabled, &data_imsi, &voice_imsi, &data_path, &voice_path,
+        result, &error)) {
+        GDEBUG("Interface version %d", version);
+        priv->version = version;
+        if (version == 1) {
+            /* ofonoext_mm_init_done takes the ownership of the arguments
+             * except for data_path and voice_path */
+            ofonoext_mm_init_done(self, available, enabled, data_imsi,
+                voice_imsi, data_path, voice_path, NULL, NULL, NULL, NULL,
+                TRUE);
+        } else {
+            g_strfreev(available);
+            g_strfreev(enabled);
+            g_free(data_imsi);
+            g_free(voice_imsi);
+            ofonoext_mm_get_allx(self);
+        }
+    } else {
+        g_strfreev(available);
+        g_strfreev(enabled);
+        g_free(data_imsi);
+        g_free(voice_imsi);
+#if GUTIL_LOG_ERR
+        if (error->code == G_IO_ERROR_CANCELLED) {
+            GDEBUG("%s", GERRMSG(error));
+        } else {
+            GERR("%s", GERRMSG(error));
+        }
+#endif
+        ofonoext_mm_count_error(self, error);
+
+        /* Retry the call */
+        if (ofonoext_mm_is_timeout(error)) {
+            ofonoext_mm_schedule_retry(self);
+        }
+    }
+    g_free(data_path);
+    g_free(voice_path);
+    ofonoext_mm_unref(self);
+    if (error) g_error_free(error);
+}
+
+static
+void
+ofonoext_mm_get_all(
+    OfonoExtModemManager* self)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    GASSERT(priv->cancel);
+    priv->counters.calls++;
+    org_nemomobile_ofono_modem_manager_call_get_all(priv->proxy,
+        priv->cancel, ofonoext_mm_get_all_done, self);
+}
+
+static
+gboolean
+ofonoext_mm_retry_cb(
+    gpointer data)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    GASSERT(!self->valid);
+    GASSERT(!priv->cancel);
+    GASSERT(priv->retry_timer_id);
+    priv->retry_timer_id = 0;
+
+    /* Bump the reference count for the duration of the D-Bus call */
+    ofonoext_mm_ref(self);
+    if (priv->version) {
+        ofonoext_mm_get_allx(self);
+    } else {
+        priv->cancel = g_cancellable_new();
+        ofonoext_mm_get_all(self);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+ofonoext_mm_schedule_retry(
+    OfonoExtModemManager* self)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    GASSERT(!priv->cancel);
+    GASSERT(!self->valid);
+    if (!priv->retry_timer_id) {
+        priv->counters.retries++;
+        priv->retry_timer_id = ofonoext_mm_add_timeout(self,
+            MM_RETRY_SEC * 1000, ofonoext_mm_retry_cb, self);
+    }
+}
+
+static
+void
+ofonoext_mm_proxy_created(
+    GObject* proxy,
+    GAsyncResult* result,
+    gpointer data)
+{
+    GError* error = NULL;
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    GASSERT(priv->cancel);
+    GASSERT(!self->valid);
+    GASSERT(!priv->proxy);
+    g_object_unref(priv->cancel);
+    priv->cancel = NULL;
+    priv->proxy =
+        org_nemomobile_ofono_modem_manager_proxy_new_finish(result, &error);
+    
+    if (priv->proxy) {
+        /* Subscribe first, then request current settings */
+        ofonoext_mm_update_subscriptions(self);
+        priv->cancel = g_cancellable_new();
+        if (priv->worker) {
+            /* The worker thread adds the match rules, wait for it */
+            ofonoext_worker_post(priv->worker->thread,
+                ofonoext_mm_worker_sync, self, NULL);
+        } else {
+            ofonoext_mm_get_all(self);
+        }
+    } else {
+#if GUTIL_LOG_ERR
+        if (error->code == G_IO_ERROR_CANCELLED) {
+            GDEBUG("%s", GERRMSG(error));
+        } else {
+            GERR("%s", GERRMSG(error));
+        }
+#endif
+        priv->counters.resets++;
+        ofonoext_mm_reset(self);
+        ofonoext_mm_unref(self);
+    }
+    if (error) g_error_free(error);
+}
+
+static
+void
+ofonoext_mm_name_appeared(
+    GDBusConnection* bus,
+    const gchar* name,
+    const gchar* owner,
+    gpointer arg)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(arg);
+    OfonoExtModemManagerPriv* priv = self->priv;
+    GDEBUG("Name '%s' is owned by %s", name, owner);
+    ofonoext_mm_record_string(self, OFONOEXT_RECORD_INPUT_NAME_APPEARED,
+        owner);
+
+    /* Start the initialization sequence */
+    GASSERT(!priv->cancel);
+    priv->cancel = g_cancellable_new();
+    org_nemomobile_ofono_modem_manager_proxy_new(bus,
+        G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
+        G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS, priv->service, priv->path,
+        priv->cancel, ofonoext_mm_proxy_created, ofonoext_mm_ref(self));
+}
+
+static
+void
+ofonoext_mm_name_vanished(
+    GDBusConnection* bus,
+    const gchar* name,
+    gpointer arg)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(arg);
+    GDEBUG("Name '%s' has disappeared", name);
+    ofonoext_mm_record(self, OFONOEXT_RECORD_INPUT_NAME_VANISHED, NULL, 0);
+    self->priv->counters.resets++;
+    ofonoext_mm_reset(self);
+    ofonoext_mm_set_valid(self, FALSE);
+}
+
+static
+void
+ofonoext_mm_watch(
+    OfonoExtModemManager* self)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    GASSERT(priv->bus);
+    GASSERT(!priv->ofono_watch_id);
+    priv->ofono_watch_id = g_bus_watch_name_on_connection(priv->bus,
+        priv->service, G_BUS_NAME_WATCHER_FLAGS_NONE,
+        ofonoext_mm_name_appeared,
+        ofonoext_mm_name_vanished,
+        self, NULL);
+}
+
+static
+void
+ofonoext_mm_bus_connected(
+    OfonoExtModemManager* self,
+    GDBusConnection* bus,
+    GError* error)
+{
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    GASSERT(!priv->cancel);
+    GASSERT(!self->valid);
+    GASSERT(!priv->proxy);
+    priv->bus = bus;
+    if (priv->bus) {
+        GDEBUG("Bus connected");
+        ofonoext_mm_watch(self);
+    } else {
+        GERR("%s", GERRMSG(error));
+        g_error_free(error);
+    }
+    ofonoext_mm_unref(self);
+}
+
+static
+void
+ofonoext_mm_bus(
+    GObject* proxy,
+    GAsyncResult* result,
+    gpointer data)
+{
+    GError* error = NULL;
+
+    ofonoext_mm_bus_connected(OFONOEXT_MODEM_MANAGER(data),
+        g_bus_get_finish(result, &error), error);
+}
+
+static
+void
+ofonoext_mm_private_bus_done(
+    GObject* object,
+    GAsyncResult* result,
+    gpointer data)
+{
+    GError* error = NULL;
+
+    ofonoext_mm_bus_connected(OFONOEXT_MODEM_MANAGER(data),
+        g_dbus_connection_new_for_address_finish(result, &error), error);
+}
+
+/* Same bus as g_bus_get() would return, but not shared with anyone */
+static
+void
+ofonoext_mm_private_bus(
+    OfonoExtModemManager* self)
+{
+    GError* error = NULL;
+    char* address = g_dbus_address_get_for_bus_sync(OFONO_BUS_TYPE, NULL,
+        &error);
+
+    if (address) {
+        GDEBUG("Opening private connection to %s", address);
+        g_dbus_connection_new_for_address(address,
+            G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+            G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION, NULL, NULL,
+            ofonoext_mm_private_bus_done, ofonoext_mm_ref(self));
+        g_free(address);
+    } else {
+        GERR("%s", GERRMSG(error));
+        g_error_free(error);
+    }
+}
+
+static
+void
+ofonoext_mm_start_recording_env(
+    OfonoExtModemManager* self,
+    const char* spec)
+{
+    const char* sep = strrchr(spec, ':');
+    char* file = sep ? g_strndup(spec, sep - spec) : g_strdup(spec);
+    gsize size = sep ? (gsize)g_ascii_strtoull(sep + 1, NULL, 0) : 0;
+    GError* error = NULL;
+
+    if (!ofonoext_mm_start_recording(self, file, size, &error)) {
+        GERR("%s", GERRMSG(error));
+        g_error_free(error);
+    }
+    g_free(file);
+}
+
+/*==========================================================================*
+ * Scenario
+ *==========================================================================*/
+
+static
+gboolean
+ofonoext_mm_scenario_bool(
+    const char* str,
+    gboolean* value)
+{
+    if (!strcmp(str, "true") || !strcmp(str, "1")) {
+        *value = TRUE;
+        return TRUE;
+    } else if (!strcmp(str, "false") || !strcmp(str, "0")) {
+        *value = FALSE;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/* Converts the step into the arguments of the D-Bus signal */
+static
+GVariant*
+ofonoext_mm_scenario_args(
+    const OfonoExtScenarioStep* step,
+    enum proxy_handler_id* id,
+    GError** error)
+{
+    const GStrV* args = step->args;
+    const guint n = gutil_strv_length(args);
+    int i;
+
+    for (i=0; i<PROXY_SIGNAL_COUNT; i++) {
+        if (!strcmp(ofonoext_mm_proxy_signals[i].signal, step->signal)) {
+            gboolean b;
+            guint j;
+
+            *id = i;
+            switch (i) {
+            case PROXY_SIGNAL_ENABLED_MODEMS_CHANGED:
+                for (j=0; j<n && g_variant_is_object_path(args[j]); j++);
+                if (j == n) {
+                    return g_variant_ref_sink(g_variant_new("(^ao)", args));
+                }
+                break;
+            case PROXY_SIGNAL_PRESENT_SIMS_CHANGED:
+                if (n == 2 && g_ascii_isdigit(args[0][0]) &&
+                    ofonoext_mm_scenario_bool(args[1], &b)) {
+                    return g_variant_ref_sink(g_variant_new("(ib)",
+                        (gint)g_ascii_strtoll(args[0], NULL, 10), b));
+                }
+                break;
+            case PROXY_SIGNAL_READY_CHANGED:
+                if (n == 1 && ofonoext_mm_scenario_bool(args[0], &b)) {
+                    return g_variant_ref_sink(g_variant_new("(b)", b));
+                }
+                break;
+            default:
+                if (n <= 1) {
+                    return g_variant_ref_sink(g_variant_new("(s)",
+                        n ? args[0] : ""));
+                }
+                break;
+            }
+            g_set_error(error, G_KEY_FILE_ERROR,
+                G_KEY_FILE_ERROR_INVALID_VALUE, "Invalid %s arguments "
+                "at %u ms", step->signal, step->time);
+            return NULL;
+        }
+    }
+    g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_KEY_NOT_FOUND,
+        "Unknown signal %s at %u ms", step->signal, step->time);
+    return NULL;
+}
+
+static
+void
+ofonoext_mm_scenario_free(
+    OfonoExtModemManagerScenario* scenario)
+{
+    if (scenario) {
+        if (scenario->events) {
+            guint i;
+
+            for (i=0; i<scenario->data->nsteps; i++) {
+                if (scenario->events[i].args) {
+                    g_variant_unref(scenario->events[i].args);
+                }
+            }
+            g_free(scenario->events);
+        }
+        if (scenario->timer_id) {
+            g_source_remove(scenario->timer_id);
+        }
+        ofonoext_scenario_free(scenario->data);
+        g_free(scenario);
+    }
+}
+
+static
+OfonoExtModemManagerScenario*
+ofonoext_mm_scenario_new(
+    const char* file,
+    GError** error)
+{
+    OfonoExtScenario* data = ofonoext_scenario_load(file, error);
+
+    if (data) {
+        OfonoExtModemManagerScenario* scenario =
+            g_new0(OfonoExtModemManagerScenario, 1);
+        guint i;
+
+        scenario->data = data;
+        scenario->events = g_new0(OfonoExtModemManagerScenarioEvent,
+            data->nsteps);
+        for (i=0; i<data->nsteps; i++) {
+            OfonoExtModemManagerScenarioEvent* event = scenario->events + i;
+
+            event->time = data->steps[i].time;
+            event->args = ofonoext_mm_scenario_args(data->steps + i,
+                &event->id, error);
+            if (!event->args) {
+                ofonoext_mm_scenario_free(scenario);
+                return NULL;
+            }
+        }
+        return scenario;
+    }
+    return NULL;
+}
+
+static
+void
+ofonoext_mm_scenario_schedule(
+    OfonoExtModemManager* self)
+{
+    OfonoExtModemManagerScenario* scenario = self->priv->scenario;
+
+    if (scenario->pos < scenario->data->nsteps) {
+        const gint64 due = scenario->start +
+            (gint64)scenario->events[scenario->pos].time * 1000;
+        const gint64 now = g_get_monotonic_time();
+
+        GASSERT(!scenario->timer_id);
+        scenario->timer_id = ofonoext_mm_add_timeout(self, (due > now) ?
+            (guint)((due - now + 999) / 1000) : 0,
+            ofonoext_mm_scenario_step, self);
+    }
+}
+
+static
+gboolean
+ofonoext_mm_scenario_step(
+    gpointer data)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    OfonoExtModemManagerScenario* scenario = self->priv->scenario;
+    const OfonoExtScenario* info = scenario->data;
+    const gint64 now = g_get_monotonic_time();
+
+    /* The handlers may drop the last reference */
+    ofonoext_mm_ref(self);
+    scenario->timer_id = 0;
+    while (scenario->pos < info->nsteps) {
+        const OfonoExtModemManagerScenarioEvent* event =
+            scenario->events + scenario->pos;
+
+        if (scenario->start + (gint64)event->time * 1000 > now) {
+            break;
+        }
+        scenario->pos++;
+        self->priv->counters.signals++;
+        ofonoext_mm_apply(self, event->id, event->args, FALSE);
+        if (scenario->pos == info->nsteps && info->loop) {
+            /* A zero period would never let go of the main loop */
+            scenario->pos = 0;
+            scenario->start += (gint64)MAX(info->period, 1) * 1000;
+        }
+    }
+    ofonoext_mm_scenario_schedule(self);
+    ofonoext_mm_unref(self);
+    return G_SOURCE_REMOVE;
+}
+
+static
+gboolean
+ofonoext_mm_scenario_start(
+    gpointer data)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
+    OfonoExtModemManagerScenario* scenario = self->priv->scenario;
+    const OfonoExtScenario* info = scenario->data;
+    const guint n = gutil_strv_length(info->available);
+    GVariantBuilder builder;
+    GVariant* present_sims;
+    guint i;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("ab"));
+    for (i=0; i<n; i++) {
+        g_variant_builder_add(&builder, "b", info->present_sims[i]);
+    }
+    present_sims = g_variant_ref_sink(g_variant_builder_end(&builder));
+
+    /* Same as if GetAll has completed, the timeline starts from here */
+    ofonoext_mm_ref(self);
+    scenario->timer_id = 0;
+    scenario->start = g_get_monotonic_time();
+    ofonoext_mm_init_done(self, g_strdupv(info->available),
+        g_strdupv(info->enabled), g_strdup(info->data_imsi),
+        g_strdup(info->voice_imsi), info->data_modem, info->voice_modem,
+        present_sims, g_strdupv(info->imei), g_strdup(info->mms_imsi),
+        info->mms_modem, info->ready);
+    g_variant_unref(present_sims);
+    ofonoext_mm_scenario_schedule(self);
+    ofonoext_mm_unref(self);
+    return G_SOURCE_REMOVE;
+}
+
+/*==========================================================================*
+ * API
+ *==========================================================================*/
+
+static
+OfonoExtModemManager*
+ofonoext_mm_create(
+    GDBusConnection* bus,
+    const char* service,
+    const char* path,
+    OFONOEXT_MM_FLAGS flags)
+{
+    OfonoExtModemManager* mm = NULL;
+    OfonoExtModemManagerKey key;
+    gboolean is_default;
+
+    key.bus = bus;
+    key.service = service ? service : OFONO_SERVICE;
+    key.path = path ? path : "/";
+    key.flags = flags;
+    is_default = !bus && !flags && !strcmp(key.service, OFONO_SERVICE) &&
+        !strcmp(key.path, "/");
+
+    /*
+     * Fast path, doesn't take ofonoext_mm_mutex. It's not lock-free
+     * though, before 2.80 g_weak_ref_get() takes GObject's process-wide
+     * weak ref lock (for reading). Still cheaper than the table lookup
+     * and safe against the last reference being dropped concurrently.
+     */
+    if (is_default) {
+        mm = g_weak_ref_get(&ofonoext_mm_default);
+        if (mm) {
+            return mm;
+        }
+    }
+
+    if (g_once_init_enter(&ofonoext_mm_table)) {
+        g_once_init_leave(&ofonoext_mm_table, g_hash_table_new(
+            ofonoext_mm_key_hash, ofonoext_mm_key_equal));
+    }
+
+    /* Check the table again under the lock */
+    g_mutex_lock(&ofonoext_mm_mutex);
+    mm = g_hash_table_lookup(ofonoext_mm_table, &key);
+    if (mm) {
+        /*
+         * Returns NULL if the last reference is being dropped. The
+         * memory is still there, dispose is waiting for the mutex.
+         */
+        mm = g_weak_ref_get(&mm->priv->ref);
+    }
+    if (mm) {
+        g_mutex_unlock(&ofonoext_mm_mutex);
+    } else {
+        OfonoExtModemManagerPriv* priv;
+
+        mm = g_object_new(OFONOEXT_TYPE_MODEM_MANAGER, NULL);
+        priv = mm->priv;
+        priv->key.bus = bus;
+        priv->key.service = priv->service = g_strdup(key.service);
+        priv->key.path = priv->path = g_strdup(key.path);
+        priv->key.flags = flags;
+        g_hash_table_replace(ofonoext_mm_table, &priv->key, mm);
+        if (is_default) {
+            g_weak_ref_set(&ofonoext_mm_default, mm);
+        }
+        g_mutex_unlock(&ofonoext_mm_mutex);
+
+        /* Several instances can't record into the same file */
+        if (is_default) {
+            const char* record = g_getenv(MM_RECORD_ENV);
+            const char* budget = g_getenv(MM_HANDLER_BUDGET_ENV);
+
+            if (record && record[0]) {
+                ofonoext_mm_start_recording_env(mm, record);
+            }
+            if (budget && budget[0]) {
+                ofonoext_mm_set_handler_timing(mm, TRUE,
+                    (guint)g_ascii_strtoull(budget, NULL, 0));
+            }
+        }
+
+        /* Unlike the recorder, the exporter takes any number of them */
+        ofonoext_exporter_add_from_env(mm);
+
+        if (flags & OFONOEXT_MM_FLAG_WORKER_THREAD) {
+            priv->worker = ofonoext_mm_worker_new(mm);
+        }
+
+        if (bus) {
+            priv->bus = g_object_ref(bus);
+            ofonoext_mm_watch(mm);
+        } else if (flags & OFONOEXT_MM_FLAG_PRIVATE_BUS) {
+            ofonoext_mm_private_bus(mm);
+        } else {
+            g_bus_get(OFONO_BUS_TYPE, NULL, ofonoext_mm_bus,
+                ofonoext_mm_ref(mm));
+        }
+    }
+    return mm;
+}
+
+OfonoExtModemManager*
+ofonoext_mm_new()
+{
+    return ofonoext_mm_create(NULL, NULL, NULL, OFONOEXT_MM_FLAGS_NONE);
+}
+
+OfonoExtModemManager*
+ofonoext_mm_new_full(
+    GDBusConnection* bus,
+    const char* service,
+    const char* path)
+{
+    return ofonoext_mm_create(bus, service, path, OFONOEXT_MM_FLAGS_NONE);
+}
+
+OfonoExtModemManager*
+ofonoext_mm_new_with_flags(
+    OFONOEXT_MM_FLAGS flags)
+{
+    return ofonoext_mm_create(NULL, NULL, NULL, flags);
+}
+
+OfonoExtModemManager*
+ofonoext_mm_new_from_scenario(
+    const char* file,
+    GError** error)
+{
+    OfonoExtModemManagerScenario* scenario =
+        ofonoext_mm_scenario_new(file, error);
+
+    if (scenario) {
+        OfonoExtModemManager* mm = g_object_new(OFONOEXT_TYPE_MODEM_MANAGER,
+            NULL);
+        OfonoExtModemManagerPriv* priv = mm->priv;
+
+        /* Becomes valid asynchronously, like the D-Bus backend */
+        priv->scenario = scenario;
+        scenario->timer_id = ofonoext_mm_add_timeout(mm,
+            scenario->data->delay, ofonoext_mm_scenario_start, mm);
+        return mm;
+    }
+    return NULL;
+}
+
+OfonoExtModemManager*
+ofonoext_mm_ref(
+    OfonoExtModemManager* self)
+{
+    if (G_LIKELY(self)) {
+        g_object_ref(OFONOEXT_MODEM_MANAGER(self));
+        return self;
+    } else {
+        return NULL;
+    }
+}
+
+void
+ofonoext_mm_unref(
+    OfonoExtModemManager* self)
+{
+    if (G_LIKELY(self)) {
+        g_object_unref(OFONOEXT_MODEM_MANAGER(self));
+    }
+}
+
+void
+ofonoext_mm_set_mms_imsi(
+    OfonoExtModemManager* self,
+    const char* imsi)
+{
+    ofonoext_mm_set_mms_imsi_full(self, imsi, NULL, NULL);
+}
+
+OfonoExtCall*
+ofonoext_mm_set_mms_imsi_full(
+    OfonoExtModemManager* self,
+    const char* imsi,
+    OfonoExtModemManagerSetMmsSimHandler fn,
+    void* arg)
+{
+    if (G_LIKELY(self)) {
+        GASSERT(self->valid);
+        if (G_LIKELY(self->valid) && self->priv->proxy) {
+            OfonoExtModemManagerPriv* priv = self->priv;
+            OfonoExtModemManagerSetMmsSimCall* call =
+                g_new0(OfonoExtModemManagerSetMmsSimCall,1);
+            ofonoext_call_init(&call->common, G_OBJECT(self));
+            call->fn = fn;
+            call->arg = arg;
+            priv->counters.calls++;
+            org_nemomobile_ofono_modem_manager_call_set_mms_sim(priv->proxy,
+                imsi, call->common.cancel, ofonoext_mm_set_mms_sim_done, call);
+            return &call->common;
+        }
+    }
+    return NULL;
+}
+
+OfonoExtCall*
+ofonoext_mm_wait_async(
+    OfonoExtModemManager* self,
+    OFONOEXT_MM_WAIT mask,
+    guint count,
+    guint timeout_ms,
+    OfonoExtModemManagerWaitHandler fn,
+    void* arg)
+{
+    if (G_LIKELY(self)) {
+        return &ofonoext_mm_wait_start(self, mask, count, timeout_ms, NULL,
+            fn, arg)->common;
+    }
+    return NULL;
+}
+
+gboolean
+ofonoext_mm_wait_sync(
+    OfonoExtModemManager* self,
+    OFONOEXT_MM_WAIT mask,
+    guint count,
+    guint timeout_ms)
+{
+    if (G_LIKELY(self)) {
+        if (ofonoext_mm_wait_satisfied(self, mask, count)) {
+            return TRUE;
+        } else {
+            OfonoExtModemManagerWaitSync sync;
+
+            sync.done = FALSE;
+            sync.ok = FALSE;
+
+            /* The timeout has to be on the context we are iterating */
+            g_main_context_push_thread_default(NULL);
+            ofonoext_mm_wait_async(self, mask, count, timeout_ms,
+                ofonoext_mm_wait_sync_done, &sync);
+
+            /* Blocks in poll() until something happens */
+            while (!sync.done) {
+                g_main_context_iteration(NULL, TRUE);
+            }
+            g_main_context_pop_thread_default(NULL);
+            return sync.ok;
+        }
+    }
+    return FALSE;
+}
+
+guint64
+ofonoext_mm_generation(
+    OfonoExtModemManager* self)
+{
+    return G_LIKELY(self) ? self->priv->generation : 0;
+}
+
+guint64
+ofonoext_mm_changed_since(
+    OfonoExtModemManager* self,
+    guint64 gen,
+    OFONOEXT_MM_CHANGED* mask)
+{
+    guint64 current = 0;
+    guint changed = OFONOEXT_MM_CHANGED_NONE;
+
+    if (G_LIKELY(self)) {
+        OfonoExtModemManagerPriv* priv = self->priv;
+
+        current = priv->generation;
+        if (gen < current) {
+            int i;
+
+            for (i=0; i<SIGNAL_COUNT; i++) {
+                if (priv->changed_gen[i] > gen) {
+                    changed |= (1 << i);
+                }
+            }
+        }
+    }
+    if (mask) {
+        *mask = changed;
+    }
+    return current;
+}
+
+int
+ofonoext_mm_get_fd(
+    OfonoExtModemManager* self)
+{
+    if (G_LIKELY(self)) {
+        OfonoExtModemManagerPriv* priv = self->priv;
+
+        if (!priv->poll) {
+            GError* error = NULL;
+
+            priv->poll = ofonoext_poll_new(g_main_context_default(),
+                &error);
+            if (!priv->poll) {
+                GERR("%s", GERRMSG(error));
+                g_error_free(error);
+                return -1;
+            }
+            if (priv->generation) {
+                /* The first dispatch reports the current state */
+                ofonoext_poll_notify(priv->poll);
+            }
+        }
+        return ofonoext_poll_fd(priv->poll);
+    }
+    return -1;
+}
+
+OFONOEXT_MM_CHANGED
+ofonoext_mm_dispatch(
+    OfonoExtModemManager* self)
+{
+    OFONOEXT_MM_CHANGED mask = OFONOEXT_MM_CHANGED_NONE;
+
+    if (G_LIKELY(self)) {
+        OfonoExtModemManagerPriv* priv = self->priv;
+
+        /* Handlers may drop the last reference */
+        ofonoext_mm_ref(self);
+        if (priv->poll) {
+            ofonoext_poll_dispatch(priv->poll);
+        } else {
+            g_main_context_iteration(NULL, FALSE);
+        }
+        priv->poll_gen = ofonoext_mm_changed_since(self, priv->poll_gen,
+            &mask);
+        ofonoext_mm_unref(self);
+    }
+    return mask;
+}
+
+void
+ofonoext_mm_init_async(
+    OfonoExtModemManager* self,
+    GCancellable* cancel,
+    GAsyncReadyCallback callback,
+    gpointer data)
+{
+    if (G_LIKELY(self)) {
+        GTask* task = g_task_new(self, cancel, callback, data);
+
+        g_task_set_source_tag(task, ofonoext_mm_init_async);
+        ofonoext_mm_wait_start(self, OFONOEXT_MM_WAIT_VALID, 0, 0, cancel,
+            ofonoext_mm_task_wait_done, task);
+    } else {
+        g_task_report_new_error(NULL, callback, data, ofonoext_mm_init_async,
+            G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Invalid argument");
+    }
+}
+
+gboolean
+ofonoext_mm_init_finish(
+    OfonoExtModemManager* self,
+    GAsyncResult* result,
+    GError** error)
+{
+    return ofonoext_mm_task_finish(self, result, error);
+}
+
+void
+ofonoext_mm_refresh_async(
+    OfonoExtModemManager* self,
+    GCancellable* cancel,
+    GAsyncReadyCallback callback,
+    gpointer data)
+{
+    if (G_LIKELY(self) && G_LIKELY(self->valid)) {
+        GTask* task = g_task_new(self, cancel, callback, data);
+        OfonoExtModemManagerRefreshAll* all =
+            g_slice_new0(OfonoExtModemManagerRefreshAll);
+        int i;
+
+        g_task_set_source_tag(task, ofonoext_mm_refresh_async);
+        all->task = task;
+        all->pending = 1;
+        for (i=0; i<PROXY_SIGNAL_COUNT; i++) {
+            if (ofonoext_mm_refresh_full(self, i, cancel, all)) {
+                all->pending++;
+            }
+        }
+        /* Drop the extra reference which protected the loop */
+        if (!--all->pending) {
+            g_task_return_boolean(task, TRUE);
+            g_object_unref(task);
+            g_slice_free(OfonoExtModemManagerRefreshAll, all);
+        }
+    } else {
+        ofonoext_mm_task_call(self, NULL, NULL, cancel, callback, data,
+            ofonoext_mm_refresh_async);
+    }
+}
+
+gboolean
+ofonoext_mm_refresh_finish(
+    OfonoExtModemManager* self,
+    GAsyncResult* result,
+    GError** error)
+{
+    return ofonoext_mm_task_finish(self, result, error);
+}
+
+void
+ofonoext_mm_set_enabled_modems_async(
+    OfonoExtModemManager* self,
+    const GStrV* modems,
+    GCancellable* cancel,
+    GAsyncReadyCallback callback,
+    gpointer data)
+{
+    static const char* const none[] = { NULL };
+
+    ofonoext_mm_task_call(self, "SetEnabledModems",
+        g_variant_new("(^ao)", modems ? modems : (const GStrV*)none), cancel,
+        callback, data, ofonoext_mm_set_enabled_modems_async);
+}
+
+gboolean
+ofonoext_mm_set_enabled_modems_finish(
+    OfonoExtModemManager* self,
+    GAsyncResult* result,
+    GError** error)
+{
+    return ofonoext_mm_task_finish(self, result, error);
+}
+
+void
+ofonoext_mm_set_data_imsi_async(
+    OfonoExtModemManager* self,
+    const char* imsi,
+    GCancellable* cancel,
+    GAsyncReadyCallback callback,
+    gpointer data)
+{
+    ofonoext_mm_task_call(self, "SetDefaultDataSim",
+        g_variant_new("(s)", imsi ? imsi : ""), cancel, callback, data,
+        ofonoext_mm_set_data_imsi_async);
+}
+
+gboolean
+ofonoext_mm_set_data_imsi_finish(
+    OfonoExtModemManager* self,
+    GAsyncResult* result,
+    GError** error)
+{
+    return ofonoext_mm_task_finish(self, result, error);
 }
 
-static
 void
-ofonoext_mm_name_vanished(
-    GDBusConnection* bus,
-    const gchar* name,
-    gpointer arg)
+ofonoext_mm_set_voice_imsi_async(
+    OfonoExtModemManager* self,
+    const char* imsi,
+    GCancellable* cancel,
+    GAsyncReadyCallback callback,
+    gpointer data)
 {
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(arg);
-    GDEBUG("Name '%s' has disappeared", name);
-    ofonoext_mm_reset(self);
-    ofonoext_mm_set_valid(self, FALSE);
+    ofonoext_mm_task_call(self, "SetDefaultVoiceSim",
+        g_variant_new("(s)", imsi ? imsi : ""), cancel, callback, data,
+        ofonoext_mm_set_voice_imsi_async);
 }
 
-static
-void
-ofonoext_mm_bus(
-    GObject* proxy,
+gboolean
+ofonoext_mm_set_voice_imsi_finish(
+    OfonoExtModemManager* self,
     GAsyncResult* result,
+    GError** error)
+{
+    return ofonoext_mm_task_finish(self, result, error);
+}
+
+void
+ofonoext_mm_set_mms_imsi_async(
+    OfonoExtModemManager* self,
+    const char* imsi,
+    GCancellable* cancel,
+    GAsyncReadyCallback callback,
     gpointer data)
 {
-    GError* error = NULL;
-    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(data);
-    OfonoExtModemManagerPriv* priv = self->priv;
+    ofonoext_mm_task_call(self, "SetMmsSim",
+        g_variant_new("(s)", imsi ? imsi : ""), cancel, callback, data,
+        ofonoext_mm_set_mms_imsi_async);
+}
 
-    GASSERT(!priv->cancel);
-    GASSERT(!self->valid);
-    GASSERT(!priv->proxy);
-    priv->bus = g_bus_get_finish(result, &error);
-    if (priv->bus) {
-        GDEBUG("Bus connected");
-        priv->ofono_watch_id = g_bus_watch_name_on_connection(priv->bus,
-            OFONO_SERVICE, G_BUS_NAME_WATCHER_FLAGS_NONE,
-            ofonoext_mm_name_appeared,
-            ofonoext_mm_name_vanished,
-            self, NULL);
-    } else {
-        GERR("%s", GERRMSG(error));
-        g_error_free(error);
+char*
+ofonoext_mm_set_mms_imsi_finish(
+    OfonoExtModemManager* self,
+    GAsyncResult* result,
+    GError** error)
+{
+    if (g_task_is_valid(result, self)) {
+        return g_task_propagate_pointer(G_TASK(result), error);
     }
-    ofonoext_mm_unref(self);
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+        "Invalid argument");
+    return NULL;
 }
 
-/*==========================================================================*
- * API
- *==========================================================================*/
-
-OfonoExtModemManager*
-ofonoext_mm_new()
+gboolean
+ofonoext_mm_start_recording(
+    OfonoExtModemManager* self,
+    const char* file,
+    gsize size,
+    GError** error)
 {
-    OfonoExtModemManager* mm;
-    if (ofonoext_mm_instance) {
-        g_object_ref(mm = ofonoext_mm_instance);
+    if (G_LIKELY(self) && G_LIKELY(file)) {
+        OfonoExtModemManagerPriv* priv = self->priv;
+        OfonoExtRecorder* recorder = ofonoext_recorder_new(file,
+            size ? size : MM_RECORD_DEFAULT_SIZE, error);
+
+        if (recorder) {
+            ofonoext_recorder_free(priv->recorder);
+            priv->recorder = recorder;
+            if (self->valid) {
+                /* Make the recording self-contained */
+                ofonoext_mm_record_state(self);
+            }
+            ofonoext_mm_update_subscriptions(self);
+            return TRUE;
+        }
     } else {
-        mm = g_object_new(OFONOEXT_TYPE_MODEM_MANAGER, NULL);
-        ofonoext_mm_instance = mm;
-        g_object_weak_ref(G_OBJECT(mm), ofonoext_mm_destroyed, mm);
-        g_bus_get(OFONO_BUS_TYPE, NULL, ofonoext_mm_bus, ofonoext_mm_ref(mm));
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+            "Invalid argument");
     }
-    return mm;
+    return FALSE;
 }
 
-OfonoExtModemManager*
-ofonoext_mm_ref(
+void
+ofonoext_mm_stop_recording(
     OfonoExtModemManager* self)
 {
     if (G_LIKELY(self)) {
-        g_object_ref(OFONOEXT_MODEM_MANAGER(self));
-        return self;
-    } else {
-        return NULL;
+        OfonoExtModemManagerPriv* priv = self->priv;
+
+        if (priv->recorder) {
+            ofonoext_recorder_free(priv->recorder);
+            priv->recorder = NULL;
+            ofonoext_mm_update_subscriptions(self);
+        }
     }
 }
 
 void
-ofonoext_mm_unref(
-    OfonoExtModemManager* self)
+ofonoext_mm_set_journal_size(
+    OfonoExtModemManager* self,
+    guint size)
 {
     if (G_LIKELY(self)) {
-        g_object_unref(OFONOEXT_MODEM_MANAGER(self));
+        OfonoExtModemManagerPriv* priv = self->priv;
+
+        g_free(priv->journal);
+        priv->journal = size ? g_new0(OfonoExtModemManagerEvent, size) :
+            NULL;
+        priv->journal_size = size;
+        priv->journal_first = priv->generation + 1;
+    }
+}
+
+guint
+ofonoext_mm_events_since(
+    OfonoExtModemManager* self,
+    guint64 seq,
+    OfonoExtModemManagerEvent* events,
+    guint max,
+    gboolean* lost)
+{
+    guint n = 0;
+    gboolean gap = FALSE;
+
+    if (G_LIKELY(self)) {
+        OfonoExtModemManagerPriv* priv = self->priv;
+        const guint64 last = priv->generation;
+
+        if (seq < last) {
+            if (!priv->journal || seq + 1 < priv->journal_first) {
+                /* Some of these changes have never been journalled */
+                gap = TRUE;
+            } else {
+                /* Every change since journal_first is in the journal */
+                guint64 first = priv->journal_first;
+                guint64 s;
+
+                /* Here last >= seq + 1 >= first, nothing can underflow */
+                if (last - first >= priv->journal_size) {
+                    /* The oldest ones have been overwritten */
+                    first = last - priv->journal_size + 1;
+                    if (seq + 1 < first) {
+                        gap = TRUE;
+                    }
+                }
+                for (s=MAX(seq + 1, first); s<=last && n<max; s++) {
+                    events[n++] = priv->journal[(s - priv->journal_first) %
+                        priv->journal_size];
+                }
+            }
+        }
     }
+    if (lost) {
+        *lost = gap;
+    }
+    return n;
 }
 
 void
-ofonoext_mm_set_mms_imsi(
+ofonoext_mm_get_counters(
     OfonoExtModemManager* self,
-    const char* imsi)
+    OfonoExtModemManagerCounters* counters)
 {
-    ofonoext_mm_set_mms_imsi_full(self, imsi, NULL, NULL);
+    if (G_LIKELY(self)) {
+        *counters = self->priv->counters;
+    } else {
+        memset(counters, 0, sizeof(*counters));
+    }
 }
 
-OfonoExtCall*
-ofonoext_mm_set_mms_imsi_full(
+void
+ofonoext_mm_set_handler_timing(
     OfonoExtModemManager* self,
-    const char* imsi,
-    OfonoExtModemManagerSetMmsSimHandler fn,
-    void* arg)
+    gboolean enable,
+    guint budget_us)
 {
     if (G_LIKELY(self)) {
-        GASSERT(self->valid);
-        if (G_LIKELY(self->valid)) {
-            OfonoExtModemManagerPriv* priv = self->priv;
-            OfonoExtModemManagerSetMmsSimCall* call =
-                g_new0(OfonoExtModemManagerSetMmsSimCall,1);
-            ofonoext_call_init(&call->common, G_OBJECT(self));
-            call->fn = fn;
-            call->arg = arg;
-            org_nemomobile_ofono_modem_manager_call_set_mms_sim(priv->proxy,
-                imsi, call->common.cancel, ofonoext_mm_set_mms_sim_done, call);
-            return &call->common;
+        OfonoExtModemManagerPriv* priv = self->priv;
+
+        priv->timing = enable;
+        priv->handler_budget = budget_us;
+    }
+}
+
+OfonoExtModemManagerHandlerStats*
+ofonoext_mm_handler_stats(
+    OfonoExtModemManager* self,
+    guint* count)
+{
+    OfonoExtModemManagerHandlerStats* stats = NULL;
+    guint n = 0;
+
+    if (G_LIKELY(self) && self->priv->handler_stats) {
+        GHashTableIter it;
+        gpointer key;
+
+        n = g_hash_table_size(self->priv->handler_stats);
+        stats = g_new(OfonoExtModemManagerHandlerStats, n);
+        n = 0;
+        g_hash_table_iter_init(&it, self->priv->handler_stats);
+        while (g_hash_table_iter_next(&it, &key, NULL)) {
+            memcpy(stats + n++, key, sizeof(*stats));
+        }
+        qsort(stats, n, sizeof(*stats), ofonoext_mm_stats_compare);
+    }
+    if (count) {
+        *count = n;
+    }
+    return stats;
+}
+
+void
+ofonoext_mm_reset_handler_stats(
+    OfonoExtModemManager* self)
+{
+    if (G_LIKELY(self) && self->priv->handler_stats) {
+        GHashTableIter it;
+        gpointer key;
+
+        /* The records are still referenced by the closures */
+        g_hash_table_iter_init(&it, self->priv->handler_stats);
+        while (g_hash_table_iter_next(&it, &key, NULL)) {
+            OfonoExtModemManagerHandlerStats* stats = key;
+
+            stats->count = stats->slow = 0;
+            stats->total_us = stats->max_us = 0;
         }
     }
-    return NULL;
 }
 
 gboolean
@@ -1087,8 +4566,7 @@ ofonoext_mm_add_valid_changed_handler(
     OfonoExtModemManagerHandler fn,
     void* data)
 {
-    return (G_LIKELY(self) && G_LIKELY(fn)) ? g_signal_connect(self,
-        SIGNAL_VALID_CHANGED_NAME, G_CALLBACK(fn), data) : 0;
+    return ofonoext_mm_add_handler(self, SIGNAL_VALID_CHANGED, fn, data);
 }
 
 gulong
@@ -1097,8 +4575,8 @@ ofonoext_mm_add_enabled_modems_changed_handler(
     OfonoExtModemManagerHandler fn,
     void* data)
 {
-    return (G_LIKELY(self) && G_LIKELY(fn)) ? g_signal_connect(self,
-        SIGNAL_ENABLED_MODEMS_CHANGED_NAME, G_CALLBACK(fn), data) : 0;
+    return ofonoext_mm_add_handler(self, SIGNAL_ENABLED_MODEMS_CHANGED,
+        fn, data);
 }
 
 gulong
@@ -1107,8 +4585,7 @@ ofonoext_mm_add_data_imsi_changed_handler(
     OfonoExtModemManagerHandler fn,
     void* data)
 {
-    return (G_LIKELY(self) && G_LIKELY(fn)) ? g_signal_connect(self,
-        SIGNAL_DATA_IMSI_CHANGED_NAME, G_CALLBACK(fn), data) : 0;
+    return ofonoext_mm_add_handler(self, SIGNAL_DATA_IMSI_CHANGED, fn, data);
 }
 
 gulong
@@ -1117,8 +4594,7 @@ ofonoext_mm_add_data_modem_changed_handler(
     OfonoExtModemManagerHandler fn,
     void* data)
 {
-    return (G_LIKELY(self) && G_LIKELY(fn)) ? g_signal_connect(self,
-        SIGNAL_DATA_MODEM_CHANGED_NAME, G_CALLBACK(fn), data) : 0;
+    return ofonoext_mm_add_handler(self, SIGNAL_DATA_MODEM_CHANGED, fn, data);
 }
 
 gulong
@@ -1127,8 +4603,7 @@ ofonoext_mm_add_voice_imsi_changed_handler(
     OfonoExtModemManagerHandler fn,
     void* data)
 {
-    return (G_LIKELY(self) && G_LIKELY(fn)) ? g_signal_connect(self,
-        SIGNAL_VOICE_IMSI_CHANGED_NAME, G_CALLBACK(fn), data) : 0;
+    return ofonoext_mm_add_handler(self, SIGNAL_VOICE_IMSI_CHANGED, fn, data);
 }
 
 gulong
@@ -1137,8 +4612,7 @@ ofonoext_mm_add_voice_modem_changed_handler(
     OfonoExtModemManagerHandler fn,
     void* data)
 {
-    return (G_LIKELY(self) && G_LIKELY(fn)) ? g_signal_connect(self,
-        SIGNAL_VOICE_MODEM_CHANGED_NAME, G_CALLBACK(fn), data) : 0;
+    return ofonoext_mm_add_handler(self, SIGNAL_VOICE_MODEM_CHANGED, fn, data);
 }
 
 gulong
@@ -1147,8 +4621,8 @@ ofonoext_mm_add_present_sims_changed_handler(
     OfonoExtModemManagerHandler fn,
     void* data)
 {
-    return (G_LIKELY(self) && G_LIKELY(fn)) ? g_signal_connect(self,
-        SIGNAL_PRESENT_SIMS_CHANGED_NAME, G_CALLBACK(fn), data) : 0;
+    return ofonoext_mm_add_handler(self, SIGNAL_PRESENT_SIMS_CHANGED,
+        fn, data);
 }
 
 gulong
@@ -1157,8 +4631,7 @@ ofonoext_mm_add_sim_count_changed_handler(
     OfonoExtModemManagerHandler fn,
     void* data)
 {
-    return (G_LIKELY(self) && G_LIKELY(fn)) ? g_signal_connect(self,
-        SIGNAL_SIM_COUNT_CHANGED_NAME, G_CALLBACK(fn), data) : 0;
+    return ofonoext_mm_add_handler(self, SIGNAL_SIM_COUNT_CHANGED, fn, data);
 }
 
 gulong
@@ -1167,8 +4640,8 @@ ofonoext_mm_add_active_sim_count_changed_handler(
     OfonoExtModemManagerHandler fn,
     void* data)
 {
-    return (G_LIKELY(self) && G_LIKELY(fn)) ? g_signal_connect(self,
-        SIGNAL_ACTIVE_SIM_COUNT_CHANGED_NAME, G_CALLBACK(fn), data) : 0;
+    return ofonoext_mm_add_handler(self, SIGNAL_ACTIVE_SIM_COUNT_CHANGED,
+        fn, data);
 }
 
 gulong
@@ -1177,8 +4650,7 @@ ofonoext_mm_add_mms_imsi_changed_handler(
     OfonoExtModemManagerHandler fn,
     void* data)
 {
-    return (G_LIKELY(self) && G_LIKELY(fn)) ? g_signal_connect(self,
-        SIGNAL_MMS_IMSI_CHANGED_NAME, G_CALLBACK(fn), data) : 0;
+    return ofonoext_mm_add_handler(self, SIGNAL_MMS_IMSI_CHANGED, fn, data);
 }
 
 gulong
@@ -1187,8 +4659,7 @@ ofonoext_mm_add_mms_modem_changed_handler(
     OfonoExtModemManagerHandler fn,
     void* data)
 {
-    return (G_LIKELY(self) && G_LIKELY(fn)) ? g_signal_connect(self,
-        SIGNAL_MMS_MODEM_CHANGED_NAME, G_CALLBACK(fn), data) : 0;
+    return ofonoext_mm_add_handler(self, SIGNAL_MMS_MODEM_CHANGED, fn, data);
 }
 
 gulong
@@ -1197,8 +4668,145 @@ ofonoext_mm_add_ready_changed_handler(
     OfonoExtModemManagerHandler fn,
     void* data)
 {
-    return (G_LIKELY(self) && G_LIKELY(fn)) ? g_signal_connect(self,
-        SIGNAL_READY_CHANGED_NAME, G_CALLBACK(fn), data) : 0;
+    return ofonoext_mm_add_handler(self, SIGNAL_READY_CHANGED, fn, data);
+}
+
+void
+ofonoext_mm_set_prefetch(
+    OfonoExtModemManager* self,
+    gboolean prefetch)
+{
+    if (G_LIKELY(self)) {
+        OfonoExtModemManagerPriv* priv = self->priv;
+
+        if (prefetch && !priv->prefetch) {
+            priv->prefetch = TRUE;
+            if (self->valid) {
+                ofonoext_mm_prefetch_start(self);
+                ofonoext_mm_check_warm(self);
+            }
+        } else if (!prefetch && priv->prefetch) {
+            priv->prefetch = FALSE;
+            ofonoext_mm_prefetch_stop(self);
+        }
+    }
+}
+
+OfonoModem*
+ofonoext_mm_modem_at(
+    OfonoExtModemManager* self,
+    gint index)
+{
+    if (G_LIKELY(self)) {
+        OfonoExtModemManagerPriv* priv = self->priv;
+
+        if (index >= 0 && index < (gint)priv->nslots) {
+            return priv->slots[index].modem;
+        }
+    }
+    return NULL;
+}
+
+OfonoSimMgr*
+ofonoext_mm_simmgr_at(
+    OfonoExtModemManager* self,
+    gint index)
+{
+    if (G_LIKELY(self)) {
+        OfonoExtModemManagerPriv* priv = self->priv;
+
+        if (index >= 0 && index < (gint)priv->nslots) {
+            return priv->slots[index].simmgr;
+        }
+    }
+    return NULL;
+}
+
+gint
+ofonoext_mm_slot_for_path(
+    OfonoExtModemManager* self,
+    const char* path)
+{
+    return G_LIKELY(self) ?
+        ofonoext_mm_index_lookup(self->priv->path_index, path) : -1;
+}
+
+gint
+ofonoext_mm_slot_for_imei(
+    OfonoExtModemManager* self,
+    const char* imei)
+{
+    return G_LIKELY(self) ?
+        ofonoext_mm_index_lookup(self->priv->imei_index, imei) : -1;
+}
+
+gint
+ofonoext_mm_slot_for_imsi(
+    OfonoExtModemManager* self,
+    const char* imsi)
+{
+    return G_LIKELY(self) ? ofonoext_mm_imsi_lookup(self, imsi) : -1;
+}
+
+const char*
+ofonoext_mm_imsi_at(
+    OfonoExtModemManager* self,
+    gint index)
+{
+    if (G_LIKELY(self)) {
+        OfonoExtModemManagerPriv* priv = self->priv;
+
+        if (priv->slot_imsi && index >= 0 &&
+            index < (gint)self->modem_count) {
+            return priv->slot_imsi[index].str;
+        }
+    }
+    return NULL;
+}
+
+gulong
+ofonoext_mm_add_slots_warm_handler(
+    OfonoExtModemManager* self,
+    OfonoExtModemManagerHandler fn,
+    void* data)
+{
+    return ofonoext_mm_add_handler(self, SIGNAL_SLOTS_WARM, fn, data);
+}
+
+gulong
+ofonoext_mm_add_batch_handler(
+    OfonoExtModemManager* self,
+    OFONOEXT_MM_CHANGED mask,
+    guint interval_ms,
+    OfonoExtModemManagerBatchHandler fn,
+    void* data)
+{
+    if (G_LIKELY(self) && G_LIKELY(fn) && (mask & OFONOEXT_MM_CHANGED_ALL)) {
+        OfonoExtModemManagerPriv* priv = self->priv;
+        OfonoExtModemManagerBatch* batch =
+            g_slice_new0(OfonoExtModemManagerBatch);
+        gulong id;
+
+        batch->mm = self;
+        batch->mask = mask & OFONOEXT_MM_CHANGED_ALL;
+        batch->interval_ms = interval_ms;
+        batch->fn = fn;
+        batch->data = data;
+        if (!priv->batches) {
+            priv->batches = g_ptr_array_new();
+        }
+        g_ptr_array_add(priv->batches, batch);
+
+        /* The batch is freed together with the closure */
+        id = g_signal_connect_closure_by_id(self, ofonoext_mm_batch_signal,
+            0, g_cclosure_new(G_CALLBACK(ofonoext_mm_batch_nop), batch,
+            ofonoext_mm_batch_free), FALSE);
+        if (priv->on_demand) {
+            ofonoext_mm_update_subscriptions(self);
+        }
+        return id;
+    }
+    return 0;
 }
 
 void
@@ -1208,6 +4816,9 @@ ofonoext_mm_remove_handler(
 {
     if (G_LIKELY(self) && G_LIKELY(id)) {
         g_signal_handler_disconnect(self, id);
+        if (self->priv->on_demand) {
+            ofonoext_mm_update_subscriptions(self);
+        }
     }
 }
 
@@ -1218,6 +4829,64 @@ ofonoext_mm_remove_handlers(
     unsigned int count)
 {
     gutil_disconnect_handlers(self, ids, count);
+    if (G_LIKELY(self) && self->priv->on_demand) {
+        ofonoext_mm_update_subscriptions(self);
+    }
+}
+
+void
+ofonoext_mm_set_subscribe_on_demand(
+    OfonoExtModemManager* self,
+    gboolean on_demand)
+{
+    if (G_LIKELY(self)) {
+        OfonoExtModemManagerPriv* priv = self->priv;
+
+        if (priv->on_demand != on_demand) {
+            priv->on_demand = on_demand;
+            ofonoext_mm_update_subscriptions(self);
+        }
+    }
+}
+
+gboolean
+ofonoext_mm_property_subscribed(
+    OfonoExtModemManager* self,
+    OFONOEXT_MM_PROPERTY property)
+{
+    if (G_LIKELY(self) && self->valid &&
+        property >= 0 && property < PROXY_SIGNAL_COUNT) {
+        OfonoExtModemManagerPriv* priv = self->priv;
+
+        return priv->proxy_signal_id[property] &&
+            !(priv->stale & (1 << property));
+    }
+    return FALSE;
+}
+
+/*==========================================================================*
+ * Internal API
+ *==========================================================================*/
+
+const char*
+ofonoext_mm_service(
+    OfonoExtModemManager* self)
+{
+    return self->priv->service;
+}
+
+const char*
+ofonoext_mm_path(
+    OfonoExtModemManager* self)
+{
+    return self->priv->path;
+}
+
+OFONOEXT_MM_FLAGS
+ofonoext_mm_flags(
+    OfonoExtModemManager* self)
+{
+    return self->priv->key.flags;
 }
 
 /*==========================================================================*
@@ -1235,6 +4904,32 @@ ofonoext_mm_init(
     OfonoExtModemManagerPriv* priv = G_TYPE_INSTANCE_GET_PRIVATE(self,
         OFONOEXT_TYPE_MODEM_MANAGER, OfonoExtModemManagerPriv);
     self->priv = priv;
+    g_weak_ref_init(&priv->ref, self);
+    priv->path_index = g_hash_table_new(g_str_hash, g_str_equal);
+    priv->imei_index = g_hash_table_new(g_str_hash, g_str_equal);
+    priv->imsi_index = g_hash_table_new(ofonoext_mm_imsi_hash,
+        ofonoext_mm_imsi_equal);
+}
+
+/**
+ * First stage of deinitialization (may be called more than once)
+ */
+static
+void
+ofonoext_mm_dispose(
+    GObject* object)
+{
+    OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(object);
+    OfonoExtModemManagerPriv* priv = self->priv;
+
+    /* The weak references have already been cleared by GObject */
+    g_mutex_lock(&ofonoext_mm_mutex);
+    if (priv->key.service &&
+        g_hash_table_lookup(ofonoext_mm_table, &priv->key) == self) {
+        g_hash_table_remove(ofonoext_mm_table, &priv->key);
+    }
+    g_mutex_unlock(&ofonoext_mm_mutex);
+    G_OBJECT_CLASS(ofonoext_mm_parent_class)->dispose(object);
 }
 
 /**
@@ -1248,13 +4943,37 @@ ofonoext_mm_finalize(
     OfonoExtModemManager* self = OFONOEXT_MODEM_MANAGER(object);
     OfonoExtModemManagerPriv* priv = self->priv;
     GASSERT(!priv->cancel);
+    g_weak_ref_clear(&priv->ref);
     ofonoext_mm_reset(self);
+    g_hash_table_destroy(priv->path_index);
+    g_hash_table_destroy(priv->imei_index);
+    g_hash_table_destroy(priv->imsi_index);
+    ofonoext_mm_worker_free(priv->worker);
+    ofonoext_mm_scenario_free(priv->scenario);
+    if (priv->handler_stats) {
+        g_hash_table_destroy(priv->handler_stats);
+    }
+    g_free(priv->journal);
+    if (priv->batches) {
+        /* Emptied by dispose, along with the rest of the handlers */
+        GASSERT(!priv->batches->len);
+        g_ptr_array_free(priv->batches, TRUE);
+    }
+    ofonoext_recorder_free(priv->recorder);
+    ofonoext_poll_free(priv->poll);
     if (priv->ofono_watch_id) {
         g_bus_unwatch_name(priv->ofono_watch_id);
     }
     if (priv->bus) {
+        /* Nobody else is going to close the private connection */
+        if (!priv->key.bus && (priv->key.flags &
+            OFONOEXT_MM_FLAG_PRIVATE_BUS)) {
+            g_dbus_connection_close(priv->bus, NULL, NULL, NULL);
+        }
         g_object_unref(priv->bus);
     }
+    g_free(priv->service);
+    g_free(priv->path);
     G_OBJECT_CLASS(ofonoext_mm_parent_class)->finalize(object);
 }
 
@@ -1266,6 +4985,7 @@ void
 ofonoext_mm_class_init(
     OfonoExtModemManagerClass* klass)
 {
+    G_OBJECT_CLASS(klass)->dispose = ofonoext_mm_dispose;
     G_OBJECT_CLASS(klass)->finalize = ofonoext_mm_finalize;
     g_type_class_add_private(klass, sizeof(OfonoExtModemManagerPriv));
     OFONOEXT_SIGNAL_NEW(VALID);
@@ -1280,6 +5000,14 @@ ofonoext_mm_class_init(
     OFONOEXT_SIGNAL_NEW(MMS_IMSI);
     OFONOEXT_SIGNAL_NEW(MMS_MODEM);
     OFONOEXT_SIGNAL_NEW(READY);
+    ofonoext_mm_signals[SIGNAL_SLOTS_WARM] =
+        g_signal_new(SIGNAL_SLOTS_WARM_NAME,
+            G_OBJECT_CLASS_TYPE(klass), G_SIGNAL_RUN_FIRST, 0,
+            NULL, NULL, NULL, G_TYPE_NONE, 0);
+    ofonoext_mm_batch_signal =
+        g_signal_new(SIGNAL_BATCH_NAME,
+            G_OBJECT_CLASS_TYPE(klass), G_SIGNAL_RUN_FIRST, 0,
+            NULL, NULL, NULL, G_TYPE_NONE, 0);
 }
 
 /*
@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gofonoext_poll_p.h"
+#include "gofonoext_log.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * The descriptor returned to the caller is an epoll instance watching
+ * the eventfd used for notifications, a timerfd armed with the timeout
+ * of the context and whatever the context itself wants to poll.
+ */
+struct ofonoext_poll {
+    GMainContext* context;
+    int epoll_fd;
+    int event_fd;
+    int timer_fd;
+    GPollFD* fds;               /* Registered with epoll */
+    guint nfds;
+    GPollFD* query;             /* Buffer for g_main_context_query() */
+    guint query_size;
+};
+
+static
+gboolean
+ofonoext_poll_add(
+    OfonoExtPoll* self,
+    int fd,
+    guint32 events,
+    GError** error)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        const int err = errno;
+
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(err),
+            "epoll_ctl: %s", g_strerror(err));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static
+guint32
+ofonoext_poll_events(
+    gushort events)
+{
+    guint32 ev = 0;
+
+    if (events & G_IO_IN) ev |= EPOLLIN;
+    if (events & G_IO_OUT) ev |= EPOLLOUT;
+    if (events & G_IO_PRI) ev |= EPOLLPRI;
+    return ev;
+}
+
+static
+gboolean
+ofonoext_poll_fds_equal(
+    const GPollFD* fds1,
+    const GPollFD* fds2,
+    guint n)
+{
+    guint i;
+
+    for (i = 0; i < n; i++) {
+        if (fds1[i].fd != fds2[i].fd || fds1[i].events != fds2[i].events) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static
+void
+ofonoext_poll_update_fds(
+    OfonoExtPoll* self,
+    guint n)
+{
+    /* The set rarely changes, usually it's just the wakeup fd */
+    if (n != self->nfds || !ofonoext_poll_fds_equal(self->fds,
+        self->query, n)) {
+        guint i;
+
+        for (i = 0; i < self->nfds; i++) {
+            epoll_ctl(self->epoll_fd, EPOLL_CTL_DEL, self->fds[i].fd, NULL);
+        }
+        g_free(self->fds);
+        self->fds = g_new(GPollFD, n);
+        memcpy(self->fds, self->query, sizeof(GPollFD) * n);
+        self->nfds = n;
+        for (i = 0; i < n; i++) {
+            struct epoll_event ev;
+            const int fd = self->fds[i].fd;
+            gushort events = self->fds[i].events;
+            guint k;
+
+            /* The same fd may be polled twice, epoll only takes it once */
+            for (k = 0; k < i; k++) {
+                if (self->fds[k].fd == fd) {
+                    break;
+                }
+            }
+            if (k < i) {
+                /* Already added with the events of all entries */
+                continue;
+            }
+            for (k = i + 1; k < n; k++) {
+                if (self->fds[k].fd == fd) {
+                    events |= self->fds[k].events;
+                }
+            }
+            memset(&ev, 0, sizeof(ev));
+            ev.events = ofonoext_poll_events(events);
+            ev.data.fd = fd;
+            epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+}
+
+static
+void
+ofonoext_poll_set_timer(
+    OfonoExtPoll* self,
+    gint timeout)
+{
+    struct itimerspec spec;
+
+    /* Zero timeout means that something is ready right now */
+    memset(&spec, 0, sizeof(spec));
+    if (timeout == 0) {
+        spec.it_value.tv_nsec = 1;
+    } else if (timeout > 0) {
+        spec.it_value.tv_sec = timeout / 1000;
+        spec.it_value.tv_nsec = (timeout % 1000) * 1000000;
+    }
+    timerfd_settime(self->timer_fd, 0, &spec, NULL);
+}
+
+static
+gint
+ofonoext_poll_query(
+    OfonoExtPoll* self,
+    gint max_priority,
+    gint* timeout)
+{
+    gint n;
+
+    while ((n = g_main_context_query(self->context, max_priority, timeout,
+        self->query, self->query_size)) > (gint)self->query_size) {
+        self->query_size = n;
+        self->query = g_renew(GPollFD, self->query, n);
+    }
+    return n;
+}
+
+/* Must be called with the context acquired */
+static
+void
+ofonoext_poll_arm(
+    OfonoExtPoll* self)
+{
+    gint max_priority, timeout, n;
+
+    g_main_context_prepare(self->context, &max_priority);
+    n = ofonoext_poll_query(self, max_priority, &timeout);
+    ofonoext_poll_update_fds(self, n);
+    ofonoext_poll_set_timer(self, timeout);
+}
+
+OfonoExtPoll*
+ofonoext_poll_new(
+    GMainContext* context,
+    GError** error)
+{
+    OfonoExtPoll* self = g_new0(OfonoExtPoll, 1);
+
+    self->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    self->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    self->timer_fd = timerfd_create(CLOCK_MONOTONIC,
+        TFD_CLOEXEC | TFD_NONBLOCK);
+    self->context = g_main_context_ref(context);
+    if (self->epoll_fd < 0 || self->event_fd < 0 || self->timer_fd < 0) {
+        const int err = errno;
+
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(err),
+            "%s", g_strerror(err));
+    } else if (ofonoext_poll_add(self, self->event_fd, EPOLLIN, error) &&
+        ofonoext_poll_add(self, self->timer_fd, EPOLLIN, error)) {
+        if (g_main_context_acquire(context)) {
+            ofonoext_poll_arm(self);
+            g_main_context_release(context);
+        } else {
+            /* Let the first dispatch do it */
+            ofonoext_poll_notify(self);
+        }
+        return self;
+    }
+    ofonoext_poll_free(self);
+    return NULL;
+}
+
+void
+ofonoext_poll_free(
+    OfonoExtPoll* self)
+{
+    if (self) {
+        if (self->epoll_fd >= 0) close(self->epoll_fd);
+        if (self->event_fd >= 0) close(self->event_fd);
+        if (self->timer_fd >= 0) close(self->timer_fd);
+        g_main_context_unref(self->context);
+        g_free(self->fds);
+        g_free(self->query);
+        g_free(self);
+    }
+}
+
+int
+ofonoext_poll_fd(
+    OfonoExtPoll* self)
+{
+    return self->epoll_fd;
+}
+
+void
+ofonoext_poll_notify(
+    OfonoExtPoll* self)
+{
+    const guint64 one = 1;
+
+    if (write(self->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        GWARN("eventfd write failed: %s", g_strerror(errno));
+    }
+}
+
+void
+ofonoext_poll_dispatch(
+    OfonoExtPoll* self)
+{
+    GMainContext* context = self->context;
+
+    if (g_main_context_acquire(context)) {
+        gint max_priority, timeout, n;
+        guint64 value;
+
+        g_main_context_prepare(context, &max_priority);
+        n = ofonoext_poll_query(self, max_priority, &timeout);
+        if (n > 0) {
+            g_poll(self->query, n, 0);
+        }
+        if (g_main_context_check(context, max_priority, self->query, n)) {
+            g_main_context_dispatch(context);
+        }
+
+        /* Notifications made by the handlers are delivered by the caller */
+        if (read(self->event_fd, &value, sizeof(value)) < 0) {
+            GASSERT(errno == EAGAIN);
+        }
+        if (read(self->timer_fd, &value, sizeof(value)) < 0) {
+            GASSERT(errno == EAGAIN);
+        }
+        ofonoext_poll_arm(self);
+        g_main_context_release(context);
+    } else {
+        GWARN("Main context is owned by another thread");
+    }
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
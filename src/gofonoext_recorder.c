@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gofonoext_recorder_p.h"
+#include "gofonoext_log.h"
+
+#include <gio/gio.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+struct ofonoext_recorder {
+    int fd;
+    gsize map_size;
+    OfonoExtRecorderHeader* header;
+    guint8* data;
+    guint32 size;
+    gsize max_payload;
+};
+
+#define RECORD_HEADER_SIZE sizeof(OfonoExtRecorderRecord)
+#define RECORD_MAX_PAYLOAD (OFONOEXT_RECORDER_MAX_RECORD - RECORD_HEADER_SIZE)
+
+/*
+ * The file is mapped with MAP_SHARED, i.e. whatever has been written
+ * to the ring stays in the page cache even if the process crashes.
+ * The only ordering requirement is that head and tail are updated
+ * in the right order relative to the records themselves.
+ */
+#define RECORDER_STORE(ptr,val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+
+/*==========================================================================*
+ * Implementation
+ *==========================================================================*/
+
+static inline
+guint32
+ofonoext_recorder_align(
+    guint32 size)
+{
+    return (size + OFONOEXT_RECORDER_ALIGN - 1) &
+        ~(OFONOEXT_RECORDER_ALIGN - 1);
+}
+
+static
+guint64
+ofonoext_recorder_skip(
+    OfonoExtRecorder* self,
+    guint64 pos)
+{
+    const guint32 off = pos % self->size;
+    const guint32 left = self->size - off;
+
+    if (left < RECORD_HEADER_SIZE) {
+        return pos + left;
+    } else {
+        const OfonoExtRecorderRecord* rec = (void*)(self->data + off);
+
+        /* Don't get stuck on garbage */
+        return pos + ((rec->size >= RECORD_HEADER_SIZE && rec->size <= left) ?
+            rec->size : left);
+    }
+}
+
+static
+void
+ofonoext_recorder_reserve(
+    OfonoExtRecorder* self,
+    guint32 size)
+{
+    OfonoExtRecorderHeader* header = self->header;
+    guint64 tail = header->tail;
+
+    /* Drop the oldest records until there's enough space */
+    while (header->head + size - tail > self->size) {
+        tail = ofonoext_recorder_skip(self, tail);
+    }
+    if (header->tail != tail) {
+        RECORDER_STORE(&header->tail, tail);
+    }
+}
+
+static
+guint8*
+ofonoext_recorder_begin(
+    OfonoExtRecorder* self,
+    OFONOEXT_RECORD_TYPE type,
+    guint code,
+    gsize len)
+{
+    OfonoExtRecorderHeader* header = self->header;
+    OfonoExtRecorderRecord* rec;
+    guint32 off, left, size;
+
+    size = ofonoext_recorder_align(RECORD_HEADER_SIZE + len);
+    off = header->head % self->size;
+    left = self->size - off;
+    if (size > left) {
+        /* Records never cross the end of the ring */
+        ofonoext_recorder_reserve(self, left);
+        if (left >= RECORD_HEADER_SIZE) {
+            rec = (void*)(self->data + off);
+            memset(rec, 0, RECORD_HEADER_SIZE);
+            rec->size = left;
+            rec->type = OFONOEXT_RECORD_PADDING;
+        }
+        RECORDER_STORE(&header->head, header->head + left);
+        off = 0;
+    }
+
+    ofonoext_recorder_reserve(self, size);
+    rec = (void*)(self->data + off);
+    rec->size = size;
+    rec->length = len;
+    rec->type = type;
+    rec->code = code;
+    rec->reserved = 0;
+    rec->time = g_get_real_time();
+    return (guint8*)(rec + 1);
+}
+
+static
+void
+ofonoext_recorder_commit(
+    OfonoExtRecorder* self,
+    guint8* payload)
+{
+    OfonoExtRecorderHeader* header = self->header;
+    const OfonoExtRecorderRecord* rec = ((OfonoExtRecorderRecord*)payload) - 1;
+
+    header->count++;
+    RECORDER_STORE(&header->head, header->head + rec->size);
+}
+
+/*==========================================================================*
+ * Internal API
+ *==========================================================================*/
+
+OfonoExtRecorder*
+ofonoext_recorder_new(
+    const char* file,
+    gsize size,
+    GError** error)
+{
+    OfonoExtRecorder* self;
+    OfonoExtRecorderHeader* header;
+    struct stat st;
+    gsize map_size;
+    void* map;
+    int fd;
+
+    /* Check the limit first, aligning truncates the size to 32 bits */
+    if (size > G_MAXUINT32 - OFONOEXT_RECORDER_ALIGN) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+            "Recorder size %" G_GSIZE_FORMAT " is too large", size);
+        return NULL;
+    }
+    size = ofonoext_recorder_align(MAX(size, OFONOEXT_RECORDER_MIN_SIZE));
+
+    fd = open(file, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        const int err = errno;
+
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(err),
+            "%s: %s", file, g_strerror(err));
+        return NULL;
+    }
+
+    map_size = sizeof(OfonoExtRecorderHeader) + size;
+    if (fstat(fd, &st) < 0 || (st.st_size != (off_t)map_size &&
+        ftruncate(fd, map_size) < 0)) {
+        const int err = errno;
+
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(err),
+            "%s: %s", file, g_strerror(err));
+        close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        const int err = errno;
+
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(err),
+            "%s: %s", file, g_strerror(err));
+        close(fd);
+        return NULL;
+    }
+
+    header = map;
+    if (header->magic == OFONOEXT_RECORDER_MAGIC &&
+        header->format == OFONOEXT_RECORDER_FORMAT &&
+        header->header_size == sizeof(OfonoExtRecorderHeader) &&
+        header->data_size == size &&
+        header->head >= header->tail &&
+        header->head - header->tail <= size) {
+        /* Keep the history across restarts */
+        GDEBUG("Appending to %s (%" G_GUINT64_FORMAT " records)", file,
+            header->count);
+    } else {
+        GDEBUG("Recording to %s", file);
+        memset(header, 0, sizeof(*header));
+        header->format = OFONOEXT_RECORDER_FORMAT;
+        header->header_size = sizeof(OfonoExtRecorderHeader);
+        header->data_size = size;
+        RECORDER_STORE(&header->magic, OFONOEXT_RECORDER_MAGIC);
+    }
+
+    self = g_slice_new0(OfonoExtRecorder);
+    self->fd = fd;
+    self->map_size = map_size;
+    self->header = header;
+    self->data = (guint8*)(header + 1);
+    self->size = size;
+    self->max_payload = MIN(RECORD_MAX_PAYLOAD, size - RECORD_HEADER_SIZE);
+    return self;
+}
+
+void
+ofonoext_recorder_free(
+    OfonoExtRecorder* self)
+{
+    if (self) {
+        munmap(self->header, self->map_size);
+        close(self->fd);
+        g_slice_free(OfonoExtRecorder, self);
+    }
+}
+
+void
+ofonoext_recorder_write(
+    OfonoExtRecorder* self,
+    OFONOEXT_RECORD_TYPE type,
+    guint code,
+    const void* data,
+    gsize len)
+{
+    guint8* payload;
+
+    len = MIN(len, self->max_payload);
+    payload = ofonoext_recorder_begin(self, type, code, len);
+    if (len) {
+        memcpy(payload, data, len);
+    }
+    ofonoext_recorder_commit(self, payload);
+}
+
+void
+ofonoext_recorder_write_strv(
+    OfonoExtRecorder* self,
+    OFONOEXT_RECORD_TYPE type,
+    guint code,
+    const GStrV* strv)
+{
+    const GStrV* ptr;
+    guint8* payload;
+    gsize len = 0;
+
+    for (ptr = strv; ptr && *ptr; ptr++) {
+        len += strlen(*ptr) + 1;
+    }
+
+    len = MIN(len, self->max_payload);
+    payload = ofonoext_recorder_begin(self, type, code, len);
+    if (len) {
+        guint8* out = payload;
+        gsize left = len;
+
+        for (ptr = strv; *ptr && left; ptr++) {
+            const gsize n = MIN(strlen(*ptr) + 1, left);
+
+            memcpy(out, *ptr, n);
+            out += n;
+            left -= n;
+        }
+    }
+    ofonoext_recorder_commit(self, payload);
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GOFONOEXT_RECORDER_PRIVATE_H
+#define GOFONOEXT_RECORDER_PRIVATE_H
+
+#include "gofonoext_recorder.h"
+
+typedef struct ofonoext_recorder OfonoExtRecorder;
+
+/* Records are truncated to fit into 16 bits */
+#define OFONOEXT_RECORDER_MIN_SIZE   (0x1000)
+#define OFONOEXT_RECORDER_MAX_RECORD (0xfff8)
+
+OfonoExtRecorder*
+ofonoext_recorder_new(
+    const char* file,
+    gsize size,
+    GError** error)
+    G_GNUC_INTERNAL;
+
+void
+ofonoext_recorder_free(
+    OfonoExtRecorder* recorder)
+    G_GNUC_INTERNAL;
+
+void
+ofonoext_recorder_write(
+    OfonoExtRecorder* recorder,
+    OFONOEXT_RECORD_TYPE type,
+    guint code,
+    const void* data,
+    gsize len)
+    G_GNUC_INTERNAL;
+
+void
+ofonoext_recorder_write_strv(
+    OfonoExtRecorder* recorder,
+    OFONOEXT_RECORD_TYPE type,
+    guint code,
+    const GStrV* strv)
+    G_GNUC_INTERNAL;
+
+#endif /* GOFONOEXT_RECORDER_PRIVATE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gofonoext_ring_p.h"
+
+/* Keeps the producer and the consumer indices in separate cache lines */
+#define RING_CACHE_LINE (64)
+
+struct ofonoext_ring {
+    guint head;                 /* Written by the consumer */
+    guint8 pad1[RING_CACHE_LINE - sizeof(guint)];
+    guint tail;                 /* Written by the producer */
+    guint8 pad2[RING_CACHE_LINE - sizeof(guint)];
+    guint mask;
+    gpointer slot[1];           /* mask + 1 slots */
+};
+
+OfonoExtRing*
+ofonoext_ring_new(
+    guint capacity)
+{
+    guint size = 2;
+    OfonoExtRing* ring;
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+    ring = g_malloc0(G_STRUCT_OFFSET(OfonoExtRing, slot) +
+        sizeof(gpointer) * size);
+    ring->mask = size - 1;
+    return ring;
+}
+
+void
+ofonoext_ring_free(
+    OfonoExtRing* ring,
+    GDestroyNotify destroy)
+{
+    if (ring) {
+        if (destroy) {
+            gpointer data;
+
+            while ((data = ofonoext_ring_pop(ring)) != NULL) {
+                destroy(data);
+            }
+        }
+        g_free(ring);
+    }
+}
+
+gboolean
+ofonoext_ring_push(
+    OfonoExtRing* ring,
+    gpointer data)
+{
+    const guint tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    const guint head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    if (tail - head > ring->mask) {
+        return FALSE;
+    }
+    ring->slot[tail & ring->mask] = data;
+    /* Publishes the slot contents together with the new tail */
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return TRUE;
+}
+
+gpointer
+ofonoext_ring_pop(
+    OfonoExtRing* ring)
+{
+    const guint head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    const guint tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    gpointer data;
+
+    if (head == tail) {
+        return NULL;
+    }
+    data = ring->slot[head & ring->mask];
+    /* The producer may reuse the slot from now on */
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return data;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
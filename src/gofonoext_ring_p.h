@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GOFONOEXT_RING_PRIVATE_H
+#define GOFONOEXT_RING_PRIVATE_H
+
+#include "gofonoext_types.h"
+
+/*
+ * Bounded lock-free queue of pointers for exactly one producer thread
+ * and one consumer thread. The capacity is rounded up to a power of 2.
+ * Push fails if the queue is full, pop returns NULL if it's empty.
+ */
+typedef struct ofonoext_ring OfonoExtRing;
+
+OfonoExtRing*
+ofonoext_ring_new(
+    guint capacity)
+    G_GNUC_INTERNAL;
+
+void
+ofonoext_ring_free(
+    OfonoExtRing* ring,
+    GDestroyNotify destroy)
+    G_GNUC_INTERNAL;
+
+gboolean
+ofonoext_ring_push(
+    OfonoExtRing* ring,
+    gpointer data)
+    G_GNUC_INTERNAL;
+
+gpointer
+ofonoext_ring_pop(
+    OfonoExtRing* ring)
+    G_GNUC_INTERNAL;
+
+#endif /* GOFONOEXT_RING_PRIVATE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gofonoext_scenario_p.h"
+#include "gofonoext_log.h"
+
+#include <gutil_strv.h>
+
+#include <string.h>
+
+#define SCENARIO_GROUP "Scenario"
+#define SCENARIO_KEY_DELAY "Delay"
+#define SCENARIO_KEY_LOOP "Loop"
+#define SCENARIO_KEY_PERIOD "Period"
+
+#define STATE_GROUP "State"
+#define STATE_KEY_AVAILABLE "Available"
+#define STATE_KEY_ENABLED "Enabled"
+#define STATE_KEY_IMEI "IMEI"
+#define STATE_KEY_PRESENT_SIMS "PresentSims"
+#define STATE_KEY_DATA_SIM "DefaultDataSim"
+#define STATE_KEY_DATA_MODEM "DefaultDataModem"
+#define STATE_KEY_VOICE_SIM "DefaultVoiceSim"
+#define STATE_KEY_VOICE_MODEM "DefaultVoiceModem"
+#define STATE_KEY_MMS_SIM "MmsSim"
+#define STATE_KEY_MMS_MODEM "MmsModem"
+#define STATE_KEY_READY "Ready"
+
+/*==========================================================================*
+ * Implementation
+ *==========================================================================*/
+
+static
+gboolean
+ofonoext_scenario_parse_time(
+    const char* str,
+    guint* time)
+{
+    if (g_ascii_isdigit(str[0])) {
+        char* end = NULL;
+        const guint64 value = g_ascii_strtoull(str, &end, 10);
+
+        if (!*end && value <= G_MAXUINT) {
+            *time = (guint)value;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* Missing keys leave the default value alone */
+static
+gboolean
+ofonoext_scenario_get_uint(
+    GKeyFile* k,
+    const char* group,
+    const char* key,
+    guint* value,
+    GError** error)
+{
+    char* str = g_key_file_get_value(k, group, key, NULL);
+
+    if (str) {
+        const gboolean ok = ofonoext_scenario_parse_time(g_strstrip(str),
+            value);
+
+        if (!ok) {
+            g_set_error(error, G_KEY_FILE_ERROR,
+                G_KEY_FILE_ERROR_INVALID_VALUE, "Invalid %s/%s value '%s'",
+                group, key, str);
+        }
+        g_free(str);
+        return ok;
+    }
+    return TRUE;
+}
+
+static
+gboolean
+ofonoext_scenario_get_boolean(
+    GKeyFile* k,
+    const char* group,
+    const char* key,
+    gboolean* value,
+    GError** error)
+{
+    if (g_key_file_has_key(k, group, key, NULL)) {
+        GError* e = NULL;
+        const gboolean b = g_key_file_get_boolean(k, group, key, &e);
+
+        if (e) {
+            g_propagate_error(error, e);
+            return FALSE;
+        }
+        *value = b;
+    }
+    return TRUE;
+}
+
+static
+GStrV*
+ofonoext_scenario_get_strv(
+    GKeyFile* k,
+    const char* group,
+    const char* key)
+{
+    GStrV* strv = g_key_file_get_string_list(k, group, key, NULL, NULL);
+
+    return strv ? strv : g_new0(char*, 1);
+}
+
+/* Missing strings are empty, just like in the D-Bus replies */
+static
+char*
+ofonoext_scenario_get_string(
+    GKeyFile* k,
+    const char* group,
+    const char* key)
+{
+    char* str = g_key_file_get_string(k, group, key, NULL);
+
+    return str ? str : g_strdup("");
+}
+
+static
+gboolean
+ofonoext_scenario_parse_state(
+    OfonoExtScenario* self,
+    GKeyFile* k,
+    GError** error)
+{
+    guint n;
+
+    self->available = ofonoext_scenario_get_strv(k, STATE_GROUP,
+        STATE_KEY_AVAILABLE);
+    n = gutil_strv_length(self->available);
+    self->enabled = ofonoext_scenario_get_strv(k, STATE_GROUP,
+        STATE_KEY_ENABLED);
+    self->imei = ofonoext_scenario_get_strv(k, STATE_GROUP, STATE_KEY_IMEI);
+    self->data_imsi = ofonoext_scenario_get_string(k, STATE_GROUP,
+        STATE_KEY_DATA_SIM);
+    self->data_modem = ofonoext_scenario_get_string(k, STATE_GROUP,
+        STATE_KEY_DATA_MODEM);
+    self->voice_imsi = ofonoext_scenario_get_string(k, STATE_GROUP,
+        STATE_KEY_VOICE_SIM);
+    self->voice_modem = ofonoext_scenario_get_string(k, STATE_GROUP,
+        STATE_KEY_VOICE_MODEM);
+    self->mms_imsi = ofonoext_scenario_get_string(k, STATE_GROUP,
+        STATE_KEY_MMS_SIM);
+    self->mms_modem = ofonoext_scenario_get_string(k, STATE_GROUP,
+        STATE_KEY_MMS_MODEM);
+    self->present_sims = g_new0(gboolean, n + 1);
+    if (g_key_file_has_key(k, STATE_GROUP, STATE_KEY_PRESENT_SIMS, NULL)) {
+        gsize count = 0;
+        GError* e = NULL;
+        gboolean* present = g_key_file_get_boolean_list(k, STATE_GROUP,
+            STATE_KEY_PRESENT_SIMS, &count, &e);
+
+        if (e) {
+            g_propagate_error(error, e);
+            return FALSE;
+        }
+        if (count != n) {
+            g_free(present);
+            g_set_error(error, G_KEY_FILE_ERROR,
+                G_KEY_FILE_ERROR_INVALID_VALUE, "%u modem(s) but %u "
+                STATE_KEY_PRESENT_SIMS " value(s)", n, (guint)count);
+            return FALSE;
+        }
+        memcpy(self->present_sims, present, sizeof(gboolean) * n);
+        g_free(present);
+    }
+    return ofonoext_scenario_get_boolean(k, STATE_GROUP, STATE_KEY_READY,
+        &self->ready, error);
+}
+
+static
+int
+ofonoext_scenario_step_compare(
+    gconstpointer a,
+    gconstpointer b,
+    gpointer user_data)
+{
+    const OfonoExtScenarioStep* s1 = a;
+    const OfonoExtScenarioStep* s2 = b;
+
+    return (s1->time < s2->time) ? -1 : (s1->time > s2->time) ? 1 : 0;
+}
+
+static
+gboolean
+ofonoext_scenario_parse_steps(
+    OfonoExtScenario* self,
+    GKeyFile* k,
+    GError** error)
+{
+    gsize ngroups = 0;
+    char** groups = g_key_file_get_groups(k, &ngroups);
+    GArray* steps = g_array_new(FALSE, FALSE, sizeof(OfonoExtScenarioStep));
+    gboolean ok = TRUE;
+    gsize i;
+
+    for (i=0; i<ngroups && ok; i++) {
+        const char* group = groups[i];
+        guint time;
+
+        if (ofonoext_scenario_parse_time(group, &time)) {
+            char** keys = g_key_file_get_keys(k, group, NULL, NULL);
+            guint j;
+
+            for (j=0; keys[j]; j++) {
+                OfonoExtScenarioStep step;
+
+                step.time = time;
+                step.signal = g_strdup(keys[j]);
+                step.args = ofonoext_scenario_get_strv(k, group, keys[j]);
+                g_array_append_val(steps, step);
+            }
+            g_strfreev(keys);
+        } else if (strcmp(group, SCENARIO_GROUP) &&
+            strcmp(group, STATE_GROUP)) {
+            g_set_error(error, G_KEY_FILE_ERROR,
+                G_KEY_FILE_ERROR_GROUP_NOT_FOUND, "Unexpected group [%s]",
+                group);
+            ok = FALSE;
+        }
+    }
+    g_strfreev(groups);
+
+    /* g_qsort_with_data() is stable, the order within a step matters */
+    if (steps->len) {
+        g_qsort_with_data(steps->data, steps->len,
+            sizeof(OfonoExtScenarioStep), ofonoext_scenario_step_compare,
+            NULL);
+    }
+    self->nsteps = steps->len;
+    self->steps = (OfonoExtScenarioStep*)g_array_free(steps, FALSE);
+    return ok;
+}
+
+/*==========================================================================*
+ * Interface
+ *==========================================================================*/
+
+OfonoExtScenario*
+ofonoext_scenario_load(
+    const char* file,
+    GError** error)
+{
+    GKeyFile* k = g_key_file_new();
+    OfonoExtScenario* self = g_new0(OfonoExtScenario, 1);
+
+    self->ready = TRUE;
+    if (!g_key_file_load_from_file(k, file, G_KEY_FILE_NONE, error) ||
+        !ofonoext_scenario_get_uint(k, SCENARIO_GROUP, SCENARIO_KEY_DELAY,
+            &self->delay, error) ||
+        !ofonoext_scenario_get_boolean(k, SCENARIO_GROUP, SCENARIO_KEY_LOOP,
+            &self->loop, error) ||
+        !ofonoext_scenario_parse_state(self, k, error) ||
+        !ofonoext_scenario_parse_steps(self, k, error)) {
+        ofonoext_scenario_free(self);
+        self = NULL;
+    } else {
+        if (self->nsteps) {
+            self->period = self->steps[self->nsteps - 1].time;
+        }
+        if (!ofonoext_scenario_get_uint(k, SCENARIO_GROUP,
+            SCENARIO_KEY_PERIOD, &self->period, error)) {
+            ofonoext_scenario_free(self);
+            self = NULL;
+        } else {
+            GDEBUG("%s: %u modem(s), %u step(s)", file,
+                gutil_strv_length(self->available), self->nsteps);
+        }
+    }
+    g_key_file_unref(k);
+    return self;
+}
+
+void
+ofonoext_scenario_free(
+    OfonoExtScenario* self)
+{
+    if (self) {
+        guint i;
+
+        for (i=0; i<self->nsteps; i++) {
+            g_free(self->steps[i].signal);
+            g_strfreev(self->steps[i].args);
+        }
+        g_free(self->steps);
+        g_strfreev(self->available);
+        g_strfreev(self->enabled);
+        g_strfreev(self->imei);
+        g_free(self->present_sims);
+        g_free(self->data_imsi);
+        g_free(self->data_modem);
+        g_free(self->voice_imsi);
+        g_free(self->voice_modem);
+        g_free(self->mms_imsi);
+        g_free(self->mms_modem);
+        g_free(self);
+    }
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
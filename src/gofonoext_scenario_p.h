@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GOFONOEXT_SCENARIO_PRIVATE_H
+#define GOFONOEXT_SCENARIO_PRIVATE_H
+
+#include "gofonoext_types.h"
+
+/*
+ * Modem manager state and a timeline of changes loaded from a keyfile:
+ *
+ *   [Scenario]
+ *   Delay=10                  # Milliseconds before becoming valid
+ *   Loop=true                 # Replay the timeline over and over
+ *   Period=200                # Loop period, the last step by default
+ *
+ *   [State]
+ *   Available=/ril_0;/ril_1;
+ *   Enabled=/ril_0;/ril_1;
+ *   IMEI=111111111111111;222222222222222;
+ *   PresentSims=true;true;
+ *   DefaultDataSim=244010000000000
+ *   DefaultDataModem=/ril_0
+ *   DefaultVoiceSim=244010000000000
+ *   DefaultVoiceModem=/ril_0
+ *   MmsSim=
+ *   MmsModem=
+ *   Ready=true
+ *
+ *   [40]
+ *   PresentSimsChanged=1;false;
+ *   EnabledModemsChanged=/ril_0;
+ *
+ * Each numeric group is a step of the timeline, named after the number
+ * of milliseconds since the manager has become valid. The keys are the
+ * D-Bus signal names with their arguments, applied in the order in which
+ * they appear in the group. The steps are sorted by time.
+ */
+
+typedef struct ofonoext_scenario_step {
+    guint time;
+    char* signal;
+    GStrV* args;
+} OfonoExtScenarioStep;
+
+typedef struct ofonoext_scenario {
+    guint delay;
+    gboolean loop;
+    guint period;
+    GStrV* available;
+    GStrV* enabled;
+    GStrV* imei;
+    gboolean* present_sims;     /* One per available modem */
+    char* data_imsi;
+    char* data_modem;
+    char* voice_imsi;
+    char* voice_modem;
+    char* mms_imsi;
+    char* mms_modem;
+    gboolean ready;
+    guint nsteps;
+    OfonoExtScenarioStep* steps;
+} OfonoExtScenario;
+
+OfonoExtScenario*
+ofonoext_scenario_load(
+    const char* file,
+    GError** error)
+    G_GNUC_INTERNAL;
+
+void
+ofonoext_scenario_free(
+    OfonoExtScenario* scenario)
+    G_GNUC_INTERNAL;
+
+#endif /* GOFONOEXT_SCENARIO_PRIVATE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
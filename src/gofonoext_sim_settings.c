@@ -0,0 +1,639 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gofonoext_sim_settings.h"
+#include "gofonoext_log.h"
+
+#include <gofono_modem.h>
+#include <gofono_names.h>
+
+#include <gutil_misc.h>
+#include <gutil_strv.h>
+
+/* Generated headers */
+#include "org.nemomobile.ofono.SimSettings.h"
+
+#define SIM_SETTINGS_INTERFACE "org.nemomobile.ofono.SimSettings"
+
+/* Retry delay */
+#define SIM_SETTINGS_RETRY_SEC (2)
+
+struct ofonoext_sim_settings_priv {
+    char* path;
+    GWeakRef ref;               /* For ofonoext_sim_settings_new() */
+    OfonoModem* modem;
+    gulong modem_event_id;
+    GDBusConnection* bus;
+    OrgNemomobileOfonoSimSettings* proxy;
+    gulong proxy_signal_id;
+    GCancellable* cancel;
+    guint retry_timer_id;
+    GHashTable* props;
+};
+
+typedef GObjectClass OfonoExtSimSettingsClass;
+G_DEFINE_TYPE(OfonoExtSimSettings, ofonoext_sim_settings, G_TYPE_OBJECT)
+
+enum ofonoext_sim_settings_signal {
+    SIGNAL_VALID_CHANGED,
+    SIGNAL_PROPERTY_CHANGED,
+    SIGNAL_COUNT
+};
+
+#define SIGNAL_VALID_CHANGED_NAME       "valid-changed"
+#define SIGNAL_PROPERTY_CHANGED_NAME    "property-changed"
+
+static guint ofonoext_sim_settings_signals[SIGNAL_COUNT] = { 0 };
+
+/* Instances by path, protected by the mutex */
+static GHashTable* ofonoext_sim_settings_table = NULL;
+static GMutex ofonoext_sim_settings_mutex;
+
+/* Forward declarations */
+static
+void
+ofonoext_sim_settings_connect(
+    OfonoExtSimSettings* self);
+
+/*==========================================================================*
+ * Implementation
+ *==========================================================================*/
+
+static
+void
+ofonoext_sim_settings_set_valid(
+    OfonoExtSimSettings* self,
+    gboolean valid)
+{
+    if (self->valid != valid) {
+        self->valid = valid;
+        g_signal_emit(self, ofonoext_sim_settings_signals[
+            SIGNAL_VALID_CHANGED], 0);
+    }
+}
+
+static
+gboolean
+ofonoext_sim_settings_is_timeout(
+    const GError* error)
+{
+    return error && ((error->domain == G_IO_ERROR &&
+        error->code == G_IO_ERROR_TIMED_OUT) ||
+        (error->domain == G_DBUS_ERROR &&
+        (error->code == G_DBUS_ERROR_TIMEOUT ||
+         error->code == G_DBUS_ERROR_TIMED_OUT)));
+}
+
+static
+void
+ofonoext_sim_settings_reset(
+    OfonoExtSimSettings* self)
+{
+    OfonoExtSimSettingsPriv* priv = self->priv;
+
+    if (priv->retry_timer_id) {
+        g_source_remove(priv->retry_timer_id);
+        priv->retry_timer_id = 0;
+    }
+    if (priv->cancel) {
+        /* The callback will drop the reference */
+        g_cancellable_cancel(priv->cancel);
+        g_object_unref(priv->cancel);
+        priv->cancel = NULL;
+    }
+    if (priv->proxy) {
+        gutil_disconnect_handlers(priv->proxy, &priv->proxy_signal_id, 1);
+        g_object_unref(priv->proxy);
+        priv->proxy = NULL;
+    }
+    g_hash_table_remove_all(priv->props);
+}
+
+static
+GVariant*
+ofonoext_sim_settings_unbox(
+    GVariant* value)
+{
+    /* Depending on the GLib version, the value may come boxed */
+    return g_variant_is_of_type(value, G_VARIANT_TYPE_VARIANT) ?
+        g_variant_get_variant(value) : g_variant_ref(value);
+}
+
+static
+void
+ofonoext_sim_settings_property_changed(
+    OrgNemomobileOfonoSimSettings* proxy,
+    const char* name,
+    GVariant* boxed,
+    gpointer data)
+{
+    OfonoExtSimSettings* self = OFONOEXT_SIM_SETTINGS(data);
+    OfonoExtSimSettingsPriv* priv = self->priv;
+    GVariant* value = ofonoext_sim_settings_unbox(boxed);
+    GVariant* prev = g_hash_table_lookup(priv->props, name);
+
+    if (prev && g_variant_equal(prev, value)) {
+        g_variant_unref(value);
+    } else {
+        GVERBOSE_("%s %s", priv->path, name);
+        g_hash_table_replace(priv->props, g_strdup(name), value);
+        g_signal_emit(self, ofonoext_sim_settings_signals[
+            SIGNAL_PROPERTY_CHANGED], g_quark_from_string(name),
+            name, value);
+    }
+}
+
+static
+void
+ofonoext_sim_settings_get_properties_done(
+    GObject* proxy,
+    GAsyncResult* result,
+    gpointer data)
+{
+    OfonoExtSimSettings* self = OFONOEXT_SIM_SETTINGS(data);
+    OfonoExtSimSettingsPriv* priv = self->priv;
+    GVariant* props = NULL;
+    GError* error = NULL;
+
+    if (org_nemomobile_ofono_sim_settings_call_get_properties_finish(
+        ORG_NEMOMOBILE_OFONO_SIM_SETTINGS(proxy), &props, result, &error)) {
+        GVariantIter it;
+        GVariant* value;
+        char* name;
+
+        GASSERT(!self->valid);
+        g_object_unref(priv->cancel);
+        priv->cancel = NULL;
+        g_variant_iter_init(&it, props);
+        while (g_variant_iter_next(&it, "{sv}", &name, &value)) {
+            /* The table takes ownership of both */
+            g_hash_table_replace(priv->props, name, value);
+        }
+        g_variant_unref(props);
+        priv->proxy_signal_id = g_signal_connect(priv->proxy,
+            "property-changed",
+            G_CALLBACK(ofonoext_sim_settings_property_changed), self);
+        ofonoext_sim_settings_set_valid(self, TRUE);
+    } else {
+        if (error->domain == G_IO_ERROR &&
+            error->code == G_IO_ERROR_CANCELLED) {
+            GDEBUG("%s", GERRMSG(error));
+        } else {
+            GERR("%s", GERRMSG(error));
+            g_object_unref(priv->cancel);
+            priv->cancel = NULL;
+            if (ofonoext_sim_settings_is_timeout(error)) {
+                ofonoext_sim_settings_connect(self);
+            }
+        }
+        g_error_free(error);
+    }
+    ofonoext_sim_settings_unref(self);
+}
+
+static
+gboolean
+ofonoext_sim_settings_retry(
+    gpointer data)
+{
+    OfonoExtSimSettings* self = OFONOEXT_SIM_SETTINGS(data);
+    OfonoExtSimSettingsPriv* priv = self->priv;
+
+    GASSERT(priv->retry_timer_id);
+    GASSERT(!priv->cancel);
+    priv->retry_timer_id = 0;
+    priv->cancel = g_cancellable_new();
+    org_nemomobile_ofono_sim_settings_call_get_properties(priv->proxy,
+        priv->cancel, ofonoext_sim_settings_get_properties_done,
+        ofonoext_sim_settings_ref(self));
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+ofonoext_sim_settings_proxy_created(
+    GObject* object,
+    GAsyncResult* result,
+    gpointer data)
+{
+    OfonoExtSimSettings* self = OFONOEXT_SIM_SETTINGS(data);
+    OfonoExtSimSettingsPriv* priv = self->priv;
+    GError* error = NULL;
+    OrgNemomobileOfonoSimSettings* proxy =
+        org_nemomobile_ofono_sim_settings_proxy_new_finish(result, &error);
+
+    if (proxy) {
+        /* Not cancelled, otherwise the call would have failed */
+        GASSERT(!priv->proxy);
+        priv->proxy = proxy;
+        org_nemomobile_ofono_sim_settings_call_get_properties(priv->proxy,
+            priv->cancel, ofonoext_sim_settings_get_properties_done,
+            ofonoext_sim_settings_ref(self));
+    } else {
+        if (error->domain == G_IO_ERROR &&
+            error->code == G_IO_ERROR_CANCELLED) {
+            GDEBUG("%s", GERRMSG(error));
+        } else {
+            GERR("%s", GERRMSG(error));
+            g_object_unref(priv->cancel);
+            priv->cancel = NULL;
+        }
+        g_error_free(error);
+    }
+    ofonoext_sim_settings_unref(self);
+}
+
+static
+void
+ofonoext_sim_settings_create_proxy(
+    OfonoExtSimSettings* self)
+{
+    OfonoExtSimSettingsPriv* priv = self->priv;
+
+    org_nemomobile_ofono_sim_settings_proxy_new(priv->bus,
+        G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES, OFONO_SERVICE, priv->path,
+        priv->cancel, ofonoext_sim_settings_proxy_created,
+        ofonoext_sim_settings_ref(self));
+}
+
+static
+void
+ofonoext_sim_settings_bus(
+    GObject* object,
+    GAsyncResult* result,
+    gpointer data)
+{
+    OfonoExtSimSettings* self = OFONOEXT_SIM_SETTINGS(data);
+    OfonoExtSimSettingsPriv* priv = self->priv;
+    GError* error = NULL;
+    GDBusConnection* bus = g_bus_get_finish(result, &error);
+
+    if (bus) {
+        /* Not cancelled, otherwise the call would have failed */
+        GASSERT(!priv->bus);
+        priv->bus = bus;
+        ofonoext_sim_settings_create_proxy(self);
+    } else {
+        if (error->domain == G_IO_ERROR &&
+            error->code == G_IO_ERROR_CANCELLED) {
+            GDEBUG("%s", GERRMSG(error));
+        } else {
+            GERR("%s", GERRMSG(error));
+            g_object_unref(priv->cancel);
+            priv->cancel = NULL;
+        }
+        g_error_free(error);
+    }
+    ofonoext_sim_settings_unref(self);
+}
+
+static
+void
+ofonoext_sim_settings_connect(
+    OfonoExtSimSettings* self)
+{
+    OfonoExtSimSettingsPriv* priv = self->priv;
+
+    if (priv->proxy) {
+        /* The proxy is there but the call has timed out */
+        if (!priv->retry_timer_id) {
+            priv->retry_timer_id = g_timeout_add_seconds(
+                SIM_SETTINGS_RETRY_SEC, ofonoext_sim_settings_retry, self);
+        }
+    } else {
+        GASSERT(!priv->cancel);
+        priv->cancel = g_cancellable_new();
+        if (priv->bus) {
+            ofonoext_sim_settings_create_proxy(self);
+        } else {
+            g_bus_get(OFONO_BUS_TYPE, priv->cancel, ofonoext_sim_settings_bus,
+                ofonoext_sim_settings_ref(self));
+        }
+    }
+}
+
+static
+void
+ofonoext_sim_settings_check(
+    OfonoExtSimSettings* self)
+{
+    OfonoExtSimSettingsPriv* priv = self->priv;
+
+    if (ofono_modem_has_interface(priv->modem, SIM_SETTINGS_INTERFACE)) {
+        if (!priv->proxy && !priv->cancel) {
+            GDEBUG("%s has %s", priv->path, SIM_SETTINGS_INTERFACE);
+            ofonoext_sim_settings_connect(self);
+        }
+    } else if (priv->proxy || priv->cancel) {
+        GDEBUG("%s is gone from %s", SIM_SETTINGS_INTERFACE, priv->path);
+        ofonoext_sim_settings_reset(self);
+        ofonoext_sim_settings_set_valid(self, FALSE);
+    }
+}
+
+static
+void
+ofonoext_sim_settings_interfaces_changed(
+    OfonoModem* modem,
+    void* data)
+{
+    ofonoext_sim_settings_check(OFONOEXT_SIM_SETTINGS(data));
+}
+
+/*==========================================================================*
+ * API
+ *==========================================================================*/
+
+OfonoExtSimSettings*
+ofonoext_sim_settings_new(
+    const char* path)
+{
+    OfonoExtSimSettings* self = NULL;
+
+    if (G_LIKELY(path)) {
+        if (g_once_init_enter(&ofonoext_sim_settings_table)) {
+            g_once_init_leave(&ofonoext_sim_settings_table,
+                g_hash_table_new(g_str_hash, g_str_equal));
+        }
+
+        g_mutex_lock(&ofonoext_sim_settings_mutex);
+        self = g_hash_table_lookup(ofonoext_sim_settings_table, path);
+        if (self) {
+            /*
+             * Returns NULL if the last reference is being dropped. The
+             * memory is still there, dispose is waiting for the mutex.
+             */
+            self = g_weak_ref_get(&self->priv->ref);
+        }
+        if (self) {
+            g_mutex_unlock(&ofonoext_sim_settings_mutex);
+        } else {
+            OfonoExtSimSettingsPriv* priv;
+
+            self = g_object_new(OFONOEXT_TYPE_SIM_SETTINGS, NULL);
+            priv = self->priv;
+            self->path = priv->path = g_strdup(path);
+            /* Replaces the key too, the old one may be about to go */
+            g_hash_table_replace(ofonoext_sim_settings_table, priv->path,
+                self);
+            g_mutex_unlock(&ofonoext_sim_settings_mutex);
+
+            priv->modem = ofono_modem_new(path);
+            priv->modem_event_id =
+                ofono_modem_add_interfaces_changed_handler(priv->modem,
+                    ofonoext_sim_settings_interfaces_changed, self);
+            ofonoext_sim_settings_check(self);
+        }
+    }
+    return self;
+}
+
+OfonoExtSimSettings*
+ofonoext_sim_settings_ref(
+    OfonoExtSimSettings* self)
+{
+    if (G_LIKELY(self)) {
+        g_object_ref(OFONOEXT_SIM_SETTINGS(self));
+        return self;
+    } else {
+        return NULL;
+    }
+}
+
+void
+ofonoext_sim_settings_unref(
+    OfonoExtSimSettings* self)
+{
+    if (G_LIKELY(self)) {
+        g_object_unref(OFONOEXT_SIM_SETTINGS(self));
+    }
+}
+
+GVariant*
+ofonoext_sim_settings_get_property(
+    OfonoExtSimSettings* self,
+    const char* name)
+{
+    return (G_LIKELY(self) && G_LIKELY(name)) ?
+        g_hash_table_lookup(self->priv->props, name) : NULL;
+}
+
+const char*
+ofonoext_sim_settings_get_string(
+    OfonoExtSimSettings* self,
+    const char* name)
+{
+    GVariant* value = ofonoext_sim_settings_get_property(self, name);
+
+    return (value && (g_variant_is_of_type(value, G_VARIANT_TYPE_STRING) ||
+        g_variant_is_of_type(value, G_VARIANT_TYPE_OBJECT_PATH))) ?
+        g_variant_get_string(value, NULL) : NULL;
+}
+
+GStrV*
+ofonoext_sim_settings_get_names(
+    OfonoExtSimSettings* self)
+{
+    GStrV* names = NULL;
+
+    if (G_LIKELY(self)) {
+        GHashTableIter it;
+        gpointer key;
+
+        g_hash_table_iter_init(&it, self->priv->props);
+        while (g_hash_table_iter_next(&it, &key, NULL)) {
+            names = gutil_strv_add(names, key);
+        }
+    }
+    return names;
+}
+
+void
+ofonoext_sim_settings_set_property(
+    OfonoExtSimSettings* self,
+    const char* name,
+    GVariant* value)
+{
+    if (G_LIKELY(self) && G_LIKELY(name) && G_LIKELY(value)) {
+        OfonoExtSimSettingsPriv* priv = self->priv;
+
+        GASSERT(self->valid);
+        if (G_LIKELY(priv->proxy)) {
+            /* The change comes back with PropertyChanged */
+            org_nemomobile_ofono_sim_settings_call_set_property(priv->proxy,
+                name, g_variant_new_variant(value), NULL, NULL, NULL);
+        } else {
+            g_variant_unref(g_variant_ref_sink(value));
+        }
+    }
+}
+
+gulong
+ofonoext_sim_settings_add_valid_changed_handler(
+    OfonoExtSimSettings* self,
+    OfonoExtSimSettingsHandler fn,
+    void* data)
+{
+    return (G_LIKELY(self) && G_LIKELY(fn)) ? g_signal_connect(self,
+        SIGNAL_VALID_CHANGED_NAME, G_CALLBACK(fn), data) : 0;
+}
+
+gulong
+ofonoext_sim_settings_add_property_changed_handler(
+    OfonoExtSimSettings* self,
+    const char* name,
+    OfonoExtSimSettingsPropertyHandler fn,
+    void* data)
+{
+    if (G_LIKELY(self) && G_LIKELY(fn)) {
+        return g_signal_connect_closure_by_id(self,
+            ofonoext_sim_settings_signals[SIGNAL_PROPERTY_CHANGED],
+            name ? g_quark_from_string(name) : 0,
+            g_cclosure_new(G_CALLBACK(fn), data, NULL), FALSE);
+    }
+    return 0;
+}
+
+void
+ofonoext_sim_settings_remove_handler(
+    OfonoExtSimSettings* self,
+    gulong id)
+{
+    if (G_LIKELY(self) && G_LIKELY(id)) {
+        g_signal_handler_disconnect(self, id);
+    }
+}
+
+void
+ofonoext_sim_settings_remove_handlers(
+    OfonoExtSimSettings* self,
+    gulong* ids,
+    unsigned int count)
+{
+    gutil_disconnect_handlers(self, ids, count);
+}
+
+/*==========================================================================*
+ * Internals
+ *==========================================================================*/
+
+/**
+ * Per instance initializer
+ */
+static
+void
+ofonoext_sim_settings_init(
+    OfonoExtSimSettings* self)
+{
+    OfonoExtSimSettingsPriv* priv = G_TYPE_INSTANCE_GET_PRIVATE(self,
+        OFONOEXT_TYPE_SIM_SETTINGS, OfonoExtSimSettingsPriv);
+
+    self->priv = priv;
+    g_weak_ref_init(&priv->ref, self);
+    priv->props = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify)g_variant_unref);
+}
+
+/**
+ * First stage of deinitialization
+ */
+static
+void
+ofonoext_sim_settings_dispose(
+    GObject* object)
+{
+    OfonoExtSimSettings* self = OFONOEXT_SIM_SETTINGS(object);
+    OfonoExtSimSettingsPriv* priv = self->priv;
+
+    /* The weak references have already been cleared by GObject */
+    g_mutex_lock(&ofonoext_sim_settings_mutex);
+    if (priv->path && g_hash_table_lookup(ofonoext_sim_settings_table,
+        priv->path) == self) {
+        g_hash_table_remove(ofonoext_sim_settings_table, priv->path);
+    }
+    g_mutex_unlock(&ofonoext_sim_settings_mutex);
+    G_OBJECT_CLASS(ofonoext_sim_settings_parent_class)->dispose(object);
+}
+
+/**
+ * Final stage of deinitialization
+ */
+static
+void
+ofonoext_sim_settings_finalize(
+    GObject* object)
+{
+    OfonoExtSimSettings* self = OFONOEXT_SIM_SETTINGS(object);
+    OfonoExtSimSettingsPriv* priv = self->priv;
+
+    g_weak_ref_clear(&priv->ref);
+    ofonoext_sim_settings_reset(self);
+    ofono_modem_remove_handler(priv->modem, priv->modem_event_id);
+    ofono_modem_unref(priv->modem);
+    if (priv->bus) {
+        g_object_unref(priv->bus);
+    }
+    g_hash_table_destroy(priv->props);
+    g_free(priv->path);
+    G_OBJECT_CLASS(ofonoext_sim_settings_parent_class)->finalize(object);
+}
+
+/**
+ * Per class initializer
+ */
+static
+void
+ofonoext_sim_settings_class_init(
+    OfonoExtSimSettingsClass* klass)
+{
+    GObjectClass* object_class = G_OBJECT_CLASS(klass);
+
+    object_class->dispose = ofonoext_sim_settings_dispose;
+    object_class->finalize = ofonoext_sim_settings_finalize;
+    g_type_class_add_private(klass, sizeof(OfonoExtSimSettingsPriv));
+    ofonoext_sim_settings_signals[SIGNAL_VALID_CHANGED] =
+        g_signal_new(SIGNAL_VALID_CHANGED_NAME,
+            G_OBJECT_CLASS_TYPE(klass), G_SIGNAL_RUN_FIRST, 0,
+            NULL, NULL, NULL, G_TYPE_NONE, 0);
+    ofonoext_sim_settings_signals[SIGNAL_PROPERTY_CHANGED] =
+        g_signal_new(SIGNAL_PROPERTY_CHANGED_NAME,
+            G_OBJECT_CLASS_TYPE(klass), G_SIGNAL_RUN_FIRST |
+            G_SIGNAL_DETAILED, 0, NULL, NULL, NULL, G_TYPE_NONE,
+            2, G_TYPE_STRING, G_TYPE_VARIANT);
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gofonoext_worker_p.h"
+#include "gofonoext_log.h"
+
+struct ofonoext_worker {
+    GThread* thread;
+    GMainContext* context;
+    GMainLoop* loop;
+};
+
+static
+gpointer
+ofonoext_worker_thread(
+    gpointer data)
+{
+    OfonoExtWorker* self = data;
+
+    GDEBUG("Worker thread started");
+    g_main_context_push_thread_default(self->context);
+    g_main_loop_run(self->loop);
+
+    /* Let the cancelled subscriptions release their data */
+    while (g_main_context_iteration(self->context, FALSE));
+    g_main_context_pop_thread_default(self->context);
+    GDEBUG("Worker thread exiting");
+    return NULL;
+}
+
+static
+gboolean
+ofonoext_worker_quit(
+    gpointer data)
+{
+    OfonoExtWorker* self = data;
+
+    g_main_loop_quit(self->loop);
+    return G_SOURCE_REMOVE;
+}
+
+OfonoExtWorker*
+ofonoext_worker_new(
+    const char* name)
+{
+    OfonoExtWorker* self = g_new0(OfonoExtWorker, 1);
+
+    self->context = g_main_context_new();
+    self->loop = g_main_loop_new(self->context, FALSE);
+    self->thread = g_thread_new(name, ofonoext_worker_thread, self);
+    return self;
+}
+
+void
+ofonoext_worker_free(
+    OfonoExtWorker* self)
+{
+    if (self) {
+        GSource* source = g_idle_source_new();
+
+        /* Runs after everything posted so far */
+        g_source_set_callback(source, ofonoext_worker_quit, self, NULL);
+        g_source_attach(source, self->context);
+        g_source_unref(source);
+        g_thread_join(self->thread);
+        g_main_loop_unref(self->loop);
+        g_main_context_unref(self->context);
+        g_free(self);
+    }
+}
+
+void
+ofonoext_worker_post(
+    OfonoExtWorker* self,
+    GSourceFunc fn,
+    gpointer data,
+    GDestroyNotify destroy)
+{
+    GSource* source = g_idle_source_new();
+
+    /* Unlike g_main_context_invoke() this never runs fn right away */
+    g_source_set_callback(source, fn, data, destroy);
+    g_source_attach(source, self->context);
+    g_source_unref(source);
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
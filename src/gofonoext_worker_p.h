@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GOFONOEXT_WORKER_PRIVATE_H
+#define GOFONOEXT_WORKER_PRIVATE_H
+
+#include "gofonoext_types.h"
+
+/*
+ * Thread running its own main context, which is the thread default
+ * context of that thread (so that D-Bus subscriptions made by the posted
+ * functions deliver their callbacks there). Posted functions are always
+ * invoked asynchronously, in the order they were posted. Functions posted
+ * before ofonoext_worker_free() are all invoked before the thread exits.
+ */
+typedef struct ofonoext_worker OfonoExtWorker;
+
+OfonoExtWorker*
+ofonoext_worker_new(
+    const char* name)
+    G_GNUC_INTERNAL;
+
+void
+ofonoext_worker_free(
+    OfonoExtWorker* worker)
+    G_GNUC_INTERNAL;
+
+void
+ofonoext_worker_post(
+    OfonoExtWorker* worker,
+    GSourceFunc fn,
+    gpointer data,
+    GDestroyNotify destroy)
+    G_GNUC_INTERNAL;
+
+#endif /* GOFONOEXT_WORKER_PRIVATE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -37,11 +37,19 @@
 
 #include <gutil_log.h>
 
+#include <glib-unix.h>
+#include <signal.h>
+
 #define RET_OK          (0)
 #define RET_NOTFOUND    (1)
 #define RET_ERR         (2)
 #define RET_TIMEOUT     (3)
 
+/* --stats and --jsonl */
+#define APP_DEFAULT_INTERVAL (5)
+#define APP_HIST_BUCKETS (32)
+#define APP_JSONL_BUFSIZE (0x10000)
+
 typedef struct action Action;
 
 enum event_id {
@@ -60,6 +68,37 @@ enum event_id {
     EVENT_COUNT
 };
 
+static const char* const app_event_names[] = {
+    "valid",
+    "enabled-modems",
+    "present-sims",
+    "voice-imsi",
+    "voice-modem",
+    "data-imsi",
+    "data-modem",
+    "mms-imsi",
+    "mms-modem",
+    "sim-count",
+    "active-sim-count",
+    "ready"
+};
+
+G_STATIC_ASSERT(G_N_ELEMENTS(app_event_names) == EVENT_COUNT);
+
+/*
+ * Bucket n of the inter-arrival histogram counts intervals shorter
+ * than 2^n microseconds (and at least 2^(n-1)). The last bucket
+ * collects everything that's longer.
+ */
+typedef struct app_event_stats {
+    struct app* app;
+    int id;
+    guint64 total;
+    guint count;
+    gint64 last;
+    guint hist[APP_HIST_BUCKETS];
+} AppEventStats;
+
 typedef struct app {
     gint timeout;
     gint active;
@@ -68,9 +107,44 @@ typedef struct app {
     gulong event_id[EVENT_COUNT];
     Action* actions;
     gboolean monitor;
+    gboolean stats;
+    gboolean jsonl;
+    gint interval;
+    gint64 start;
+    gint64 first_valid;
+    gint64 last_report;
+    guint report_id;
+    AppEventStats event_stats[EVENT_COUNT];
     int ret;
 } App;
 
+typedef
+gulong
+(*AppAddHandlerFunc)(
+    OfonoExtModemManager* mm,
+    OfonoExtModemManagerHandler fn,
+    void* data);
+
+static const AppAddHandlerFunc app_add_handler[] = {
+    ofonoext_mm_add_valid_changed_handler,
+    ofonoext_mm_add_enabled_modems_changed_handler,
+    ofonoext_mm_add_present_sims_changed_handler,
+    ofonoext_mm_add_voice_imsi_changed_handler,
+    ofonoext_mm_add_voice_modem_changed_handler,
+    ofonoext_mm_add_data_imsi_changed_handler,
+    ofonoext_mm_add_data_modem_changed_handler,
+    ofonoext_mm_add_mms_imsi_changed_handler,
+    ofonoext_mm_add_mms_modem_changed_handler,
+    ofonoext_mm_add_sim_count_changed_handler,
+    ofonoext_mm_add_active_sim_count_changed_handler,
+    ofonoext_mm_add_ready_changed_handler
+};
+
+G_STATIC_ASSERT(G_N_ELEMENTS(app_add_handler) == EVENT_COUNT);
+
+/* stdout is fully buffered in --jsonl mode */
+static char app_jsonl_buf[APP_JSONL_BUFSIZE];
+
 typedef void (*ActionFunc)(App* app, const char* param);
 
 typedef struct action {
@@ -251,6 +325,246 @@ mm_ready_changed(
     GDEBUG("Ready: %s", mm->ready ? "yes" : "no");
 }
 
+static
+void
+app_jsonl_string(
+    const char* str)
+{
+    if (str) {
+        const char* ptr;
+
+        putchar('"');
+        for (ptr = str; *ptr; ptr++) {
+            const guchar c = *ptr;
+
+            if (c == '"' || c == '\\') {
+                putchar('\\');
+                putchar(c);
+            } else if (c < 0x20) {
+                printf("\\u%04x", c);
+            } else {
+                putchar(c);
+            }
+        }
+        putchar('"');
+    } else {
+        fputs("null", stdout);
+    }
+}
+
+static
+void
+app_jsonl_strv(
+    const GStrV* sv)
+{
+    const GStrV* ptr;
+
+    putchar('[');
+    for (ptr = sv; ptr && *ptr; ptr++) {
+        if (ptr > sv) putchar(',');
+        app_jsonl_string(*ptr);
+    }
+    putchar(']');
+}
+
+static
+void
+app_jsonl_bools(
+    const gboolean* values,
+    guint count)
+{
+    guint i;
+
+    putchar('[');
+    for (i = 0; values && i < count; i++) {
+        if (i > 0) putchar(',');
+        fputs(values[i] ? "true" : "false", stdout);
+    }
+    putchar(']');
+}
+
+static
+void
+app_jsonl_modem(
+    OfonoModem* modem)
+{
+    app_jsonl_string(modem ? ofono_modem_path(modem) : NULL);
+}
+
+static
+void
+app_jsonl_event(
+    OfonoExtModemManager* mm,
+    int id)
+{
+    printf("{\"time\":%" G_GINT64_FORMAT ",\"event\":\"%s\",\"value\":",
+        g_get_real_time(), app_event_names[id]);
+    switch ((enum event_id)id) {
+    case EVENT_VALID:
+        fputs(mm->valid ? "true" : "false", stdout);
+        break;
+    case EVENT_ENABLED_MODEMS:
+        app_jsonl_strv(mm->enabled);
+        break;
+    case EVENT_PRESENT_SIMS:
+        app_jsonl_bools(mm->present_sims, mm->modem_count);
+        break;
+    case EVENT_VOICE_IMSI:
+        app_jsonl_string(mm->voice_imsi);
+        break;
+    case EVENT_VOICE_MODEM:
+        app_jsonl_modem(mm->voice_modem);
+        break;
+    case EVENT_DATA_IMSI:
+        app_jsonl_string(mm->data_imsi);
+        break;
+    case EVENT_DATA_MODEM:
+        app_jsonl_modem(mm->data_modem);
+        break;
+    case EVENT_MMS_IMSI:
+        app_jsonl_string(mm->mms_imsi);
+        break;
+    case EVENT_MMS_MODEM:
+        app_jsonl_modem(mm->mms_modem);
+        break;
+    case EVENT_SIM_COUNT:
+        printf("%u", mm->sim_count);
+        break;
+    case EVENT_ACTIVE_SIM_COUNT:
+        printf("%u", mm->active_sim_count);
+        break;
+    case EVENT_READY:
+        fputs(mm->ready ? "true" : "false", stdout);
+        break;
+    case EVENT_COUNT:
+        break;
+    }
+    fputs("}\n", stdout);
+}
+
+static
+void
+app_jsonl_state(
+    App* app)
+{
+    int i;
+
+    /* Initial values look like changes (valid has already been written) */
+    for (i = EVENT_VALID + 1; i < EVENT_COUNT; i++) {
+        app_jsonl_event(app->mm, i);
+    }
+    printf("{\"time\":%" G_GINT64_FORMAT ",\"event\":\"available-modems\","
+        "\"value\":", g_get_real_time());
+    app_jsonl_strv(app->mm->available);
+    fputs("}\n", stdout);
+    printf("{\"time\":%" G_GINT64_FORMAT ",\"event\":\"imei\","
+        "\"value\":", g_get_real_time());
+    app_jsonl_strv(app->mm->imei);
+    fputs("}\n", stdout);
+}
+
+static
+void
+app_stats_event(
+    AppEventStats* stats)
+{
+    const gint64 now = g_get_monotonic_time();
+
+    if (stats->total) {
+        const guint64 delta = now - stats->last;
+        const guint bucket = delta ? g_bit_storage(delta) : 0;
+
+        stats->hist[MIN(bucket, APP_HIST_BUCKETS - 1)]++;
+    }
+    stats->last = now;
+    stats->total++;
+    stats->count++;
+}
+
+static
+void
+app_monitor_event(
+    OfonoExtModemManager* mm,
+    void* arg)
+{
+    AppEventStats* stats = arg;
+    App* app = stats->app;
+
+    if (app->stats) {
+        app_stats_event(stats);
+    }
+    if (app->jsonl) {
+        app_jsonl_event(mm, stats->id);
+    }
+}
+
+static
+void
+app_stats_report(
+    App* app)
+{
+    /* Keep stdout clean for the JSON records */
+    FILE* out = app->jsonl ? stderr : stdout;
+    const gint64 now = g_get_monotonic_time();
+    const gint64 elapsed = now - app->last_report;
+    int i;
+
+    fprintf(out, "[%.1f s]", (now - app->start) / 1000000.0);
+    if (app->first_valid) {
+        fprintf(out, " valid after %.3f ms", app->first_valid / 1000.0);
+    } else {
+        fprintf(out, " not valid yet");
+    }
+    fprintf(out, "\n");
+    for (i = 0; i < EVENT_COUNT; i++) {
+        AppEventStats* stats = app->event_stats + i;
+
+        if (stats->total) {
+            guint b;
+
+            fprintf(out, "  %s: %" G_GUINT64_FORMAT " total, %.1f/s",
+                app_event_names[i], stats->total, elapsed > 0 ?
+                stats->count * 1000000.0 / elapsed : 0.0);
+            for (b = 0; b < APP_HIST_BUCKETS; b++) {
+                if (stats->hist[b]) {
+                    fprintf(out, " <%luus:%u", 1UL << b, stats->hist[b]);
+                }
+            }
+            fprintf(out, "\n");
+            stats->count = 0;
+        }
+    }
+    fflush(out);
+    app->last_report = now;
+}
+
+static
+gboolean
+app_report(
+    gpointer data)
+{
+    App* app = data;
+
+    if (app->stats) {
+        app_stats_report(app);
+    }
+    if (app->jsonl) {
+        fflush(stdout);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static
+gboolean
+app_quit(
+    gpointer data)
+{
+    App* app = data;
+
+    g_main_loop_quit(app->loop);
+    return G_SOURCE_CONTINUE;
+}
+
 static
 void
 mm_valid(
@@ -258,6 +572,26 @@ mm_valid(
 {
     GString* buf = NULL;
     GDEBUG("ofono is running");
+    if (!app->first_valid) {
+        app->first_valid = g_get_monotonic_time() - app->start;
+    }
+    if (app->stats || app->jsonl) {
+        if (app->jsonl) {
+            app_jsonl_state(app);
+        }
+        app_run_actions(app);
+        if (app->monitor) {
+            int i;
+
+            ofonoext_mm_remove_handlers(app->mm, app->event_id+1,
+                EVENT_COUNT-1);
+            for (i = 1; i < EVENT_COUNT; i++) {
+                app->event_id[i] = app_add_handler[i](app->mm,
+                    app_monitor_event, app->event_stats + i);
+            }
+        }
+        return;
+    }
     buf = mm_format_strv(buf, app->mm->available);
     printf("Ready: %s\n", app->mm->ready ? "yes" : "no");
     printf("Available modems: %s\n", buf->str);
@@ -325,6 +659,9 @@ mm_valid_changed(
     void* arg)
 {
     App* app = arg;
+    if (app->stats || app->jsonl) {
+        app_monitor_event(mm, app->event_stats + EVENT_VALID);
+    }
     if (mm->valid) {
         mm_valid(app);
     } else {
@@ -392,9 +729,26 @@ int
 app_run(
     App* app)
 {
+    guint sigterm = 0, sigint = 0;
+    int i;
+
+    for (i = 0; i < EVENT_COUNT; i++) {
+        app->event_stats[i].app = app;
+        app->event_stats[i].id = i;
+    }
+    if (app->jsonl) {
+        setvbuf(stdout, app_jsonl_buf, _IOFBF, sizeof(app_jsonl_buf));
+    }
+    app->start = app->last_report = g_get_monotonic_time();
     app->mm = ofonoext_mm_new();
     app->ret = RET_ERR;
     app->loop = g_main_loop_new(NULL, FALSE);
+    if (app->stats || app->jsonl) {
+        app->report_id = g_timeout_add_seconds(app->interval,
+            app_report, app);
+        sigterm = g_unix_signal_add(SIGTERM, app_quit, app);
+        sigint = g_unix_signal_add(SIGINT, app_quit, app);
+    }
     if (app->timeout > 0) GDEBUG("Timeout %d sec", app->timeout);
     if (app->mm->valid) {
         mm_valid(app);
@@ -408,6 +762,12 @@ app_run(
         g_main_loop_run(app->loop);
         ofonoext_mm_remove_handlers(app->mm, app->event_id, EVENT_COUNT);
     }
+    if (app->report_id) {
+        g_source_remove(app->report_id);
+        g_source_remove(sigterm);
+        g_source_remove(sigint);
+        app_report(app);
+    }
     g_main_loop_unref(app->loop);
     ofonoext_mm_unref(app->mm);
     return app->ret;
@@ -452,6 +812,12 @@ app_init(
           &app->timeout, "Timeout in seconds", "SECONDS" },
         { "monitor", 'm', 0, G_OPTION_ARG_NONE,
           &app->monitor, "Monitor events", NULL },
+        { "stats", 's', 0, G_OPTION_ARG_NONE,
+          &app->stats, "Monitor events, print statistics", NULL },
+        { "jsonl", 'j', 0, G_OPTION_ARG_NONE,
+          &app->jsonl, "Monitor events, print JSON lines", NULL },
+        { "interval", 'i', 0, G_OPTION_ARG_INT,
+          &app->interval, "Statistics/flush interval [5]", "SECONDS" },
         { NULL }
     };
     GOptionEntry action_entries[] = {
@@ -467,7 +833,10 @@ app_init(
     g_option_group_add_entries(actions, action_entries);
     g_option_context_add_group(options, actions);
     if (g_option_context_parse(options, &argc, &argv, &error)) {
-        if (argc == 1) {
+        if (argc == 1 && app->interval > 0) {
+            if (app->stats || app->jsonl) {
+                app->monitor = TRUE;
+            }
             ok = TRUE;
         } else {
             char* help = g_option_context_get_help(options, TRUE, NULL);
@@ -488,6 +857,7 @@ int main(int argc, char* argv[])
     App app;
     memset(&app, 0, sizeof(app));
     app.timeout = -1;
+    app.interval = APP_DEFAULT_INTERVAL;
     gutil_log_timestamp = FALSE;
     gutil_log_set_type(GLOG_TYPE_STDERR, "test");
     gutil_log_default.level = GLOG_LEVEL_DEFAULT;
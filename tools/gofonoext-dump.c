@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gofonoext_recorder.h"
+
+#include <gutil_log.h>
+
+#include <string.h>
+
+#define RET_OK          (0)
+#define RET_ERR         (2)
+
+static const char* const dump_input_names[] = {
+    "enabled-modems",
+    "data-imsi",
+    "data-modem",
+    "voice-imsi",
+    "voice-modem",
+    "present-sims",
+    "mms-imsi",
+    "mms-modem",
+    "ready",
+    "name-appeared",
+    "name-vanished",
+    "state",
+    "available-modems",
+    "imei"
+};
+
+static const char* const dump_output_names[] = {
+    "valid-changed",
+    "enabled-modems-changed",
+    "data-imsi-changed",
+    "data-modem-changed",
+    "voice-imsi-changed",
+    "voice-modem-changed",
+    "mms-imsi-changed",
+    "mms-modem-changed",
+    "present-sims-changed",
+    "sim-count-changed",
+    "active-sim-count-changed",
+    "ready-changed",
+    "slots-warm"
+};
+
+typedef struct dump_opts {
+    gboolean header;
+    gboolean raw_time;
+} DumpOpts;
+
+static
+void
+dump_strv(
+    GString* out,
+    const guint8* data,
+    guint len)
+{
+    guint i, start = 0;
+
+    for (i = 0; i <= len; i++) {
+        if (i == len || !data[i]) {
+            if (i > start || i < len) {
+                if (out->len) g_string_append_c(out, ',');
+                g_string_append_len(out, (const char*)data + start,
+                    i - start);
+            }
+            start = i + 1;
+        }
+    }
+}
+
+static
+void
+dump_payload(
+    GString* out,
+    guint code,
+    const guint8* data,
+    guint len)
+{
+    gint32 i;
+
+    switch (code) {
+    case OFONOEXT_RECORD_INPUT_ENABLED_MODEMS:
+    case OFONOEXT_RECORD_INPUT_AVAILABLE_MODEMS:
+    case OFONOEXT_RECORD_INPUT_IMEI:
+        dump_strv(out, data, len);
+        break;
+    case OFONOEXT_RECORD_INPUT_PRESENT_SIMS:
+        if (len > sizeof(i)) {
+            memcpy(&i, data, sizeof(i));
+            g_string_append_printf(out, "%d %s", i, data[sizeof(i)] ?
+                "true" : "false");
+        }
+        break;
+    case OFONOEXT_RECORD_INPUT_READY:
+        if (len) {
+            g_string_append(out, data[0] ? "true" : "false");
+        }
+        break;
+    case OFONOEXT_RECORD_INPUT_STATE:
+        if (len >= sizeof(i)) {
+            memcpy(&i, data, sizeof(i));
+            g_string_append_printf(out, "version %d", i);
+        }
+        break;
+    default:
+        g_string_append_len(out, (const char*)data, len);
+        break;
+    }
+}
+
+static
+void
+dump_record(
+    const OfonoExtRecorderRecord* rec,
+    const DumpOpts* opts,
+    GString* buf)
+{
+    const guint8* payload = (const guint8*)(rec + 1);
+    const char* name = NULL;
+    char dir = '?';
+
+    g_string_truncate(buf, 0);
+    if (rec->type == OFONOEXT_RECORD_INPUT) {
+        dir = '<';
+        if (rec->code < G_N_ELEMENTS(dump_input_names)) {
+            name = dump_input_names[rec->code];
+        }
+        dump_payload(buf, rec->code, payload,
+            MIN(rec->length, rec->size - sizeof(*rec)));
+    } else if (rec->type == OFONOEXT_RECORD_OUTPUT) {
+        dir = '>';
+        if (rec->code < G_N_ELEMENTS(dump_output_names)) {
+            name = dump_output_names[rec->code];
+        }
+    }
+
+    if (opts->raw_time) {
+        printf("%" G_GINT64_FORMAT, rec->time);
+    } else {
+        GDateTime* dt = g_date_time_new_from_unix_local(rec->time /
+            G_USEC_PER_SEC);
+        char* str = g_date_time_format(dt, "%F %T");
+
+        printf("%s.%06u", str, (guint)(rec->time % G_USEC_PER_SEC));
+        g_date_time_unref(dt);
+        g_free(str);
+    }
+    if (name) {
+        printf(" %c %s", dir, name);
+    } else {
+        printf(" %c %u:%u", dir, rec->type, rec->code);
+    }
+    if (buf->len) {
+        printf(" %s", buf->str);
+    }
+    printf("\n");
+}
+
+static
+int
+dump_file(
+    const char* file,
+    const DumpOpts* opts)
+{
+    GError* error = NULL;
+    gchar* contents = NULL;
+    gsize length = 0;
+    int ret = RET_ERR;
+
+    if (g_file_get_contents(file, &contents, &length, &error)) {
+        const OfonoExtRecorderHeader* header = (void*)contents;
+
+        if (length < sizeof(*header) ||
+            header->magic != OFONOEXT_RECORDER_MAGIC ||
+            header->format != OFONOEXT_RECORDER_FORMAT ||
+            header->header_size != sizeof(*header) ||
+            length < sizeof(*header) + header->data_size ||
+            header->head < header->tail ||
+            header->head - header->tail > header->data_size) {
+            GERR("%s: not a recording", file);
+        } else {
+            const guint8* data = (const guint8*)(header + 1);
+            const guint32 size = header->data_size;
+            GString* buf = g_string_new(NULL);
+            guint64 pos = header->tail;
+
+            if (opts->header) {
+                printf("Size: %u\n", size);
+                printf("Records: %" G_GUINT64_FORMAT "\n", header->count);
+                printf("Head: %" G_GUINT64_FORMAT "\n", header->head);
+                printf("Tail: %" G_GUINT64_FORMAT "\n", header->tail);
+            }
+
+            /* Same rules as used by the writer */
+            while (pos < header->head) {
+                const guint32 off = pos % size;
+                const guint32 left = size - off;
+                const OfonoExtRecorderRecord* rec = (void*)(data + off);
+
+                if (left < sizeof(*rec)) {
+                    pos += left;
+                } else if (rec->size < sizeof(*rec) || rec->size > left) {
+                    GERR("Garbage at %" G_GUINT64_FORMAT, pos);
+                    break;
+                } else {
+                    if (rec->type != OFONOEXT_RECORD_PADDING) {
+                        dump_record(rec, opts, buf);
+                    }
+                    pos += rec->size;
+                }
+            }
+            g_string_free(buf, TRUE);
+            ret = RET_OK;
+        }
+        g_free(contents);
+    } else {
+        GERR("%s", error->message);
+        g_error_free(error);
+    }
+    return ret;
+}
+
+int main(int argc, char* argv[])
+{
+    int ret = RET_ERR;
+    DumpOpts opts;
+    GError* error = NULL;
+    GOptionEntry entries[] = {
+        { "header", 'H', 0, G_OPTION_ARG_NONE,
+          &opts.header, "Print the file header", NULL },
+        { "raw-time", 'r', 0, G_OPTION_ARG_NONE,
+          &opts.raw_time, "Print raw timestamps (microseconds)", NULL },
+        { NULL }
+    };
+    GOptionContext* options = g_option_context_new("FILE");
+
+    memset(&opts, 0, sizeof(opts));
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (g_option_context_parse(options, &argc, &argv, &error)) {
+        if (argc == 2) {
+            ret = dump_file(argv[1], &opts);
+        } else {
+            char* help = g_option_context_get_help(options, TRUE, NULL);
+            fprintf(stderr, "%s", help);
+            g_free(help);
+        }
+    } else {
+        GERR("%s", error->message);
+        g_error_free(error);
+    }
+    g_option_context_free(options);
+    return ret;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */